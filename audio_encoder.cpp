@@ -8,6 +8,120 @@ extern "C" {
 #include "libavutil/mathematics.h"
 }
 
+AVCodecContext* open_audio_encoder(AVStream* in_audio_stream, AVFormatContext* out_fmt) {
+    // 获取输入音频流的参数
+    int in_sample_rate = in_audio_stream->codecpar->sample_rate;
+    int in_channels = in_audio_stream->codecpar->channels;
+    int64_t in_channel_layout = in_audio_stream->codecpar->channel_layout;
+    int64_t in_audio_bit_rate = in_audio_stream->codecpar->bit_rate;
+    
+    if (in_channel_layout == 0) {
+        in_channel_layout = av_get_default_channel_layout(in_channels);
+    }
+    
+    std::cout << "输入音频参数：" << std::endl
+              << "采样率: " << in_sample_rate << " Hz" << std::endl
+              << "声道数: " << in_channels << std::endl
+              << "声道布局: 0x" << std::hex << in_channel_layout << std::dec << std::endl
+              << "比特率: " << (in_audio_bit_rate / 1000) << " kb/s" << std::endl;
+    
+    // 初始化音频编码器 - 尝试多种编码器
+    AVCodec* audio_enc_codec = nullptr;
+    
+    // 尝试不同的音频编码器，按优先级排序
+    const char* audio_encoders[] = {"libfdk_aac", "libfaac", "aac", "mp3", "libmp3lame", nullptr};
+    int audio_encoder_index = 0;
+    
+    while (audio_encoders[audio_encoder_index] && !audio_enc_codec) {
+        audio_enc_codec = avcodec_find_encoder_by_name(audio_encoders[audio_encoder_index]);
+        if (audio_enc_codec) {
+            std::cout << "使用音频编码器: " << audio_encoders[audio_encoder_index] << std::endl;
+            break;
+        }
+        audio_encoder_index++;
+    }
+    
+    // 如果找不到任何指定的编码器，尝试使用MP3
+    if (!audio_enc_codec) {
+        std::cout << "找不到指定的音频编码器，尝试使用默认MP3编码器" << std::endl;
+        audio_enc_codec = avcodec_find_encoder(AV_CODEC_ID_MP3);
+    }
+    
+    if (!audio_enc_codec) {
+        std::cerr << "找不到可用的音频编码器，将只处理视频" << std::endl;
+        return nullptr;
+    }
+
+    AVCodecContext* audio_enc_ctx = avcodec_alloc_context3(audio_enc_codec);
+    
+
+    audio_enc_ctx->sample_rate = in_sample_rate;
+    audio_enc_ctx->channel_layout = in_channel_layout;
+    audio_enc_ctx->channels = in_channels;
+
+    // 根据编码器选择合适的采样格式（位深度）
+    if (audio_enc_codec->sample_fmts) {
+        // 尝试使用32位浮点格式，如果支持的话
+        bool found_format = false;
+        for (int i = 0; audio_enc_codec->sample_fmts[i] != AV_SAMPLE_FMT_NONE; i++) {
+            if (audio_enc_codec->sample_fmts[i] == AV_SAMPLE_FMT_FLT ||
+                audio_enc_codec->sample_fmts[i] == AV_SAMPLE_FMT_FLTP) {
+                audio_enc_ctx->sample_fmt = audio_enc_codec->sample_fmts[i];
+                found_format = true;
+                std::cout << "使用32位浮点音频格式" << std::endl;
+                break;
+            }
+        }
+        // 如果不支持32位浮点，则使用编码器支持的第一个格式
+        if (!found_format) {
+            audio_enc_ctx->sample_fmt = audio_enc_codec->sample_fmts[0];
+            std::cout << "使用编码器默认音频格式" << std::endl;
+        }
+    } else {
+        // 如果编码器没有指定支持的格式，使用默认的浮点格式
+        audio_enc_ctx->sample_fmt = AV_SAMPLE_FMT_FLTP;
+        std::cout << "使用默认32位浮点音频格式" << std::endl;
+    }
+
+    // 设置音频比特率 - 使用与输入文件相同的比特率
+    audio_enc_ctx->bit_rate = in_audio_bit_rate > 0 ? in_audio_bit_rate : 130000; // 使用输入文件的比特率，如果没有则使用130 kb/s
+    std::cout << "音频比特率: " << (audio_enc_ctx->bit_rate / 1000) << " kb/s" << std::endl;
+
+    // 计算并显示原始音频数据率
+    int64_t raw_bit_rate = (int64_t)audio_enc_ctx->sample_rate * 
+                         (audio_enc_ctx->sample_fmt == AV_SAMPLE_FMT_FLT || 
+                          audio_enc_ctx->sample_fmt == AV_SAMPLE_FMT_FLTP ? 32 : 16) * 
+                         audio_enc_ctx->channels;
+    
+    std::cout << "原始音频数据率: " << (raw_bit_rate / 1000.0) << " kbps" << std::endl;
+    std::cout << "压缩后音频数据率: " << (audio_enc_ctx->bit_rate / 1000.0) << " kbps" << std::endl;
+    std::cout << "压缩比: " << (raw_bit_rate / (double)audio_enc_ctx->bit_rate) << ":1" << std::endl;
+
+    audio_enc_ctx->time_base = (AVRational){1, audio_enc_ctx->sample_rate};
+    audio_enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    
+    // 打开音频编码器
+    int ret = avcodec_open2(audio_enc_ctx, audio_enc_codec, nullptr);
+    if (ret < 0) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "无法打开音频编码器: " << errbuf << std::endl;
+        avcodec_free_context(&audio_enc_ctx);
+        return nullptr;
+    }
+
+    // 创建音频输出流
+    AVStream* audio_out_stream = avformat_new_stream(out_fmt, nullptr);
+    avcodec_parameters_from_context(audio_out_stream->codecpar, audio_enc_ctx);
+    audio_out_stream->time_base = audio_enc_ctx->time_base;
+    
+    std::cout << "音频编码器初始化完成，编码器: " << audio_enc_codec->name
+              << ", 采样率: " << audio_enc_ctx->sample_rate 
+              << ", 声道数: " << audio_enc_ctx->channels << std::endl;
+
+    return audio_enc_ctx;
+}
+
 void audio_encoder(AVCodecContext* codec_ctx,
                   FrameQueue& frame_queue,
                   PacketQueue& packet_queue) {
@@ -75,6 +189,7 @@ void audio_encoder(AVCodecContext* codec_ctx,
                 char errbuf[AV_ERROR_MAX_STRING_SIZE];
                 av_strerror(ret, errbuf, sizeof(errbuf));
                 std::cerr << "从音频编码器接收包失败: " << errbuf << std::endl;
+                packet_queue.fail(ret, "音频编码");
                 break;
             }
             
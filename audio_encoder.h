@@ -4,11 +4,15 @@
 
 extern "C" {
 #include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
 }
 
 class FrameQueue;
 class PacketQueue;
 
+// 按输入音频流参数创建并打开音频编码器，同时在输出上下文中创建音频流，失败返回 nullptr
+AVCodecContext* open_audio_encoder(AVStream* in_audio_stream, AVFormatContext* out_fmt);
+
 void audio_encoder(AVCodecContext* codec_ctx, FrameQueue& frame_queue,PacketQueue& packet_queue);
 
 #endif
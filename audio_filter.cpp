@@ -1,5 +1,8 @@
 #include "audio_filter.h"
+#include "audio_rechunker.h"
+#include "wsola.h"
 #include <iostream>
+#include <memory>
 
 extern "C" {
 #include <libavutil/opt.h>
@@ -15,7 +18,25 @@ int init_audio_filters(AVCodecContext* dec_ctx,
                       AVFilterGraph** graph,
                       AVFilterContext** src_ctx,
                       AVFilterContext** sink_ctx,
-                      float speed) {
+                      float speed,
+                      TempoEngine tempo_engine,
+                      const LoudnessOptions& loudness) {
+    enc_ctx->time_base = dec_ctx->time_base;
+
+    return init_audio_filters(dec_ctx->time_base, dec_ctx->sample_rate, dec_ctx->sample_fmt, dec_ctx->channel_layout,
+                              graph, src_ctx, sink_ctx, speed, tempo_engine, loudness);
+}
+
+int init_audio_filters(AVRational time_base,
+                      int sample_rate,
+                      enum AVSampleFormat sample_fmt,
+                      uint64_t channel_layout,
+                      AVFilterGraph** graph,
+                      AVFilterContext** src_ctx,
+                      AVFilterContext** sink_ctx,
+                      float speed,
+                      TempoEngine tempo_engine,
+                      const LoudnessOptions& loudness) {
     int ret;
     char args[512];
     
@@ -26,14 +47,12 @@ int init_audio_filters(AVCodecContext* dec_ctx,
     //           << "声道布局: 0x" << std::hex << dec_ctx->channel_layout << std::dec << std::endl
     //           << "时间基准: " << dec_ctx->time_base.num << "/" << dec_ctx->time_base.den << std::endl;
 
-    enc_ctx->time_base = dec_ctx->time_base;
-
     snprintf(args, sizeof(args),
             "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%lx",
-            dec_ctx->time_base.num, dec_ctx->time_base.den,
-            dec_ctx->sample_rate,
-            av_get_sample_fmt_name(dec_ctx->sample_fmt),
-            dec_ctx->channel_layout);
+            time_base.num, time_base.den,
+            sample_rate,
+            av_get_sample_fmt_name(sample_fmt),
+            channel_layout);
 
     *graph = avfilter_graph_alloc();
     if (!*graph) {
@@ -61,51 +80,79 @@ int init_audio_filters(AVCodecContext* dec_ctx,
         return ret;
     }
 
-    // 设置输出参数
-    enum AVSampleFormat out_sample_fmts[] = { enc_ctx->sample_fmt, AV_SAMPLE_FMT_NONE };
-    int out_sample_rates[] = { enc_ctx->sample_rate, -1 };
-    uint64_t out_channel_layouts[] = { enc_ctx->channel_layout, 0 };
-    
-    ret = av_opt_set_int_list(*sink_ctx, "sample_fmts", out_sample_fmts, -1, AV_OPT_SEARCH_CHILDREN);
-    if (ret < 0) {
-        std::cerr << "无法设置输出采样格式" << std::endl;
-        return ret;
-    }
-    
-    ret = av_opt_set_int_list(*sink_ctx, "sample_rates", out_sample_rates, -1, AV_OPT_SEARCH_CHILDREN);
-    if (ret < 0) {
-        std::cerr << "无法设置输出采样率" << std::endl;
-        return ret;
-    }
-    
-    ret = av_opt_set_int_list(*sink_ctx, "channel_layouts", out_channel_layouts, 0, AV_OPT_SEARCH_CHILDREN);
-    if (ret < 0) {
-        std::cerr << "无法设置输出声道布局" << std::endl;
-        return ret;
-    }
-
     // 创建滤波器链
     AVFilterContext* last_filter = *src_ctx;
 
-    // 创建atempo滤波器用于变速
-    if (speed != 1.0) {
-        AVFilterContext* atempo_ctx;
-        const AVFilter* atempo = avfilter_get_by_name("atempo");
-        char atempo_args[64];
-        snprintf(atempo_args, sizeof(atempo_args), "%f", speed);
-        ret = avfilter_graph_create_filter(&atempo_ctx, atempo, "atempo", atempo_args, NULL, *graph);
+    if (loudness.mode == LOUDNESS_DYNAMIC) {
+        // 单遍动态响度归一化：loudnorm 内部以 192kHz 处理并带 3 秒前瞻限幅，之后重采样回输入采样率
+        char loudnorm_args[128];
+        snprintf(loudnorm_args, sizeof(loudnorm_args), "I=%.1f:TP=%.1f:LRA=%.1f",
+                 loudness.target, loudness.peak_limit, loudness.range);
+        char aresample_args[32];
+        snprintf(aresample_args, sizeof(aresample_args), "%d", sample_rate);
+
+        const char* names[] = {"loudnorm", "aresample"};
+        const char* filter_args[] = {loudnorm_args, aresample_args};
+        for (int i = 0; i < 2; i++) {
+            AVFilterContext* filter_ctx;
+            ret = avfilter_graph_create_filter(&filter_ctx, avfilter_get_by_name(names[i]), names[i], filter_args[i], NULL, *graph);
+            if (ret < 0) {
+                std::cerr << "无法创建" << names[i] << "滤波器" << std::endl;
+                return ret;
+            }
+            ret = avfilter_link(last_filter, 0, filter_ctx, 0);
+            if (ret < 0) {
+                std::cerr << "无法连接到" << names[i] << "滤波器" << std::endl;
+                return ret;
+            }
+            last_filter = filter_ctx;
+        }
+    }
+
+    if (speed != 1.0 && tempo_engine == TEMPO_ENGINE_WSOLA) {
+        // 内置 WSOLA 在滤波器图之后处理，这里只统一为平面浮点格式
+        AVFilterContext* aformat_ctx;
+        const AVFilter* aformat = avfilter_get_by_name("aformat");
+        ret = avfilter_graph_create_filter(&aformat_ctx, aformat, "aformat", "sample_fmts=fltp", NULL, *graph);
         if (ret < 0) {
-            std::cerr << "无法创建atempo滤波器" << std::endl;
+            std::cerr << "无法创建aformat滤波器" << std::endl;
             return ret;
         }
 
-        // 连接到上一个滤波器
-        ret = avfilter_link(last_filter, 0, atempo_ctx, 0);
+        ret = avfilter_link(last_filter, 0, aformat_ctx, 0);
         if (ret < 0) {
-            std::cerr << "无法连接到atempo滤波器" << std::endl;
+            std::cerr << "无法连接到aformat滤波器" << std::endl;
             return ret;
         }
-        last_filter = atempo_ctx;
+        last_filter = aformat_ctx;
+    } else if (speed != 1.0) {
+        // 创建atempo滤波器用于变速，单个atempo只支持0.5-2.0，超出时串联多级
+        double remaining = speed;
+        int stage = 0;
+        while (remaining > 0) {
+            double tempo = remaining > 2.0 ? 2.0 : remaining;
+            remaining = remaining > 2.0 ? remaining / 2.0 : 0;
+
+            AVFilterContext* atempo_ctx;
+            const AVFilter* atempo = avfilter_get_by_name("atempo");
+            char atempo_args[64];
+            char atempo_name[32];
+            snprintf(atempo_args, sizeof(atempo_args), "%f", tempo);
+            snprintf(atempo_name, sizeof(atempo_name), "atempo%d", stage++);
+            ret = avfilter_graph_create_filter(&atempo_ctx, atempo, atempo_name, atempo_args, NULL, *graph);
+            if (ret < 0) {
+                std::cerr << "无法创建atempo滤波器" << std::endl;
+                return ret;
+            }
+
+            // 连接到上一个滤波器
+            ret = avfilter_link(last_filter, 0, atempo_ctx, 0);
+            if (ret < 0) {
+                std::cerr << "无法连接到atempo滤波器" << std::endl;
+                return ret;
+            }
+            last_filter = atempo_ctx;
+        }
     }
 
 
@@ -135,46 +182,7 @@ int init_audio_filters(AVCodecContext* dec_ctx,
     last_filter = asetpts_ctx;
 
 
-    AVFilterContext* aformat_ctx;
-    const AVFilter* aformat = avfilter_get_by_name("aformat");
-    char aformat_args[512];
-    snprintf(aformat_args, sizeof(aformat_args),
-             "sample_fmts=%s:sample_rates=%d:channel_layouts=0x%lx",
-             av_get_sample_fmt_name(enc_ctx->sample_fmt),
-             enc_ctx->sample_rate,
-             enc_ctx->channel_layout);
-    
-    ret = avfilter_graph_create_filter(&aformat_ctx, aformat, "aformat", aformat_args, NULL, *graph);
-    if (ret < 0) {
-        std::cerr << "无法创建aformat滤波器" << std::endl;
-        return ret;
-    }
-
-
-    ret = avfilter_link(last_filter, 0, aformat_ctx, 0);
-    if (ret < 0) {
-        std::cerr << "无法连接到aformat滤波器" << std::endl;
-        return ret;
-    }
-    last_filter = aformat_ctx;
-
-
-    AVFilterContext* asetnsamples_ctx;
-    const AVFilter* asetnsamples = avfilter_get_by_name("asetnsamples");
-    ret = avfilter_graph_create_filter(&asetnsamples_ctx, asetnsamples, "asetnsamples", "n=1024", NULL, *graph);
-    if (ret < 0) {
-        std::cerr << "无法创建asetnsamples滤波器" << std::endl;
-        return ret;
-    }
-
-
-    ret = avfilter_link(last_filter, 0, asetnsamples_ctx, 0);
-    if (ret < 0) {
-        std::cerr << "无法连接到asetnsamples滤波器" << std::endl;
-        return ret;
-    }
-    last_filter = asetnsamples_ctx;
-
+    // 采样格式转换和按编码器帧大小切分由 AudioRechunker 完成，滤波器图只负责变速
 
     ret = avfilter_link(last_filter, 0, *sink_ctx, 0);
     if (ret < 0) {
@@ -194,20 +202,116 @@ int init_audio_filters(AVCodecContext* dec_ctx,
     //           << "采样格式: " << av_get_sample_fmt_name(enc_ctx->sample_fmt) << std::endl
     //           << "声道布局: 0x" << std::hex << enc_ctx->channel_layout << std::dec << std::endl
     //           << "时间基准: " << enc_ctx->time_base.num << "/" << enc_ctx->time_base.den << std::endl
-    //           << "帧大小: 1024 采样" << std::endl
     //           << "速度: " << speed << "倍" << std::endl;
 
     return 0;
 }
 
-void audio_filter_process(AVFilterContext* src_ctx,
-                         AVFilterContext* sink_ctx,
+// 内置变速阶段：按需初始化 WSOLA，把变速结果交给重分帧器
+struct TempoStage {
+    float speed = 1.0;
+    bool enabled = false;
+    std::unique_ptr<WsolaStretcher> stretcher;
+    int channels = 0;
+    int sample_rate = 0;
+    AVFrame* stretched = nullptr;
+
+    TempoStage() : stretched(av_frame_alloc()) {}
+    ~TempoStage() { av_frame_free(&stretched); }
+
+    void flush(AudioRechunker& rechunker, AVRational time_base, FrameQueue& output_queue) {
+        if (!stretcher) return;
+        if (stretcher->flush(stretched) > 0) {
+            rechunker.push(stretched, time_base, output_queue);
+        }
+        av_frame_unref(stretched);
+    }
+
+    void push(AVFrame* frame, AudioRechunker& rechunker, AVRational time_base, FrameQueue& output_queue) {
+        if (!enabled) {
+            rechunker.push(frame, time_base, output_queue);
+            return;
+        }
+        if (!stretcher || frame->channels != channels || frame->sample_rate != sample_rate) {
+            flush(rechunker, time_base, output_queue);
+            stretcher.reset(new WsolaStretcher);
+            channels = frame->channels;
+            sample_rate = frame->sample_rate;
+            if (stretcher->init(channels, sample_rate, speed) < 0) {
+                enabled = false;
+                stretcher.reset();
+                rechunker.push(frame, time_base, output_queue);
+                return;
+            }
+        }
+        if (stretcher->process(frame, time_base, stretched) > 0) {
+            rechunker.push(stretched, time_base, output_queue);
+        }
+        av_frame_unref(stretched);
+    }
+};
+
+// 从滤波器图取出所有可用帧，变速和重分帧后送入输出队列
+static void drain_audio_filters(AVFilterContext* sink_ctx, AVFrame* frame, TempoStage& tempo, AudioRechunker& rechunker, FrameQueue& output_queue, int& output_count) {
+    while(true) {
+        int ret = av_buffersink_get_frame(sink_ctx, frame);
+        if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        }
+        if(ret < 0) {
+            char err_buf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, err_buf, sizeof(err_buf));
+            std::cerr << "从滤波器获取音频帧失败: " << err_buf << std::endl;
+            break;
+        }
+
+        output_count++;
+
+        if (frame->pts == AV_NOPTS_VALUE) {
+            std::cerr << "输出音频帧没有有效的PTS" << std::endl;
+        }
+
+        // std::cout << "输出音频帧 #" << output_count
+        //           << " PTS: " << frame->pts
+        //           << " 采样数: " << frame->nb_samples << std::endl;
+
+        tempo.push(frame, rechunker, av_buffersink_get_time_base(sink_ctx), output_queue);
+        av_frame_unref(frame);
+    }
+}
+
+void audio_filter_process(AVFilterGraph** graph,
+                         AVFilterContext** src_ctx,
+                         AVFilterContext** sink_ctx,
+                         AVCodecContext* enc_ctx,
+                         float speed,
+                         TempoEngine tempo_engine,
+                         const LoudnessOptions& loudness,
                          FrameQueue& input_queue,
                          FrameQueue& output_queue) {
     AVFrame* frame = av_frame_alloc();
     int frame_count = 0;
     int output_count = 0;
     int64_t last_pts = AV_NOPTS_VALUE;
+
+    AudioRechunker rechunker;
+    int init_ret = rechunker.init(enc_ctx);
+    if (init_ret < 0) {
+        // 取消整个作业；未挂接取消令牌时取出剩余帧，上游不会阻塞在有上限的队列上
+        std::cerr << "初始化音频重分帧失败" << std::endl;
+        output_queue.fail(init_ret, "音频滤波");
+        while (AVFrame* input_frame = input_queue.pop()) {
+            av_frame_free(&input_frame);
+        }
+        output_queue.set_eof();
+        av_frame_free(&frame);
+        avfilter_graph_free(graph);
+        return;
+    }
+
+    TempoStage tempo;
+    tempo.speed = speed;
+    tempo.enabled = speed != 1.0 && tempo_engine == TEMPO_ENGINE_WSOLA;
     
     std::cout << "开始处理音频帧..." << std::endl;
     
@@ -229,8 +333,29 @@ void audio_filter_process(AVFilterContext* src_ctx,
         // std::cout << "处理音频帧 #" << frame_count
         //           << " PTS: " << input_frame->pts
         //           << " 采样数: " << input_frame->nb_samples << std::endl;
+
+        // 输入音频参数变化（如拼接不同规格的输入）时，冲洗旧图并按新参数重建
+        AVFilterLink* in_link = (*src_ctx)->outputs[0];
+        uint64_t layout = input_frame->channel_layout ? input_frame->channel_layout
+                                                      : av_get_default_channel_layout(input_frame->channels);
+        if (input_frame->format != in_link->format || input_frame->sample_rate != in_link->sample_rate ||
+            (in_link->channel_layout && layout != in_link->channel_layout)) {
+            std::cout << "音频输入参数变化: " << in_link->sample_rate << " Hz -> " << input_frame->sample_rate
+                      << " Hz，重建滤波器图" << std::endl;
+            AVRational time_base = in_link->time_base;
+            av_buffersrc_add_frame(*src_ctx, nullptr);
+            drain_audio_filters(*sink_ctx, frame, tempo, rechunker, output_queue, output_count);
+            avfilter_graph_free(graph);
+            if (init_audio_filters(time_base, input_frame->sample_rate, static_cast<AVSampleFormat>(input_frame->format),
+                                   layout, graph, src_ctx, sink_ctx, speed, tempo_engine, loudness) < 0) {
+                std::cerr << "重建音频滤波器图失败" << std::endl;
+                av_frame_free(&input_frame);
+                output_queue.fail(AVERROR(EINVAL), "音频滤波");
+                break;
+            }
+        }
         
-        int ret = av_buffersrc_add_frame(src_ctx, input_frame);
+        int ret = av_buffersrc_add_frame(*src_ctx, input_frame);
         if(ret < 0) {
             char err_buf[AV_ERROR_MAX_STRING_SIZE];
             av_strerror(ret, err_buf, sizeof(err_buf));
@@ -239,44 +364,23 @@ void audio_filter_process(AVFilterContext* src_ctx,
             continue;
         }
 
-        while(true) {
-            ret = av_buffersink_get_frame(sink_ctx, frame);
-            if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-                break;
-            }
-            if(ret < 0) {
-                char err_buf[AV_ERROR_MAX_STRING_SIZE];
-                av_strerror(ret, err_buf, sizeof(err_buf));
-                std::cerr << "从滤波器获取音频帧失败: " << err_buf << std::endl;
-                break;
-            }
-
-            output_count++;
-            AVFrame* cloned = av_frame_clone(frame);
-            if (!cloned) {
-                std::cerr << "无法克隆音频帧" << std::endl;
-                av_frame_unref(frame);
-                continue;
-            }
-
-
-            if (cloned->pts == AV_NOPTS_VALUE) {
-                std::cerr << "输出音频帧没有有效的PTS" << std::endl;
-            }
-
-            // std::cout << "输出音频帧 #" << output_count
-            //           << " PTS: " << cloned->pts
-            //           << " 采样数: " << cloned->nb_samples << std::endl;
-
-            output_queue.push(cloned);
-            av_frame_unref(frame);
-        }
+        drain_audio_filters(*sink_ctx, frame, tempo, rechunker, output_queue, output_count);
         av_frame_free(&input_frame);
     }
 
     // std::cout << "音频滤波处理完成，共处理 " << frame_count
     //           << " 个输入帧，输出 " << output_count << " 个帧" << std::endl;
+
+    // 冲洗滤波器图和重分帧器中剩余的采样
+    if (*src_ctx && av_buffersrc_add_frame(*src_ctx, nullptr) >= 0) {
+        drain_audio_filters(*sink_ctx, frame, tempo, rechunker, output_queue, output_count);
+    }
+    if (*sink_ctx) {
+        tempo.flush(rechunker, av_buffersink_get_time_base(*sink_ctx), output_queue);
+    }
+    rechunker.flush(output_queue);
               
     output_queue.set_eof();
     av_frame_free(&frame);
+    avfilter_graph_free(graph);
 }
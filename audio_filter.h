@@ -2,6 +2,7 @@
 #define AUDIO_FILTER_H
 
 #include "frame_queue.h"
+#include "loudness.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,15 +15,42 @@ extern "C" {
 }
 #endif
 
+// 变速实现：libavfilter 的 atempo，或内置的 WSOLA（见 wsola.h）
+enum TempoEngine {
+    TEMPO_ENGINE_ATEMPO,
+    TEMPO_ENGINE_WSOLA
+};
+
 int init_audio_filters(AVCodecContext* dec_ctx,
                       AVCodecContext* enc_ctx,
                       AVFilterGraph** graph,
                       AVFilterContext** src_ctx,
                       AVFilterContext** sink_ctx,
-                      float speed);
-
-void audio_filter_process(AVFilterContext* src_ctx,
-                         AVFilterContext* sink_ctx,
+                      float speed,
+                      TempoEngine tempo_engine = TEMPO_ENGINE_ATEMPO,
+                      const LoudnessOptions& loudness = LoudnessOptions());
+
+// 按给定的输入参数初始化滤波器图，不修改编码器时间基准。
+// loudness 为动态模式时在变速之前插入 loudnorm，线性模式的增益在解码阶段施加（见 loudness.h）
+int init_audio_filters(AVRational time_base,
+                      int sample_rate,
+                      enum AVSampleFormat sample_fmt,
+                      uint64_t channel_layout,
+                      AVFilterGraph** graph,
+                      AVFilterContext** src_ctx,
+                      AVFilterContext** sink_ctx,
+                      float speed,
+                      TempoEngine tempo_engine = TEMPO_ENGINE_ATEMPO,
+                      const LoudnessOptions& loudness = LoudnessOptions());
+
+// 处理音频帧，输入采样格式、采样率或声道布局变化时重建滤波器图，结束时释放滤波器图
+void audio_filter_process(AVFilterGraph** graph,
+                         AVFilterContext** src_ctx,
+                         AVFilterContext** sink_ctx,
+                         AVCodecContext* enc_ctx,
+                         float speed,
+                         TempoEngine tempo_engine,
+                         const LoudnessOptions& loudness,
                          FrameQueue& input_queue,
                          FrameQueue& output_queue);
 
@@ -0,0 +1,181 @@
+#include "audio_rechunker.h"
+#include <iostream>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/samplefmt.h>
+}
+
+// 编码器未规定帧大小时使用的默认切分长度
+static const int DEFAULT_CHUNK_SIZE = 1024;
+
+AudioRechunker::~AudioRechunker() {
+    av_frame_free(&pending);
+    swr_free(&swr);
+    av_buffer_pool_uninit(&pool);
+}
+
+int AudioRechunker::init(AVCodecContext* codec_ctx) {
+    enc_ctx = codec_ctx;
+    frame_size = enc_ctx->frame_size > 0 ? enc_ctx->frame_size : DEFAULT_CHUNK_SIZE;
+
+    if (enc_ctx->channels <= AV_NUM_DATA_POINTERS) {
+        int size = av_samples_get_buffer_size(nullptr, enc_ctx->channels, frame_size, enc_ctx->sample_fmt, 0);
+        if (size < 0) {
+            std::cerr << "无法计算音频帧缓冲大小" << std::endl;
+            return size;
+        }
+        pool = av_buffer_pool_init(size, av_buffer_alloc);
+        if (!pool) {
+            std::cerr << "无法创建音频帧缓冲池" << std::endl;
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    std::cout << "音频重分帧: 输出 " << av_get_sample_fmt_name(enc_ctx->sample_fmt)
+              << ", " << enc_ctx->sample_rate << " Hz, 每帧 " << frame_size << " 采样" << std::endl;
+    return 0;
+}
+
+int AudioRechunker::configure(const AVFrame* frame, uint64_t channel_layout) {
+    swr = swr_alloc_set_opts(swr,
+                             enc_ctx->channel_layout, enc_ctx->sample_fmt, enc_ctx->sample_rate,
+                             channel_layout, static_cast<AVSampleFormat>(frame->format), frame->sample_rate,
+                             0, nullptr);
+    if (!swr) {
+        std::cerr << "无法创建音频重采样器" << std::endl;
+        return AVERROR(ENOMEM);
+    }
+
+    int ret = swr_init(swr);
+    if (ret < 0) {
+        char err_buf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, err_buf, sizeof(err_buf));
+        std::cerr << "无法初始化音频重采样器: " << err_buf << std::endl;
+        return ret;
+    }
+
+    in_format = frame->format;
+    in_sample_rate = frame->sample_rate;
+    in_channel_layout = channel_layout;
+    return 0;
+}
+
+int AudioRechunker::alloc_pending() {
+    pending = av_frame_alloc();
+    if (!pending) {
+        return AVERROR(ENOMEM);
+    }
+    pending->format = enc_ctx->sample_fmt;
+    pending->channel_layout = enc_ctx->channel_layout;
+    pending->channels = enc_ctx->channels;
+    pending->sample_rate = enc_ctx->sample_rate;
+    pending->nb_samples = frame_size;
+
+    int ret;
+    if (pool) {
+        pending->buf[0] = av_buffer_pool_get(pool);
+        if (!pending->buf[0]) {
+            av_frame_free(&pending);
+            return AVERROR(ENOMEM);
+        }
+        ret = av_samples_fill_arrays(pending->data, &pending->linesize[0], pending->buf[0]->data,
+                                     enc_ctx->channels, frame_size, enc_ctx->sample_fmt, 0);
+    } else {
+        ret = av_frame_get_buffer(pending, 0);
+    }
+    if (ret < 0) {
+        av_frame_free(&pending);
+        return ret;
+    }
+
+    // nb_samples 表示已填充的采样数
+    pending->nb_samples = 0;
+    return 0;
+}
+
+void AudioRechunker::emit(FrameQueue& output_queue) {
+    pending->pts = next_pts;
+    next_pts += av_rescale_q(pending->nb_samples, (AVRational){1, enc_ctx->sample_rate}, enc_ctx->time_base);
+    output_queue.push(pending);
+    pending = nullptr;
+}
+
+int AudioRechunker::convert(const uint8_t** in, int in_count, FrameQueue& output_queue) {
+    int bytes_per_sample = av_get_bytes_per_sample(enc_ctx->sample_fmt);
+    bool planar = av_sample_fmt_is_planar(enc_ctx->sample_fmt);
+    int planes = planar ? enc_ctx->channels : 1;
+    int stride = planar ? bytes_per_sample : bytes_per_sample * enc_ctx->channels;
+
+    // in 为空时冲洗重采样器；非空且 in_count 为 0 时只取出重采样器内已缓存的采样
+    const uint8_t* no_input[1] = { nullptr };
+    while (true) {
+        if (!pending) {
+            int ret = alloc_pending();
+            if (ret < 0) return ret;
+        }
+
+        uint8_t* out[AV_NUM_DATA_POINTERS];
+        int filled = pending->nb_samples;
+        for (int i = 0; i < planes; i++) {
+            out[i] = pending->extended_data[i] + filled * stride;
+        }
+
+        // 直接转换到输出帧的剩余空间，多出的输入由重采样器缓存
+        int got = swr_convert(swr, out, frame_size - filled, in, in_count);
+        if (got < 0) {
+            char err_buf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(got, err_buf, sizeof(err_buf));
+            std::cerr << "音频格式转换失败: " << err_buf << std::endl;
+            return got;
+        }
+        pending->nb_samples += got;
+
+        if (pending->nb_samples < frame_size) {
+            return 0;
+        }
+        emit(output_queue);
+
+        if (in) {
+            in = no_input;
+            in_count = 0;
+        } else if (got == 0) {
+            return 0;
+        }
+    }
+}
+
+int AudioRechunker::push(const AVFrame* frame, AVRational time_base, FrameQueue& output_queue) {
+    uint64_t channel_layout = frame->channel_layout ? frame->channel_layout
+                                                    : av_get_default_channel_layout(frame->channels);
+
+    // 输入参数变化时先取出旧参数下的剩余采样，再重新配置重采样器
+    if (!swr || frame->format != in_format || frame->sample_rate != in_sample_rate ||
+        channel_layout != in_channel_layout) {
+        if (swr) {
+            convert(nullptr, 0, output_queue);
+        }
+        int ret = configure(frame, channel_layout);
+        if (ret < 0) return ret;
+    }
+
+    if (next_pts == AV_NOPTS_VALUE) {
+        next_pts = frame->pts != AV_NOPTS_VALUE ? av_rescale_q(frame->pts, time_base, enc_ctx->time_base) : 0;
+    }
+
+    return convert(const_cast<const uint8_t**>(frame->extended_data), frame->nb_samples, output_queue);
+}
+
+int AudioRechunker::flush(FrameQueue& output_queue) {
+    if (!swr) {
+        return 0;
+    }
+
+    int ret = convert(nullptr, 0, output_queue);
+    if (pending && pending->nb_samples > 0) {
+        emit(output_queue);
+    }
+    av_frame_free(&pending);
+    return ret;
+}
@@ -0,0 +1,54 @@
+#ifndef AUDIO_RECHUNKER_H
+#define AUDIO_RECHUNKER_H
+
+#include "frame_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libswresample/swresample.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// 音频重分帧：把滤波器输出转换为编码器的采样格式、采样率和声道布局，
+// 转换结果直接写入待送编码器的帧，凑满 frame_size 个采样后输出。
+// 替代原先的 aformat + asetnsamples 滤波器，每个采样只在格式转换时写入一次。
+struct AudioRechunker {
+    AVCodecContext* enc_ctx = nullptr;
+    SwrContext* swr = nullptr;
+    AVBufferPool* pool = nullptr;   // 输出帧缓冲池，编码器释放后即可复用
+    AVFrame* pending = nullptr;     // 正在填充的输出帧
+    int frame_size = 0;
+    int64_t next_pts = AV_NOPTS_VALUE;
+
+    // 当前重采样器的输入参数
+    int in_format = -1;
+    int in_sample_rate = 0;
+    uint64_t in_channel_layout = 0;
+
+    AudioRechunker() = default;
+    AudioRechunker(const AudioRechunker&) = delete;
+    AudioRechunker& operator=(const AudioRechunker&) = delete;
+    ~AudioRechunker();
+
+    int init(AVCodecContext* enc_ctx);
+
+    // 送入一帧滤波器输出（time_base 为该帧时间戳的时间基准），凑满的帧推入输出队列
+    int push(const AVFrame* frame, AVRational time_base, FrameQueue& output_queue);
+
+    // 冲洗重采样器并输出最后一个不足帧大小的帧
+    int flush(FrameQueue& output_queue);
+
+private:
+    int configure(const AVFrame* frame, uint64_t channel_layout);
+    int alloc_pending();
+    int convert(const uint8_t** in, int in_count, FrameQueue& output_queue);
+    void emit(FrameQueue& output_queue);
+};
+
+#endif
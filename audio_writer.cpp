@@ -1,62 +1,251 @@
 #include "audio_writer.h"
 #include <iostream>
-#include <fstream>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 
 extern "C" {
-#include "libavcodec/avcodec.h"
+#include "libavutil/samplefmt.h"
 }
 
-extern std::queue<AVFrame*> audio_frame_queue;
-extern std::mutex audio_mutex;
-extern std::condition_variable audio_cv;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
-void audio_writer() {
-    std::ofstream audio_file("audio_frames.pcm", std::ios::binary);
-    if (!audio_file.is_open()) {
-        std::cerr << "无法打开音频输出文件" << std::endl;
-        return;
+// 写缓冲大小，攒满后一次 write
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;
+static const int WAV_HEADER_SIZE = 44;
+
+// 双声道 16 位交错：L0 R0 L1 R1 ...
+static void interleave_s16_stereo(uint8_t* dst, const uint8_t* left, const uint8_t* right, int nb_samples) {
+    const int16_t* l = reinterpret_cast<const int16_t*>(left);
+    const int16_t* r = reinterpret_cast<const int16_t*>(right);
+    int16_t* out = reinterpret_cast<int16_t*>(dst);
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= nb_samples; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= nb_samples; i += 8) {
+        int16x8x2_t pair = { { vld1q_s16(l + i), vld1q_s16(r + i) } };
+        vst2q_s16(out + 2 * i, pair);
+    }
+#endif
+    for (; i < nb_samples; i++) {
+        out[2 * i] = l[i];
+        out[2 * i + 1] = r[i];
     }
+}
 
-    while (true) {
-        AVFrame* frame = nullptr;
-        {
-            std::unique_lock<std::mutex> lock(audio_mutex);
-            std::cout << "等待音频帧，当前队列大小: " << audio_frame_queue.size() << std::endl;
-            audio_cv.wait(lock, []{ return !audio_frame_queue.empty(); });
-            frame = audio_frame_queue.front();
-            audio_frame_queue.pop();
-        }
+// 双声道 32 位交错，float 与 s32 按位相同处理
+static void interleave_32_stereo(uint8_t* dst, const uint8_t* left, const uint8_t* right, int nb_samples) {
+    const int32_t* l = reinterpret_cast<const int32_t*>(left);
+    const int32_t* r = reinterpret_cast<const int32_t*>(right);
+    int32_t* out = reinterpret_cast<int32_t*>(dst);
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= nb_samples; i += 4) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_unpacklo_epi32(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 4), _mm_unpackhi_epi32(a, b));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= nb_samples; i += 4) {
+        int32x4x2_t pair = { { vld1q_s32(l + i), vld1q_s32(r + i) } };
+        vst2q_s32(out + 2 * i, pair);
+    }
+#endif
+    for (; i < nb_samples; i++) {
+        out[2 * i] = l[i];
+        out[2 * i + 1] = r[i];
+    }
+}
 
-        // 检查结束信号
-        if (frame == nullptr) {
-            std::cout << "接收到音频结束信号" << std::endl;
+// 通用交错：逐声道按步长写入
+static void interleave_generic(uint8_t* dst, uint8_t* const* planes, int channels, int sample_size, int nb_samples) {
+    int stride = channels * sample_size;
+    for (int ch = 0; ch < channels; ch++) {
+        const uint8_t* src = planes[ch];
+        uint8_t* out = dst + ch * sample_size;
+        switch (sample_size) {
+        case 2:
+            for (int i = 0; i < nb_samples; i++) memcpy(out + i * stride, src + i * 2, 2);
             break;
+        case 4:
+            for (int i = 0; i < nb_samples; i++) memcpy(out + i * stride, src + i * 4, 4);
+            break;
+        default:
+            for (int i = 0; i < nb_samples; i++) memcpy(out + i * stride, src + i * sample_size, sample_size);
+            break;
+        }
+    }
+}
+
+static void interleave(uint8_t* dst, uint8_t* const* planes, int channels, int sample_size, int nb_samples) {
+    if (channels == 2 && sample_size == 2) {
+        interleave_s16_stereo(dst, planes[0], planes[1], nb_samples);
+    } else if (channels == 2 && sample_size == 4) {
+        interleave_32_stereo(dst, planes[0], planes[1], nb_samples);
+    } else if (channels == 1) {
+        memcpy(dst, planes[0], (size_t)nb_samples * sample_size);
+    } else {
+        interleave_generic(dst, planes, channels, sample_size, nb_samples);
+    }
+}
+
+// 完整写出 size 字节，处理被信号打断和部分写入
+static int write_all(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
+static void put_le16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+// 生成 44 字节的 WAV 头，data_size 超过 4GB 时截断为最大值
+static void fill_wav_header(uint8_t* header, AVSampleFormat packed_fmt, int channels, int sample_rate, uint64_t data_size) {
+    int sample_size = av_get_bytes_per_sample(packed_fmt);
+    bool is_float = packed_fmt == AV_SAMPLE_FMT_FLT || packed_fmt == AV_SAMPLE_FMT_DBL;
+    uint32_t size32 = data_size > 0xFFFFFFFFull - WAV_HEADER_SIZE ? 0xFFFFFFFFu - WAV_HEADER_SIZE : (uint32_t)data_size;
+
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, size32 + WAV_HEADER_SIZE - 8);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, is_float ? 3 : 1);
+    put_le16(header + 22, channels);
+    put_le32(header + 24, sample_rate);
+    put_le32(header + 28, sample_rate * channels * sample_size);
+    put_le16(header + 32, channels * sample_size);
+    put_le16(header + 34, sample_size * 8);
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, size32);
+}
+
+static bool has_wav_extension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string ext = path.substr(dot + 1);
+    return ext == "wav" || ext == "WAV";
+}
+
+void audio_writer(FrameQueue& frame_queue, const std::string& output_file) {
+    int fd = open(output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "无法打开音频输出文件: " << output_file << std::endl;
+        // 继续取出并释放帧，避免上游分发线程的引用无人释放
+        while (AVFrame* frame = frame_queue.pop()) {
+            av_frame_free(&frame);
         }
+        return;
+    }
 
-        // 计算样本尺寸
-        const int sample_size = av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format));
+    bool wav = has_wav_extension(output_file);
+    std::vector<uint8_t> buffer;
+    buffer.reserve(WRITE_BUFFER_SIZE);
+    uint64_t data_size = 0;
+    bool failed = false;
+
+    // 以第一帧的参数作为输出格式
+    AVSampleFormat packed_fmt = AV_SAMPLE_FMT_NONE;
+    int channels = 0, sample_rate = 0;
+
+    auto flush_buffer = [&]() {
+        if (!failed && !buffer.empty() && write_all(fd, buffer.data(), buffer.size()) < 0) {
+            std::cerr << "写入音频输出文件失败: " << strerror(errno) << std::endl;
+            failed = true;
+        }
+        buffer.clear();
+    };
+
+    while (AVFrame* frame = frame_queue.pop()) {
+        AVSampleFormat format = static_cast<AVSampleFormat>(frame->format);
+        int sample_size = av_get_bytes_per_sample(format);
         if (sample_size <= 0) {
             std::cerr << "无效的音频样本格式" << std::endl;
             av_frame_free(&frame);
             continue;
         }
 
-        // 写入交错格式的PCM数据
-        std::cout << frame->nb_samples << std::endl;
-        std::cout << frame->channels << std::endl;
-        for (int i = 0; i < frame->nb_samples; i++) {
-            for (int ch = 0; ch < frame->channels; ch++) {
-                const uint8_t* data = frame->data[ch] + i * sample_size;
-                //std::cout << 1357 << std::endl;
-                audio_file.write(reinterpret_cast<const char*>(data), sample_size);
+        if (packed_fmt == AV_SAMPLE_FMT_NONE) {
+            packed_fmt = av_get_packed_sample_fmt(format);
+            channels = frame->channels;
+            sample_rate = frame->sample_rate;
+            std::cout << "PCM 输出: " << av_get_sample_fmt_name(packed_fmt) << ", " << channels
+                      << " 声道, " << sample_rate << " Hz -> " << output_file << std::endl;
+            if (wav) {
+                // 先占位，结束时回填长度
+                buffer.resize(WAV_HEADER_SIZE);
+                fill_wav_header(buffer.data(), packed_fmt, channels, sample_rate, 0);
+            }
+        } else if (av_get_packed_sample_fmt(format) != packed_fmt || frame->channels != channels ||
+                   frame->sample_rate != sample_rate) {
+            std::cerr << "音频参数中途变化，PCM 输出丢弃该帧" << std::endl;
+            av_frame_free(&frame);
+            continue;
+        }
+
+        size_t frame_bytes = (size_t)frame->nb_samples * channels * sample_size;
+        if (buffer.size() + frame_bytes > WRITE_BUFFER_SIZE) {
+            flush_buffer();
+        }
+
+        if (frame_bytes > WRITE_BUFFER_SIZE && !av_sample_fmt_is_planar(format)) {
+            // 超大的打包帧直接写出，不经过缓冲
+            if (!failed && write_all(fd, frame->data[0], frame_bytes) < 0) {
+                std::cerr << "写入音频输出文件失败: " << strerror(errno) << std::endl;
+                failed = true;
+            }
+        } else {
+            size_t offset = buffer.size();
+            buffer.resize(offset + frame_bytes);
+            if (av_sample_fmt_is_planar(format)) {
+                interleave(buffer.data() + offset, frame->extended_data, channels, sample_size, frame->nb_samples);
+            } else {
+                memcpy(buffer.data() + offset, frame->data[0], frame_bytes);
             }
         }
+        data_size += frame_bytes;
 
         av_frame_free(&frame);
     }
+    flush_buffer();
+
+    if (wav && packed_fmt != AV_SAMPLE_FMT_NONE && !failed) {
+        uint8_t header[WAV_HEADER_SIZE];
+        fill_wav_header(header, packed_fmt, channels, sample_rate, data_size);
+        if (pwrite(fd, header, WAV_HEADER_SIZE, 0) != WAV_HEADER_SIZE) {
+            std::cerr << "无法回填 WAV 头" << std::endl;
+        }
+    }
+    close(fd);
 
-    std::cout << "音频写入完成" << std::endl;
+    std::cout << "音频写入完成，共 " << data_size << " 字节" << std::endl;
 }
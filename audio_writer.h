@@ -1,6 +1,11 @@
 #ifndef AUDIO_WRITER_H
 #define AUDIO_WRITER_H
 
-void audio_writer();
+#include <string>
+#include "frame_queue.h"
+
+// PCM 输出：从帧队列读取解码后的音频，平面格式交错为打包格式后按大块写出。
+// 输出文件扩展名为 .wav 时写 WAV 头（结束时回填长度），否则写裸 PCM。
+void audio_writer(FrameQueue& frame_queue, const std::string& output_file);
 
 #endif
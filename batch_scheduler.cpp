@@ -0,0 +1,282 @@
+#include "batch_scheduler.h"
+#include "transcode_job.h"
+#include "checkpoint.h"
+#include "input_probe.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <cmath>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/time.h"
+}
+
+// 编码器内部缓存的帧数：x264 前瞻和 B 帧
+static const int ENCODER_BUFFERED_FRAMES = 48;
+// 解码器参考帧和帧线程占用的帧数
+static const int DECODER_BUFFERED_FRAMES = 16;
+// 每个作业与帧尺寸无关的固定开销（滤波器图、编解码器上下文、包队列等）
+static const int64_t JOB_BASE_MEMORY = 64ll << 20;
+
+struct BatchJob {
+    JobOptions options;
+    int index = 0;
+    int priority = 0;
+    double deadline = 0;        // 相对批处理开始的截止时间（秒），0 为无
+    double media_duration = 0;  // 输入时长（秒）
+    int64_t memory = 0;         // 估算的内存占用
+    int threads = 0;
+    int result = 0;
+    double wall_time = 0;
+};
+
+// 拆分一行清单：空白分隔，值可以用双引号包含空格
+static std::vector<std::string> split_manifest_line(const std::string& line) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool quoted = false, has_token = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            has_token = true;
+        } else if (!quoted && isspace((unsigned char)c)) {
+            if (has_token) tokens.push_back(token);
+            token.clear();
+            has_token = false;
+        } else {
+            token += c;
+            has_token = true;
+        }
+    }
+    if (has_token) tokens.push_back(token);
+    return tokens;
+}
+
+static int parse_manifest(const std::string& path, const JobOptions& defaults, std::vector<BatchJob>& jobs) {
+    std::ifstream in(path.c_str());
+    if (!in) {
+        std::cerr << "无法打开作业清单: " << path << std::endl;
+        return -1;
+    }
+
+    std::string line;
+    int line_number = 0;
+    std::set<std::string> outputs;
+    while (std::getline(in, line)) {
+        line_number++;
+        std::vector<std::string> tokens = split_manifest_line(line);
+        if (tokens.empty() || tokens[0][0] == '#') continue;
+
+        BatchJob job;
+        job.options = defaults;
+        job.options.inputs.clear();
+        job.options.speeds.clear();
+        job.options.batch = BatchOptions();
+        job.index = (int)jobs.size();
+        bool has_output = false;
+        for (const std::string& token : tokens) {
+            size_t eq = token.find('=');
+            std::string key = token.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : token.substr(eq + 1);
+            if (key == "input") {
+                job.options.inputs.push_back(value);
+            } else if (key == "output") {
+                job.options.output = value;
+                has_output = !value.empty();
+            } else if (key == "speed") {
+                parse_speed_list(value, job.options.speeds);
+            } else if (key == "priority") {
+                job.priority = atoi(value.c_str());
+            } else if (key == "deadline") {
+                job.deadline = atof(value.c_str());
+            } else {
+                std::cerr << "作业清单第 " << line_number << " 行: 无法识别的字段 " << key << std::endl;
+                return -1;
+            }
+        }
+        if (job.options.inputs.empty() || !has_output) {
+            std::cerr << "作业清单第 " << line_number << " 行缺少 " << (has_output ? "input" : "output") << std::endl;
+            return -1;
+        }
+        if (job.options.speeds.empty()) {
+            job.options.speeds.push_back(job.options.speed);
+        }
+        // 并发作业不能写同一个文件，多倍速时按各速度的实际输出文件名检查
+        for (float speed : job.options.speeds) {
+            std::string file = job.options.speeds.size() > 1 ? output_for_speed(job.options.output, speed) : job.options.output;
+            if (!outputs.insert(file).second) {
+                std::cerr << "作业清单第 " << line_number << " 行: 输出文件与前面的作业重复: " << file << std::endl;
+                return -1;
+            }
+        }
+        jobs.push_back(job);
+    }
+    return 0;
+}
+
+// 探测输入的视频尺寸，估算作业运行时的内存占用
+static void estimate_job(BatchJob& job) {
+    const JobOptions& opts = job.options;
+    int width = 1920, height = 1080;
+    AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
+
+    AVFormatContext* fmt_ctx = nullptr;
+    if (open_input(opts.inputs[0], opts.probe, &fmt_ctx) == 0) {
+        int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (video_stream >= 0) {
+            AVCodecParameters* par = fmt_ctx->streams[video_stream]->codecpar;
+            if (par->width > 0 && par->height > 0) {
+                width = par->width;
+                height = par->height;
+            }
+            if (par->format >= 0) {
+                pix_fmt = static_cast<AVPixelFormat>(par->format);
+            }
+        }
+        if (fmt_ctx->duration > 0) {
+            job.media_duration = fmt_ctx->duration / (double)AV_TIME_BASE;
+        }
+        avformat_close_input(&fmt_ctx);
+    }
+
+    int64_t decoded_frame = std::max(0, av_image_get_buffer_size(pix_fmt, width, height, 32));
+    int enc_width = opts.proxy_width > 0 ? opts.proxy_width : width;
+    int enc_height = opts.proxy_width > 0 ? (int)((int64_t)height * enc_width / width) : height;
+    int64_t encoder_frame = std::max(0, av_image_get_buffer_size(AV_PIX_FMT_YUV420P, enc_width, enc_height, 32));
+
+    int branches = (int)opts.speeds.size();
+    int video_queues = branches + (opts.raw_video_output.empty() ? 0 : 1) + (branches > 1 ? 1 : 0);
+    int queued_frames = opts.frame_queue_limit * video_queues;
+    job.memory = JOB_BASE_MEMORY
+               + decoded_frame * (queued_frames + DECODER_BUFFERED_FRAMES + opts.decoder_threads)
+               + encoder_frame * (ENCODER_BUFFERED_FRAMES + opts.encoder_threads) * branches;
+}
+
+// 截止时间早的优先，其次优先级高的，最后按清单顺序
+static bool job_before(const BatchJob* a, const BatchJob* b) {
+    double da = a->deadline > 0 ? a->deadline : HUGE_VAL;
+    double db = b->deadline > 0 ? b->deadline : HUGE_VAL;
+    if (da != db) return da < db;
+    if (a->priority != b->priority) return a->priority > b->priority;
+    return a->index < b->index;
+}
+
+int run_batch(const BatchOptions& batch, const JobOptions& defaults) {
+    std::vector<BatchJob> jobs;
+    if (parse_manifest(batch.manifest, defaults, jobs) < 0) {
+        return -1;
+    }
+    if (jobs.empty()) {
+        std::cerr << "作业清单为空: " << batch.manifest << std::endl;
+        return -1;
+    }
+
+    int cpus = batch.cpus > 0 ? batch.cpus : (int)std::max(1u, std::thread::hardware_concurrency());
+    // 每个作业至少 4 个线程，编码效率随线程数增长在 4-8 之后明显变缓，多作业并行比单作业多线程吞吐更高
+    int max_jobs = batch.max_jobs > 0 ? batch.max_jobs : std::max(1, cpus / 4);
+    int job_threads = std::max(2, cpus / max_jobs);
+    int64_t memory_budget = batch.memory_mb > 0 ? batch.memory_mb << 20 : 0;
+
+    std::vector<BatchJob*> pending;
+    for (BatchJob& job : jobs) {
+        job.threads = job_threads;
+        job.options.decoder_threads = std::max(1, job_threads / 4);
+        job.options.encoder_threads = std::max(1, job_threads - job.options.decoder_threads);
+        if (job.options.frame_queue_limit <= 0) {
+            job.options.frame_queue_limit = batch.frame_queue_limit;
+        }
+        estimate_job(job);
+        pending.push_back(&job);
+    }
+    std::stable_sort(pending.begin(), pending.end(), job_before);
+
+    std::cout << "批处理: " << jobs.size() << " 个作业，CPU 预算 " << cpus << " 线程，最多并发 " << max_jobs
+              << " 个，每个作业 " << job_threads << " 线程";
+    if (memory_budget > 0) std::cout << "，内存预算 " << batch.memory_mb << " MB";
+    std::cout << std::endl;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    int running = 0;
+    int used_threads = 0;
+    int64_t used_memory = 0;
+    std::vector<std::thread> workers;
+    // 各 NUMA 节点上正在运行的作业数，自动放置时新作业放到作业最少的节点
+    std::vector<int> node_jobs(numa_node_count(), 0);
+    int64_t batch_start = av_gettime_relative();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    size_t next = 0;
+    while (next < pending.size() || running > 0) {
+        // 按顺序准入，队首放不下时等待，不越过截止时间更早的作业
+        while (next < pending.size()) {
+            BatchJob* job = pending[next];
+            bool fits = running < max_jobs && used_threads + job->threads <= cpus &&
+                        (memory_budget == 0 || used_memory + job->memory <= memory_budget);
+            if (!fits && running > 0) break;
+
+            double elapsed = (av_gettime_relative() - batch_start) / 1000000.0;
+            if (job->deadline > 0) {
+                // 截止时间交给编码强度控制，按剩余时间调整预设
+                job->options.effort.deadline = std::max(1.0, job->deadline - elapsed);
+            }
+            std::cout << "启动作业 #" << job->index << ": " << job->options.inputs[0] << " -> " << job->options.output
+                      << "（估算内存 " << (job->memory >> 20) << " MB，" << job->threads << " 线程）" << std::endl;
+
+            if (job->options.placement.policy != PLACEMENT_OFF && job->options.placement.node < 0) {
+                job->options.placement.node = (int)(std::min_element(node_jobs.begin(), node_jobs.end()) - node_jobs.begin());
+            }
+            int node = job->options.placement.policy != PLACEMENT_OFF ? job->options.placement.node : -1;
+            if (node >= 0 && node < (int)node_jobs.size()) node_jobs[node]++;
+
+            job->options.start_time = av_gettime_relative();
+            running++;
+            used_threads += job->threads;
+            used_memory += job->memory;
+            next++;
+            workers.emplace_back([&, job, node]() {
+                int64_t start = av_gettime_relative();
+                int result = job->options.checkpoint_interval > 0 ? run_resumable_job(job->options) : run_transcode_job(job->options);
+                std::lock_guard<std::mutex> guard(mutex);
+                job->result = result;
+                job->wall_time = (av_gettime_relative() - start) / 1000000.0;
+                running--;
+                used_threads -= job->threads;
+                used_memory -= job->memory;
+                if (node >= 0 && node < (int)node_jobs.size()) node_jobs[node]--;
+                finished.notify_all();
+            });
+        }
+        if (running > 0) {
+            finished.wait(lock);
+        }
+    }
+    lock.unlock();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double wall = (av_gettime_relative() - batch_start) / 1000000.0;
+    double media = 0;
+    int failed = 0;
+    for (const BatchJob& job : jobs) {
+        media += job.media_duration;
+        if (job.result != 0) failed++;
+        std::cout << "作业 #" << job.index << " " << (job.result == 0 ? "完成" : "失败") << "，耗时 " << job.wall_time << " 秒";
+        if (job.deadline > 0) {
+            std::cout << "（截止 " << job.deadline << " 秒）";
+        }
+        std::cout << ": " << job.options.output << std::endl;
+    }
+    std::cout << "批处理完成: " << jobs.size() << " 个作业，失败 " << failed << " 个，总耗时 " << wall
+              << " 秒，总吞吐 " << (wall > 0 ? media / wall : 0) << " 倍实时" << std::endl;
+    return failed == 0 ? 0 : -1;
+}
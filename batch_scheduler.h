@@ -0,0 +1,12 @@
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+#include "job_options.h"
+
+// 批处理：读取作业清单，在同一进程内并发运行多个转码作业。
+// 作业按截止时间从早到晚、优先级从高到低排队；CPU 预算按并发数平分为各作业的解码、编码线程，
+// 每个作业的内存占用按帧尺寸、帧队列上限和编码器前瞻帧数估算，总和不超过内存预算时才启动下一个。
+// defaults 为命令行上的其余参数，作为每个作业的默认值。全部成功返回 0
+int run_batch(const BatchOptions& batch, const JobOptions& defaults);
+
+#endif
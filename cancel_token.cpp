@@ -0,0 +1,57 @@
+#include "cancel_token.h"
+#include <iostream>
+#include <vector>
+
+extern "C" {
+#include "libavutil/error.h"
+}
+
+bool CancelToken::cancel(int error, const std::string& stage) {
+    std::vector<std::function<void()>> wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (flag.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        first_error = error;
+        first_stage = stage;
+        flag.store(true, std::memory_order_release);
+        for (auto& listener : listeners) {
+            wake.push_back(listener.second);
+        }
+    }
+
+    char errbuf[AV_ERROR_MAX_STRING_SIZE] = "未知错误";
+    if (error < 0) {
+        av_strerror(error, errbuf, sizeof(errbuf));
+    }
+    std::cerr << "作业取消: " << stage << " 出错（" << errbuf << "），停止所有阶段" << std::endl;
+
+    // 回调中会获取各队列的锁，不能持有令牌的锁调用
+    for (auto& callback : wake) {
+        callback();
+    }
+    return true;
+}
+
+int CancelToken::error() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first_error;
+}
+
+std::string CancelToken::stage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return first_stage;
+}
+
+int CancelToken::add_listener(const std::function<void()>& wake) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int id = next_id++;
+    listeners[id] = wake;
+    return id;
+}
+
+void CancelToken::remove_listener(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    listeners.erase(id);
+}
@@ -0,0 +1,39 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+// 作业级取消令牌。作业的所有 PacketQueue / FrameQueue 挂接同一个令牌，任一阶段出错时调用 cancel：
+// 只保留第一个错误，随后每个队列释放已排队的包和帧并唤醒等待者，之后 push 直接释放新数据、pop 返回 nullptr，
+// 上下游各阶段都按正常结束路径在毫秒级内退出，不会阻塞在无人消费或无人生产的队列上
+class CancelToken {
+public:
+    CancelToken() = default;
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    // 记录错误并取消作业，返回 true 表示这是第一个错误
+    bool cancel(int error, const std::string& stage);
+    bool cancelled() const { return flag.load(std::memory_order_acquire); }
+    int error() const;
+    // 第一个出错的阶段名
+    std::string stage() const;
+
+    // 队列挂接时注册唤醒回调，返回编号，队列析构时注销
+    int add_listener(const std::function<void()>& wake);
+    void remove_listener(int id);
+
+private:
+    std::atomic<bool> flag{false};
+    mutable std::mutex mutex;
+    int first_error = 0;
+    std::string first_stage;
+    std::map<int, std::function<void()>> listeners;
+    int next_id = 0;
+};
+
+#endif
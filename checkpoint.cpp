@@ -0,0 +1,248 @@
+#include "checkpoint.h"
+#include "segment_plan.h"
+#include "segment_cache.h"
+#include "input_probe.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <memory>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/time.h"
+}
+
+struct CheckpointSegment {
+    SegmentRange range;
+    bool done = false;
+    int64_t size = 0;             // 分段文件字节数
+    int64_t output_duration = 0;  // 分段输出时长（AV_TIME_BASE）
+};
+
+struct Checkpoint {
+    std::string input;
+    int64_t input_size = 0;
+    int64_t input_mtime_ns = 0;
+    double interval = 0;
+    float speed = 1.0;
+    std::string config;           // 编码配置（见 segment_encode_config）
+    std::vector<CheckpointSegment> segments;
+};
+
+static std::string checkpoint_file(const std::string& output) {
+    return output + ".checkpoint";
+}
+
+static int input_identity(const std::string& path, int64_t* size, int64_t* mtime_ns) {
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0) {
+        return -1;
+    }
+    *size = st.st_size;
+    *mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return 0;
+}
+
+// 文件内容落盘，检查点记录的分段在断电后仍然完整
+static void sync_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// 先写临时文件、落盘后再改名，中断时旧检查点保持完整
+static int write_checkpoint(const std::string& file, const Checkpoint& checkpoint) {
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp.c_str());
+        out << "input=" << checkpoint.input << "\n"
+            << "input_size=" << checkpoint.input_size << "\n"
+            << "input_mtime_ns=" << checkpoint.input_mtime_ns << "\n"
+            << "interval=" << checkpoint.interval << "\n"
+            << "speed=" << checkpoint.speed << "\n"
+            << "config=" << checkpoint.config << "\n"
+            << "segments=" << checkpoint.segments.size() << "\n";
+        int64_t output_offset = 0, time_offset = 0;
+        for (const CheckpointSegment& segment : checkpoint.segments) {
+            const SegmentRange& range = segment.range;
+            out << "segment." << range.index << "=" << range.start << " " << range.end << " " << range.file << "\n";
+            if (segment.done) {
+                // 大小和时长用于恢复时校验；两个偏移为该段在最终输出中的起点，便于核对
+                out << "done." << range.index << "=" << segment.size << " " << segment.output_duration << " "
+                    << output_offset << " " << time_offset << "\n";
+                output_offset += segment.size;
+                time_offset += segment.output_duration;
+            }
+        }
+        out.close();
+        if (!out) {
+            unlink(tmp.c_str());
+            return -1;
+        }
+    }
+    sync_file(tmp);
+    if (rename(tmp.c_str(), file.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+static int read_checkpoint(const std::string& file, Checkpoint& checkpoint) {
+    std::ifstream in(file.c_str());
+    if (!in) {
+        return -1;
+    }
+    std::map<std::string, std::string> record;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq != std::string::npos) {
+            record[line.substr(0, eq)] = line.substr(eq + 1);
+        }
+    }
+
+    checkpoint.input = record["input"];
+    checkpoint.input_size = atoll(record["input_size"].c_str());
+    checkpoint.input_mtime_ns = atoll(record["input_mtime_ns"].c_str());
+    checkpoint.interval = atof(record["interval"].c_str());
+    checkpoint.speed = atof(record["speed"].c_str());
+    checkpoint.config = record["config"];
+    int count = atoi(record["segments"].c_str());
+    if (count <= 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        CheckpointSegment segment;
+        std::istringstream plan(record["segment." + std::to_string(i)]);
+        segment.range.index = i;
+        if (!(plan >> segment.range.start >> segment.range.end)) {
+            return -1;
+        }
+        std::getline(plan >> std::ws, segment.range.file);
+        auto done = record.find("done." + std::to_string(i));
+        if (done != record.end()) {
+            std::istringstream result(done->second);
+            segment.done = (bool)(result >> segment.size >> segment.output_duration);
+        }
+        checkpoint.segments.push_back(segment);
+    }
+    return 0;
+}
+
+// 已完成分段的文件须存在且大小与记录一致，否则重做该段
+static int verify_segments(Checkpoint& checkpoint) {
+    int done = 0;
+    for (CheckpointSegment& segment : checkpoint.segments) {
+        if (!segment.done) continue;
+        struct stat st;
+        if (stat(segment.range.file.c_str(), &st) < 0 || st.st_size != segment.size) {
+            std::cerr << "分段 #" << segment.range.index << " 的文件缺失或不完整，重新转码" << std::endl;
+            segment.done = false;
+            continue;
+        }
+        done++;
+    }
+    return done;
+}
+
+static int64_t segment_duration(const std::string& file) {
+    AVFormatContext* fmt_ctx = nullptr;
+    if (open_input(file, ProbeOptions(), &fmt_ctx) < 0) {
+        return 0;
+    }
+    int64_t duration = fmt_ctx->duration > 0 ? fmt_ctx->duration : 0;
+    avformat_close_input(&fmt_ctx);
+    return duration;
+}
+
+int run_resumable_job(const JobOptions& opts) {
+    if (opts.inputs.size() > 1 || opts.speeds.size() > 1) {
+        std::cerr << "断点续转只支持单个输入和单一速度，使用 " << opts.inputs[0] << "，速度 " << opts.speeds[0] << std::endl;
+    }
+
+    std::string file = checkpoint_file(opts.output);
+    Checkpoint checkpoint;
+    checkpoint.input = opts.inputs[0];
+    checkpoint.interval = opts.checkpoint_interval;
+    checkpoint.speed = opts.speeds[0];
+    checkpoint.config = segment_encode_config(opts);
+    if (input_identity(checkpoint.input, &checkpoint.input_size, &checkpoint.input_mtime_ns) < 0) {
+        std::cerr << "无法打开输入: " << checkpoint.input << std::endl;
+        return -1;
+    }
+
+    // 输入、分段间隔、速度和编码配置都一致时才沿用检查点，否则已完成的分段与本次参数不符
+    Checkpoint saved;
+    bool resumed = read_checkpoint(file, saved) == 0 && saved.input == checkpoint.input &&
+                   saved.input_size == checkpoint.input_size && saved.input_mtime_ns == checkpoint.input_mtime_ns &&
+                   saved.interval == checkpoint.interval && saved.speed == checkpoint.speed &&
+                   saved.config == checkpoint.config;
+    if (resumed) {
+        checkpoint.segments = saved.segments;
+        int done = verify_segments(checkpoint);
+        std::cout << "从检查点继续: 已完成 " << done << "/" << checkpoint.segments.size() << " 段" << std::endl;
+    } else {
+        std::vector<SegmentRange> ranges;
+        if (plan_segments(checkpoint.input, opts.probe, opts.checkpoint_interval, opts.output, ranges) < 0) {
+            return -1;
+        }
+        for (const SegmentRange& range : ranges) {
+            CheckpointSegment segment;
+            segment.range = range;
+            checkpoint.segments.push_back(segment);
+        }
+        if (write_checkpoint(file, checkpoint) < 0) {
+            std::cerr << "无法写入检查点: " << file << std::endl;
+            return -1;
+        }
+    }
+
+    std::unique_ptr<SegmentCache> cache;
+    if (!opts.segment_cache.dir.empty()) {
+        cache.reset(new SegmentCache(opts.segment_cache));
+    }
+
+    int64_t job_start = av_gettime_relative();
+    for (CheckpointSegment& segment : checkpoint.segments) {
+        if (segment.done) continue;
+        std::cout << "转码分段 #" << segment.range.index << "/" << checkpoint.segments.size() << std::endl;
+        if (transcode_segment(opts, segment.range, cache.get()) < 0) {
+            if (cache) cache->report();
+            std::cerr << "分段 #" << segment.range.index << " 转码失败，检查点保留在 " << file << "，重新运行即可继续" << std::endl;
+            return -1;
+        }
+
+        sync_file(segment.range.file);
+        struct stat st;
+        stat(segment.range.file.c_str(), &st);
+        segment.size = st.st_size;
+        segment.output_duration = segment_duration(segment.range.file);
+        segment.done = true;
+        if (write_checkpoint(file, checkpoint) < 0) {
+            std::cerr << "无法更新检查点: " << file << std::endl;
+        }
+    }
+    if (cache) cache->report();
+    std::cout << "全部分段转码完成，耗时 " << (av_gettime_relative() - job_start) / 1000000.0 << " 秒，开始拼接" << std::endl;
+
+    std::vector<SegmentRange> ranges;
+    for (const CheckpointSegment& segment : checkpoint.segments) {
+        ranges.push_back(segment.range);
+    }
+    if (stitch_segments(ranges, opts.output) < 0) {
+        std::cerr << "拼接分段失败，检查点保留在 " << file << std::endl;
+        return -1;
+    }
+    remove_segments(ranges, opts.output);
+    unlink(file.c_str());
+    std::cout << "转码完成，输出文件: " << opts.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "job_options.h"
+
+// 断点续转：输入按视频关键帧切分为每段约 opts.checkpoint_interval 秒，逐段转码为可独立解码的分段文件，
+// 每完成一段改写检查点文件（输出文件名加 .checkpoint）。检查点记录输入文件的身份、分段计划，
+// 以及每个已完成分段的输入区间、分段文件大小、累计输出字节偏移和输出时间戳偏移。
+// 作业中断后以相同参数重新运行，校验输入和已完成的分段文件后从第一个未完成的分段 seek 继续，
+// 重做的工作不超过一段，与作业总长无关。全部完成后拼接为最终输出，删除分段文件和检查点。成功返回 0
+int run_resumable_job(const JobOptions& opts);
+
+#endif
@@ -1,10 +1,27 @@
 #include "demuxer.h"
+#include "input_probe.h"
 #include <iostream>
+#include <cstring>
 
-void demuxer(AVFormatContext* fmt_ctx, PacketQueue& video_queue, PacketQueue& audio_queue,int video_stream,int audio_stream) {
+// 包的时间戳换算为 AV_TIME_BASE，没有时间戳时返回 AV_NOPTS_VALUE
+static int64_t packet_time(AVFormatContext* fmt_ctx, const AVPacket* pkt) {
+    int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+    if (ts == AV_NOPTS_VALUE) return AV_NOPTS_VALUE;
+    return av_rescale_q(ts, fmt_ctx->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+}
+
+void demuxer(AVFormatContext* fmt_ctx, PacketQueue& video_queue, PacketQueue& audio_queue,int video_stream,int audio_stream,
+             int64_t job_start, LatencyTracker* latency) {
     AVPacket* pkt = av_packet_alloc();
-    while(av_read_frame(fmt_ctx, pkt) >= 0) {
+    bool first_packet = true;
+    int ret;
+    while((ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        if (first_packet) {
+            report_startup_time(job_start);
+            first_packet = false;
+        }
         if(pkt->stream_index == video_stream) {
+            if (latency) latency->packet_in(packet_time(fmt_ctx, pkt));
             AVPacket* pkt_copy = av_packet_alloc();
             av_packet_ref(pkt_copy, pkt);
             video_queue.push(pkt_copy);
@@ -14,9 +31,176 @@ void demuxer(AVFormatContext* fmt_ctx, PacketQueue& video_queue, PacketQueue& au
             audio_queue.push(pkt_copy);
         }
         av_packet_unref(pkt);
+        // 下游出错取消作业后不再读取
+        if (video_queue.is_cancelled()) break;
+    }
+    if (ret < 0 && ret != AVERROR_EOF) {
+        video_queue.fail(ret, "解复用");
+    }
+    video_queue.set_eof();
+    audio_queue.set_eof();
+    av_packet_free(&pkt);
+}
+
+
+void concat_demuxer(AVFormatContext* fmt_ctx, const std::vector<std::string>& inputs, const ProbeOptions& probe, PacketQueue& video_queue, PacketQueue& audio_queue, int video_stream, int audio_stream) {
+    // 输出时间戳统一使用首个输入对应流的时间基准
+    AVRational video_tb = fmt_ctx->streams[video_stream]->time_base;
+    AVRational audio_tb = audio_stream >= 0 ? fmt_ctx->streams[audio_stream]->time_base : AV_TIME_BASE_Q;
+    enum AVCodecID video_codec = fmt_ctx->streams[video_stream]->codecpar->codec_id;
+    enum AVCodecID audio_codec = audio_stream >= 0 ? fmt_ctx->streams[audio_stream]->codecpar->codec_id : AV_CODEC_ID_NONE;
+
+    AVPacket* pkt = av_packet_alloc();
+    int64_t offset = 0; // 已拼接部分的结束时间（AV_TIME_BASE）
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        AVFormatContext* in_ctx = fmt_ctx;
+        int in_video = video_stream;
+        int in_audio = audio_stream;
+
+        if (i > 0) {
+            // 跳过任一输入都会让输出缺一段，按出错处理
+            in_ctx = nullptr;
+            int ret = open_input(inputs[i], probe, &in_ctx);
+            if (ret < 0) {
+                std::cerr << "无法打开拼接输入: " << inputs[i] << std::endl;
+                video_queue.fail(ret, "拼接");
+                break;
+            }
+
+            in_video = av_find_best_stream(in_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+            if (in_video < 0 || in_ctx->streams[in_video]->codecpar->codec_id != video_codec) {
+                std::cerr << "拼接输入的视频编码与首个输入不一致: " << inputs[i] << std::endl;
+                avformat_close_input(&in_ctx);
+                video_queue.fail(AVERROR(EINVAL), "拼接");
+                break;
+            }
+
+            in_audio = audio_stream >= 0 ? av_find_best_stream(in_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0) : -1;
+            if (in_audio >= 0 && in_ctx->streams[in_audio]->codecpar->codec_id != audio_codec) {
+                std::cerr << "拼接输入的音频编码与首个输入不一致，该段音频将被忽略: " << inputs[i] << std::endl;
+                in_audio = -1;
+            }
+        }
+
+        // 首个输入保持原始时间戳，后续输入从已拼接部分的结束时间开始
+        int64_t start = in_ctx->start_time != AV_NOPTS_VALUE ? in_ctx->start_time : 0;
+        int64_t shift = i > 0 ? offset - start : 0;
+        int64_t end = offset;
+        bool new_video_extradata = i > 0;
+        bool new_audio_extradata = i > 0;
+
+        int ret;
+        while ((ret = av_read_frame(in_ctx, pkt)) >= 0) {
+            bool is_video = pkt->stream_index == in_video;
+            bool is_audio = in_audio >= 0 && pkt->stream_index == in_audio;
+            if (!is_video && !is_audio) {
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            AVStream* st = in_ctx->streams[pkt->stream_index];
+            AVRational out_tb = is_video ? video_tb : audio_tb;
+            int64_t ts_shift = av_rescale_q(shift, AV_TIME_BASE_Q, out_tb);
+
+            av_packet_rescale_ts(pkt, st->time_base, out_tb);
+            if (pkt->pts != AV_NOPTS_VALUE) pkt->pts += ts_shift;
+            if (pkt->dts != AV_NOPTS_VALUE) pkt->dts += ts_shift;
+
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                int64_t pkt_end = av_rescale_q(ts + pkt->duration, out_tb, AV_TIME_BASE_Q);
+                if (pkt_end > end) end = pkt_end;
+            }
+
+            // 切换输入后的首个包附带新的extradata，解码器据此更新参数而无需重新打开
+            bool& new_extradata = is_video ? new_video_extradata : new_audio_extradata;
+            if (new_extradata && st->codecpar->extradata_size > 0) {
+                uint8_t* side_data = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, st->codecpar->extradata_size);
+                if (side_data) {
+                    memcpy(side_data, st->codecpar->extradata, st->codecpar->extradata_size);
+                }
+            }
+            new_extradata = false;
+
+            pkt->stream_index = is_video ? video_stream : audio_stream;
+            AVPacket* pkt_copy = av_packet_alloc();
+            av_packet_ref(pkt_copy, pkt);
+            if (is_video) {
+                video_queue.push(pkt_copy);
+            } else {
+                audio_queue.push(pkt_copy);
+            }
+            av_packet_unref(pkt);
+            if (video_queue.is_cancelled()) break;
+        }
+
+        if (in_ctx != fmt_ctx) {
+            avformat_close_input(&in_ctx);
+        }
+        if (video_queue.is_cancelled()) {
+            break;
+        }
+        if (ret < 0 && ret != AVERROR_EOF) {
+            video_queue.fail(ret, "解复用");
+            break;
+        }
+        offset = end;
+        std::cout << "拼接输入完成: " << inputs[i] << "，累计时长: " << offset / (double)AV_TIME_BASE << " 秒" << std::endl;
     }
+
     video_queue.set_eof();
     audio_queue.set_eof();
     av_packet_free(&pkt);
 }
 
+
+void segment_demuxer(AVFormatContext* fmt_ctx, PacketQueue& video_queue, PacketQueue& audio_queue, int video_stream, int audio_stream,
+                     int64_t start_time, int64_t end_time, int64_t job_start) {
+    AVPacket* pkt = av_packet_alloc();
+    bool first_packet = true;
+    bool video_started = false;
+    bool video_done = false;
+    bool audio_done = audio_stream < 0;
+    int ret;
+    while ((ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        if (first_packet) {
+            report_startup_time(job_start);
+            first_packet = false;
+        }
+        int64_t ts = packet_time(fmt_ctx, pkt);
+        if (pkt->stream_index == video_stream) {
+            bool key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+            if (key && ts != AV_NOPTS_VALUE && ts >= end_time) {
+                // 下一段的起始关键帧
+                video_done = true;
+            }
+            if (!video_started && key && ts != AV_NOPTS_VALUE && ts >= start_time) {
+                video_started = true;
+            }
+            if (video_started && !video_done) {
+                AVPacket* pkt_copy = av_packet_alloc();
+                av_packet_ref(pkt_copy, pkt);
+                video_queue.push(pkt_copy);
+            }
+        } else if (pkt->stream_index == audio_stream && ts != AV_NOPTS_VALUE) {
+            if (ts >= end_time) {
+                audio_done = true;
+            } else if (ts >= start_time) {
+                AVPacket* pkt_copy = av_packet_alloc();
+                av_packet_ref(pkt_copy, pkt);
+                audio_queue.push(pkt_copy);
+            }
+        }
+        av_packet_unref(pkt);
+        // 音视频交错存放，两路都越过区间终点才停止读取
+        if (video_done && audio_done) break;
+        if (video_queue.is_cancelled()) break;
+    }
+    if (ret < 0 && ret != AVERROR_EOF) {
+        video_queue.fail(ret, "解复用");
+    }
+    video_queue.set_eof();
+    audio_queue.set_eof();
+    av_packet_free(&pkt);
+}
@@ -13,12 +13,43 @@ extern "C" {
 #endif
 
 #include "packet_queue.h"
+#include "input_probe.h"
+#include "live_latency.h"
+#include <string>
+#include <vector>
 
+// job_start 为作业开始时刻，非 0 时读出第一个包后打印启动耗时（见 report_startup_time）。
+// latency 不为空时记录每个视频包的到达时刻（直播模式）
 void demuxer(AVFormatContext* fmt_ctx,
             PacketQueue& video_queue,
             PacketQueue& audio_queue,
             int video_stream,
-            int audio_stream);
+            int audio_stream,
+            int64_t job_start = 0,
+            LatencyTracker* latency = nullptr);
+
+// 依次读取多个输入送入同一组队列，时间戳按已读输入的累计时长偏移，
+// 首个输入由调用方打开，其余输入按 probe 的探测参数打开，编码参数须与首个输入一致；
+// 任一输入无法打开或视频编码不一致时通过 video_queue.fail 取消作业
+void concat_demuxer(AVFormatContext* fmt_ctx,
+                   const std::vector<std::string>& inputs,
+                   const ProbeOptions& probe,
+                   PacketQueue& video_queue,
+                   PacketQueue& audio_queue,
+                   int video_stream,
+                   int audio_stream);
+
+// 只读取 [start_time, end_time) 区间（AV_TIME_BASE），调用方已 seek 到 start_time 之前的关键帧。
+// 视频从时间戳不早于 start_time 的关键帧开始，遇到不早于 end_time 的关键帧结束，
+// 区间边界取自关键帧时，相邻区间的视频包不重不漏；音频按包的时间戳截取
+void segment_demuxer(AVFormatContext* fmt_ctx,
+                    PacketQueue& video_queue,
+                    PacketQueue& audio_queue,
+                    int video_stream,
+                    int audio_stream,
+                    int64_t start_time,
+                    int64_t end_time,
+                    int64_t job_start = 0);
 
 
 #endif
@@ -0,0 +1,89 @@
+#include "effort_controller.h"
+#include <iostream>
+#include <algorithm>
+
+extern "C" {
+#include "libavutil/time.h"
+}
+
+// 队列平均深度超过该值视为编码器是瓶颈
+static const double BACKLOG_DEPTH = 8.0;
+// 测得速度超过目标的该倍数时升一档预设
+static const double HEADROOM = 1.3;
+
+EffortController::EffortController(const EffortControlOptions& options, const std::string& initial_preset, AVRational frame_rate,
+                                   float speed, int gop_size, double media_duration)
+    : options(options), media_duration(media_duration) {
+    // 由快到慢；ultrafast/superfast 会关闭 CABAC 和 B 帧，与固定的流头参数冲突，不在阶梯内
+    ladder = {"veryfast", "faster", "fast", "medium", "slow"};
+    auto it = std::find(ladder.begin(), ladder.end(), initial_preset);
+    level = it != ladder.end() ? (int)(it - ladder.begin()) : 3;
+
+    // 实时倍数、剩余内容都按输出时长计算，与 media_duration 的单位一致
+    frame_duration = (frame_rate.num > 0 && frame_rate.den > 0 ? av_q2d(av_inv_q(frame_rate)) : 1.0 / 25) / (speed > 0 ? speed : 1.0f);
+    window_frames = std::max(1, gop_size) * std::max(1, options.decision_gops);
+    start_time = av_gettime_relative();
+    window_start = start_time;
+}
+
+void EffortController::observe_queue_depth(int depth) {
+    depth_sum += depth;
+    depth_samples++;
+}
+
+bool EffortController::before_frame(std::string* preset) {
+    if (frames_in_window < window_frames) {
+        frames_in_window++;
+        total_frames++;
+        return false;
+    }
+
+    int64_t now = av_gettime_relative();
+    double wall = (now - window_start) / 1000000.0;
+    double speed = wall > 0 ? frames_in_window * frame_duration / wall : 0;
+    double depth = depth_samples > 0 ? (double)depth_sum / depth_samples : 0;
+
+    double target = options.target_speed;
+    if (options.deadline > 0) {
+        // 剩余内容时长 / 剩余时间；已超时则按最快处理
+        double remaining_media = std::max(0.0, media_duration - total_frames * frame_duration);
+        double remaining_time = options.deadline - (now - start_time) / 1000000.0;
+        target = remaining_time > 0 ? remaining_media / remaining_time : 1e9;
+    }
+
+    int new_level = level;
+    if (speed < target && depth > BACKLOG_DEPTH) {
+        new_level = std::max(0, level - 1);
+    } else if (speed > target * HEADROOM) {
+        new_level = std::min((int)ladder.size() - 1, level + 1);
+    }
+
+    window_start = now;
+    frames_in_window = 1;
+    total_frames++;
+    depth_sum = 0;
+    depth_samples = 0;
+
+    if (new_level == level) {
+        return false;
+    }
+
+    Decision decision = { (now - start_time) / 1000000.0, speed, target, depth, ladder[level], ladder[new_level] };
+    decisions.push_back(decision);
+    std::cout << "编码强度调整: 实时倍数 " << speed << "（目标 " << target << "），队列深度 " << depth
+              << "，预设 " << decision.from << " -> " << decision.to << std::endl;
+    level = new_level;
+    *preset = ladder[level];
+    return true;
+}
+
+void EffortController::report(const std::string& name) const {
+    double elapsed = (av_gettime_relative() - start_time) / 1000000.0;
+    std::cout << "编码强度控制 [" << name << "]: 共 " << total_frames << " 帧，耗时 " << elapsed
+              << " 秒，实时倍数 " << (elapsed > 0 ? total_frames * frame_duration / elapsed : 0)
+              << "，调整 " << decisions.size() << " 次，最终预设 " << ladder[level] << std::endl;
+    for (const Decision& d : decisions) {
+        std::cout << "  " << d.elapsed << " 秒: " << d.from << " -> " << d.to << "（实时倍数 " << d.speed
+                  << "，目标 " << d.target << "，队列深度 " << d.queue_depth << "）" << std::endl;
+    }
+}
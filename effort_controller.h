@@ -0,0 +1,69 @@
+#ifndef EFFORT_CONTROLLER_H
+#define EFFORT_CONTROLLER_H
+
+#include <string>
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavcodec/avcodec.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+// 编码强度控制参数
+struct EffortControlOptions {
+    double target_speed = 0;  // 目标实时倍数（输出时长 / 墙钟时长），0 为不控制
+    double deadline = 0;      // 作业截止时长（秒），设置后按剩余内容和剩余时间换算目标倍数
+    int decision_gops = 4;    // 每隔几个 GOP 评估一次
+};
+
+// 闭环编码强度控制：统计滤波器图输出到编码器的帧率和输入帧队列深度，
+// 在 GOP 边界沿 libx264 预设阶梯调整，追赶目标实时倍数或截止时间。
+// 编码器是瓶颈（队列积压）且速度不足时降一档预设，速度富余时升一档换取画质
+class EffortController {
+public:
+    // frame_rate 为输入帧率，speed 为该路的变速倍率：变速只改时间戳不丢帧，一帧的输出时长为输入帧时长 / speed。
+    // media_duration 为输出内容总时长（秒），只在设置 deadline 时使用
+    EffortController(const EffortControlOptions& options, const std::string& initial_preset, AVRational frame_rate,
+                     float speed, int gop_size, double media_duration);
+
+    // 编码线程：记录输入帧队列深度
+    void observe_queue_depth(int depth);
+    // 编码线程：每送入编码器一帧前调用。到达决策点且需要调整时返回 true，preset 为新预设，
+    // 调用方冲洗并重新打开编码器后再送入这一帧
+    bool before_frame(std::string* preset);
+
+    // 打印决策记录和最终预设
+    void report(const std::string& name) const;
+
+private:
+    struct Decision {
+        double elapsed;        // 作业开始后的墙钟时间（秒）
+        double speed;          // 本窗口测得的实时倍数
+        double target;         // 本窗口的目标倍数
+        double queue_depth;    // 本窗口平均队列深度
+        std::string from, to;
+    };
+
+    EffortControlOptions options;
+    std::vector<std::string> ladder;
+    int level = 0;
+    double frame_duration = 0;  // 一帧的输出时长（秒）
+    int window_frames = 0;      // 决策窗口帧数
+    double media_duration = 0;
+
+    int64_t start_time = 0;
+    int64_t window_start = 0;
+    int frames_in_window = 0;
+    int64_t total_frames = 0;
+    int64_t depth_sum = 0;
+    int depth_samples = 0;
+
+    std::vector<Decision> decisions;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "farm_transport.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// 解析地址，tcp 返回 true 并拆出主机和端口，否则 path 为 Unix 套接字路径
+static bool parse_address(const std::string& address, std::string* host, std::string* port, std::string* path) {
+    if (address.compare(0, 4, "tcp:") == 0) {
+        std::string rest = address.substr(4);
+        size_t colon = rest.find_last_of(':');
+        *host = colon == std::string::npos ? "" : rest.substr(0, colon);
+        *port = colon == std::string::npos ? rest : rest.substr(colon + 1);
+        return true;
+    }
+    *path = address.compare(0, 5, "unix:") == 0 ? address.substr(5) : address;
+    return false;
+}
+
+static int unix_address(const std::string& path, sockaddr_un* addr) {
+    if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+        std::cerr << "无效的 Unix 套接字路径: " << path << std::endl;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path.c_str(), path.size());
+    return 0;
+}
+
+static addrinfo* resolve(const std::string& host, const std::string& port, bool passive) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    int ret = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (ret != 0) {
+        std::cerr << "无法解析地址 " << host << ":" << port << ": " << gai_strerror(ret) << std::endl;
+        return nullptr;
+    }
+    return result;
+}
+
+int farm_listen(const std::string& address) {
+    std::string host, port, path;
+    if (parse_address(address, &host, &port, &path)) {
+        addrinfo* result = resolve(host, port, true);
+        if (!result) return -1;
+        int fd = -1;
+        for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd < 0) continue;
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 64) < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+        if (fd < 0) {
+            std::cerr << "无法监听 " << address << ": " << strerror(errno) << std::endl;
+        }
+        return fd;
+    }
+
+    sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) return -1;
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        std::cerr << "无法监听 " << address << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 尝试连接一次
+static int connect_once(const std::string& address) {
+    std::string host, port, path;
+    if (parse_address(address, &host, &port, &path)) {
+        addrinfo* result = resolve(host, port, false);
+        if (!result) return -1;
+        int fd = -1;
+        for (addrinfo* ai = result; ai && fd < 0; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+            if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(result);
+        return fd;
+    }
+
+    sockaddr_un addr;
+    if (unix_address(path, &addr) < 0) return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+int farm_connect(const std::string& address, int timeout_ms) {
+    for (int waited = 0;; waited += 100) {
+        int fd = connect_once(address);
+        if (fd >= 0) return fd;
+        if (waited >= timeout_ms) break;
+        usleep(100 * 1000);
+    }
+    std::cerr << "无法连接到 " << address << ": " << strerror(errno) << std::endl;
+    return -1;
+}
+
+int farm_send_line(int fd, const std::string& line) {
+    std::string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        sent += n;
+    }
+    return 0;
+}
+
+int farm_recv_line(int fd, std::string& buffer, std::string* line) {
+    for (;;) {
+        size_t newline = buffer.find('\n');
+        if (newline != std::string::npos) {
+            *line = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            return 0;
+        }
+        char chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buffer.append(chunk, n);
+    }
+}
+
+void farm_close_listener(int fd, const std::string& address) {
+    if (fd >= 0) close(fd);
+    std::string host, port, path;
+    if (!parse_address(address, &host, &port, &path)) {
+        unlink(path.c_str());
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef FARM_TRANSPORT_H
+#define FARM_TRANSPORT_H
+
+#include <string>
+
+// 分段农场的协调进程与工作进程之间的连接。地址形如 unix:/tmp/farm.sock 或 tcp:host:port，
+// 不带前缀时视为 Unix 套接字路径。消息为以换行结尾的一行文本，收发函数只处理整行
+
+// 在地址上监听，返回套接字描述符，失败返回 -1。Unix 套接字会先删除残留的同名文件
+int farm_listen(const std::string& address);
+
+// 连接到地址，失败时每隔 100ms 重试，直到超过 timeout_ms，返回套接字描述符或 -1
+int farm_connect(const std::string& address, int timeout_ms);
+
+// 发送一行消息（不含换行），失败返回 -1
+int farm_send_line(int fd, const std::string& line);
+
+// 读取一行消息，buffer 保存上次读多的数据。连接关闭或出错返回 -1
+int farm_recv_line(int fd, std::string& buffer, std::string* line);
+
+// 关闭监听套接字，Unix 套接字同时删除文件
+void farm_close_listener(int fd, const std::string& address);
+
+#endif
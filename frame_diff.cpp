@@ -0,0 +1,192 @@
+#include "frame_diff.h"
+#include <cstdlib>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DIFF_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DIFF_NEON 1
+#endif
+
+static const int BLOCK_SIZE = 16;
+
+// 标量计算一个 bw x rows 块的 SAD
+static int block_sad_c(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int bw, int rows) {
+    int sum = 0;
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < bw; x++) {
+            sum += abs(a[x] - b[x]);
+        }
+        a += a_stride;
+        b += b_stride;
+    }
+    return sum;
+}
+
+// 检查一行块（rows 行高）从 x 列开始的剩余部分，按块宽 16 逐块标量计算
+static bool row_changed_c(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int x, int width, int rows, int threshold) {
+    for (; x < width; x += BLOCK_SIZE) {
+        int bw = std::min(BLOCK_SIZE, width - x);
+        if (block_sad_c(a + x, a_stride, b + x, b_stride, bw, rows) > threshold * bw * rows) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef bool (*PlaneChangedFunc)(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                                 int width, int height, int threshold);
+
+static bool plane_changed_c(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                            int width, int height, int threshold) {
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        int rows = std::min(BLOCK_SIZE, height - y);
+        if (row_changed_c(a + (ptrdiff_t)y * a_stride, a_stride, b + (ptrdiff_t)y * b_stride, b_stride, 0, width, rows, threshold)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef DIFF_X86
+static bool plane_changed_sse2(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                               int width, int height, int threshold) {
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        int rows = std::min(BLOCK_SIZE, height - y);
+        const uint8_t* ra = a + (ptrdiff_t)y * a_stride;
+        const uint8_t* rb = b + (ptrdiff_t)y * b_stride;
+        int limit = threshold * BLOCK_SIZE * rows;
+        int x = 0;
+        for (; x + BLOCK_SIZE <= width; x += BLOCK_SIZE) {
+            __m128i acc = _mm_setzero_si128();
+            for (int r = 0; r < rows; r++) {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ra + (ptrdiff_t)r * a_stride + x));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rb + (ptrdiff_t)r * b_stride + x));
+                acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+            }
+            int sum = _mm_cvtsi128_si32(acc) + _mm_extract_epi16(acc, 4);
+            if (sum > limit) return true;
+        }
+        if (row_changed_c(ra, a_stride, rb, b_stride, x, width, rows, threshold)) return true;
+    }
+    return false;
+}
+
+// 一次处理水平相邻的两个块，256 位 SAD 的低/高 128 位分别对应左/右块
+__attribute__((target("avx2")))
+static bool plane_changed_avx2(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                               int width, int height, int threshold) {
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        int rows = std::min(BLOCK_SIZE, height - y);
+        const uint8_t* ra = a + (ptrdiff_t)y * a_stride;
+        const uint8_t* rb = b + (ptrdiff_t)y * b_stride;
+        int limit = threshold * BLOCK_SIZE * rows;
+        int x = 0;
+        for (; x + 2 * BLOCK_SIZE <= width; x += 2 * BLOCK_SIZE) {
+            __m256i acc = _mm256_setzero_si256();
+            for (int r = 0; r < rows; r++) {
+                __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ra + (ptrdiff_t)r * a_stride + x));
+                __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rb + (ptrdiff_t)r * b_stride + x));
+                acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, vb));
+            }
+            int left = _mm256_extract_epi32(acc, 0) + _mm256_extract_epi32(acc, 2);
+            int right = _mm256_extract_epi32(acc, 4) + _mm256_extract_epi32(acc, 6);
+            if (left > limit || right > limit) return true;
+        }
+        if (row_changed_c(ra, a_stride, rb, b_stride, x, width, rows, threshold)) return true;
+    }
+    return false;
+}
+#endif
+
+#ifdef DIFF_NEON
+static bool plane_changed_neon(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride,
+                               int width, int height, int threshold) {
+    for (int y = 0; y < height; y += BLOCK_SIZE) {
+        int rows = std::min(BLOCK_SIZE, height - y);
+        const uint8_t* ra = a + (ptrdiff_t)y * a_stride;
+        const uint8_t* rb = b + (ptrdiff_t)y * b_stride;
+        int limit = threshold * BLOCK_SIZE * rows;
+        int x = 0;
+        for (; x + BLOCK_SIZE <= width; x += BLOCK_SIZE) {
+            uint16x8_t acc = vdupq_n_u16(0);
+            for (int r = 0; r < rows; r++) {
+                uint8x16_t diff = vabdq_u8(vld1q_u8(ra + (ptrdiff_t)r * a_stride + x), vld1q_u8(rb + (ptrdiff_t)r * b_stride + x));
+                acc = vpadalq_u8(acc, diff);
+            }
+            uint32x4_t sum4 = vpaddlq_u16(acc);
+            uint64x2_t sum2 = vpaddlq_u32(sum4);
+            int sum = (int)(vgetq_lane_u64(sum2, 0) + vgetq_lane_u64(sum2, 1));
+            if (sum > limit) return true;
+        }
+        if (row_changed_c(ra, a_stride, rb, b_stride, x, width, rows, threshold)) return true;
+    }
+    return false;
+}
+#endif
+
+static PlaneChangedFunc select_plane_changed() {
+#ifdef DIFF_X86
+    int flags = av_get_cpu_flags();
+    if (flags & AV_CPU_FLAG_AVX2) return plane_changed_avx2;
+    if (flags & AV_CPU_FLAG_SSE2) return plane_changed_sse2;
+#endif
+#ifdef DIFF_NEON
+    return plane_changed_neon;
+#endif
+    return plane_changed_c;
+}
+
+static const PlaneChangedFunc plane_changed = select_plane_changed();
+
+StaticFrameDetector::~StaticFrameDetector() {
+    av_frame_free(&reference);
+}
+
+bool StaticFrameDetector::differs(const AVFrame* frame) const {
+    if (frame->width != reference->width || frame->height != reference->height || frame->format != reference->format) {
+        return true;
+    }
+
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (!desc || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR) || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) ||
+        desc->comp[0].depth > 8) {
+        return true;
+    }
+
+    // 按字节计算各平面行宽，NV12 等交错色度平面同样适用
+    int row_bytes[4];
+    if (av_image_fill_linesizes(row_bytes, static_cast<AVPixelFormat>(frame->format), frame->width) < 0) {
+        return true;
+    }
+
+    // 先比较亮度，大多数有变化的帧在亮度平面就能提前返回
+    int planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(frame->format));
+    for (int i = 0; i < planes; i++) {
+        int width = row_bytes[i];
+        int height = i == 1 || i == 2 ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        if (plane_changed(frame->data[i], frame->linesize[i], reference->data[i], reference->linesize[i],
+                          width, height, threshold)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StaticFrameDetector::is_static(const AVFrame* frame) {
+    if (reference && !differs(frame)) {
+        return true;
+    }
+
+    av_frame_free(&reference);
+    reference = av_frame_clone(frame);
+    return false;
+}
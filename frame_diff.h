@@ -0,0 +1,36 @@
+#ifndef FRAME_DIFF_H
+#define FRAME_DIFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavutil/frame.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// 静止帧检测：把帧按 16x16 分块，与上一个保留帧逐块计算 SAD（SIMD），
+// 所有块的平均每像素绝对差都不超过阈值时视为与上一帧相同。
+// 只比较 8 位平面格式，其他格式一律视为有变化。
+class StaticFrameDetector {
+public:
+    StaticFrameDetector() = default;
+    ~StaticFrameDetector();
+    StaticFrameDetector(const StaticFrameDetector&) = delete;
+    StaticFrameDetector& operator=(const StaticFrameDetector&) = delete;
+
+    void set_threshold(int threshold) { this->threshold = threshold; }
+
+    // 与参考帧相同返回 true；否则返回 false，并把该帧作为新的参考帧
+    bool is_static(const AVFrame* frame);
+
+private:
+    int threshold = 2;
+    AVFrame* reference = nullptr;
+
+    bool differs(const AVFrame* frame) const;
+};
+
+#endif
@@ -0,0 +1,188 @@
+#include "frame_pool.h"
+#include "thread_placement.h"
+#include <iostream>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+// 平面起始地址和行宽的对齐，满足 AVX-512 加载以及编码器的要求
+static const int FRAME_ALIGN = 64;
+// 小于一个大页的缓冲不值得单独映射，直接走普通分配
+static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+int parse_frame_pool_mode(const std::string& name, FramePoolMode& mode) {
+    if (name == "off") {
+        mode = FRAME_POOL_OFF;
+    } else if (name == "pool") {
+        mode = FRAME_POOL_DEFAULT;
+    } else if (name == "thp") {
+        mode = FRAME_POOL_THP;
+    } else if (name == "hugetlb") {
+        mode = FRAME_POOL_HUGETLB;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static void unmap_buffer(void* opaque, uint8_t* data) {
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+
+// 缓冲池的分配函数，大缓冲按模式使用大页，指定 NUMA 节点时单独映射并绑定到该节点
+static AVBufferRef* alloc_frame_buffer(void* opaque, int size) {
+    FramePool* pool = static_cast<FramePool*>(opaque);
+    if ((pool->mode == FRAME_POOL_DEFAULT && pool->numa_node < 0) || (size_t)size < HUGE_PAGE_SIZE) {
+        return av_buffer_alloc(size);
+    }
+
+    size_t length = FFALIGN((size_t)size, HUGE_PAGE_SIZE);
+    void* data = MAP_FAILED;
+    if (pool->mode == FRAME_POOL_HUGETLB && MAP_HUGETLB) {
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (data == MAP_FAILED) {
+        // 没有预留大页时退回透明大页
+        data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (pool->mode != FRAME_POOL_DEFAULT) {
+            madvise(data, length, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    // 绑定在首次写入之前，页面从作业所在节点分配
+    ThreadPlacement::bind_memory(data, length, pool->numa_node);
+
+    AVBufferRef* buf = av_buffer_create(static_cast<uint8_t*>(data), size, unmap_buffer, (void*)(uintptr_t)length, 0);
+    if (!buf) {
+        munmap(data, length);
+    }
+    return buf;
+}
+
+static void uninit_pools(FramePool* pool) {
+    for (int i = 0; i < 4; i++) {
+        // 仍被帧引用的缓冲在最后一个引用释放时随池一起回收
+        av_buffer_pool_uninit(&pool->pools[i]);
+    }
+    pool->nb_planes = 0;
+}
+
+// 按新的分辨率和像素格式重建各平面的缓冲池
+static int configure_pools(FramePool* pool, AVCodecContext* s, const AVFrame* frame) {
+    uninit_pools(pool);
+
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+
+    // 解码器可能写出超出可见区域的宏块，按其要求对齐尺寸
+    int width = frame->width;
+    int height = frame->height;
+    int stride_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(s, &width, &height, stride_align);
+
+    int linesizes[4];
+    int ret = av_image_fill_linesizes(linesizes, format, width);
+    if (ret < 0) {
+        return ret;
+    }
+
+    pool->nb_planes = av_pix_fmt_count_planes(format);
+    for (int i = 0; i < pool->nb_planes; i++) {
+        int align = FFMAX(FRAME_ALIGN, stride_align[i]);
+        pool->linesize[i] = FFALIGN(linesizes[i], align);
+        int rows = i == 1 || i == 2 ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+        // 末尾留出 SIMD 越界读取的填充，并预留起始地址对齐的余量
+        int size = pool->linesize[i] * rows + AV_INPUT_BUFFER_PADDING_SIZE + FRAME_ALIGN;
+        pool->pools[i] = av_buffer_pool_init2(size, pool, alloc_frame_buffer, nullptr);
+        if (!pool->pools[i]) {
+            uninit_pools(pool);
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    pool->width = frame->width;
+    pool->height = frame->height;
+    pool->format = frame->format;
+    std::cout << "解码帧缓冲池: " << av_get_pix_fmt_name(format) << " " << frame->width << "x" << frame->height
+              << "，行宽 " << pool->linesize[0] << std::endl;
+    return 0;
+}
+
+static int frame_pool_get_buffer2(AVCodecContext* s, AVFrame* frame, int flags) {
+    FramePool* pool = static_cast<FramePool*>(s->opaque);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (!pool || !(s->codec->capabilities & AV_CODEC_CAP_DR1) || !desc ||
+        (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+        return avcodec_default_get_buffer2(s, frame, flags);
+    }
+
+    // 帧级多线程解码时会从多个线程同时调用
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (frame->width != pool->width || frame->height != pool->height || frame->format != pool->format) {
+        int ret = configure_pools(pool, s, frame);
+        if (ret < 0) {
+            std::cerr << "无法创建解码帧缓冲池，使用默认分配" << std::endl;
+            pool->format = -1;
+            return avcodec_default_get_buffer2(s, frame, flags);
+        }
+    }
+
+    for (int i = 0; i < pool->nb_planes; i++) {
+        frame->buf[i] = av_buffer_pool_get(pool->pools[i]);
+        if (!frame->buf[i]) {
+            av_frame_unref(frame);
+            return AVERROR(ENOMEM);
+        }
+        uintptr_t addr = reinterpret_cast<uintptr_t>(frame->buf[i]->data);
+        frame->data[i] = reinterpret_cast<uint8_t*>(FFALIGN(addr, (uintptr_t)FRAME_ALIGN));
+        frame->linesize[i] = pool->linesize[i];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+FramePool* frame_pool_install(AVCodecContext* dec_ctx, FramePoolMode mode, int numa_node) {
+    if (mode == FRAME_POOL_OFF) {
+        return nullptr;
+    }
+
+    FramePool* pool = new FramePool;
+    pool->mode = mode;
+    pool->numa_node = numa_node;
+    dec_ctx->opaque = pool;
+    dec_ctx->get_buffer2 = frame_pool_get_buffer2;
+#if FF_API_THREAD_SAFE_CALLBACKS
+    dec_ctx->thread_safe_callbacks = 1;
+#endif
+    return pool;
+}
+
+void frame_pool_free(FramePool** pool) {
+    if (!*pool) {
+        return;
+    }
+    uninit_pools(*pool);
+    delete *pool;
+    *pool = nullptr;
+}
+
+void report_memory_usage() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        std::cout << "内存统计: 次缺页 " << usage.ru_minflt << "，主缺页 " << usage.ru_majflt
+                  << "，峰值常驻内存 " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <string>
+#include <mutex>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// 解码帧缓冲的内存来源
+enum FramePoolMode {
+    FRAME_POOL_OFF,      // 使用 libavcodec 默认分配
+    FRAME_POOL_DEFAULT,  // 普通内存缓冲池
+    FRAME_POOL_THP,      // 大缓冲使用 mmap + madvise(MADV_HUGEPAGE) 透明大页
+    FRAME_POOL_HUGETLB   // 大缓冲使用 MAP_HUGETLB 预留大页，失败时退回透明大页
+};
+
+// 解码器帧缓冲池：按分辨率和像素格式为每个平面维护一个 AVBufferPool，
+// 编码器释放帧后缓冲立即回到池中复用，避免每帧重新分配、缺页
+struct FramePool {
+    FramePoolMode mode = FRAME_POOL_DEFAULT;
+    int numa_node = -1;  // 大缓冲绑定到该 NUMA 节点，-1 为不绑定
+    std::mutex mutex;
+
+    int width = 0;
+    int height = 0;
+    int format = -1;
+    int nb_planes = 0;
+    int linesize[4] = {};
+    AVBufferPool* pools[4] = {};
+};
+
+// 解析 off/pool/thp/hugetlb，失败返回 -1
+int parse_frame_pool_mode(const std::string& name, FramePoolMode& mode);
+
+// 为解码器安装 get_buffer2 回调，须在 avcodec_open2 之前调用。numa_node 不为 -1 时大缓冲绑定到该节点的内存。
+// 返回的缓冲池须在解码器上下文释放后再用 frame_pool_free 释放
+FramePool* frame_pool_install(AVCodecContext* dec_ctx, FramePoolMode mode, int numa_node = -1);
+
+void frame_pool_free(FramePool** pool);
+
+// 打印进程的缺页次数和峰值常驻内存
+void report_memory_usage();
+
+#endif
@@ -2,6 +2,7 @@
 #define FRAME_QUEUE_H
 
 #include "Queue.h"
+#include "cancel_token.h"
 #include <mutex>
 #include <condition_variable>
 
@@ -19,31 +20,94 @@ struct FrameQueue {
     Queue<AVFrame*> queue;
     std::mutex mutex;
     std::condition_variable cond;
+    std::condition_variable not_full;
     bool eof = false;
+    bool cancelled = false;
+    int capacity = 0;  // 队列上限，0 为不限；达到上限时 push 阻塞到消费者取走帧
+    CancelToken* cancel_token = nullptr;
+    int listener_id = -1;
+
+    FrameQueue() = default;
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    ~FrameQueue() {
+        if (cancel_token) cancel_token->remove_listener(listener_id);
+        discard();
+    }
+
+    // 挂接作业的取消令牌，须在生产和消费线程启动之前调用
+    void attach(CancelToken* token) {
+        cancel_token = token;
+        listener_id = token->add_listener([this]() { cancel(); });
+    }
 
     void push(AVFrame* frame) {
-        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (capacity > 0 && queue.getSize() >= capacity && !eof && !cancelled) {
+            not_full.wait(lock);
+        }
+        if (cancelled) {
+            av_frame_free(&frame);
+            return;
+        }
         queue.push(frame);
         cond.notify_one();
     }
 
     AVFrame* pop() {
         std::unique_lock<std::mutex> lock(mutex);
-        while (queue.isEmpty() && !eof) {
+        while (queue.isEmpty() && !eof && !cancelled) {
             cond.wait(lock);
         }
         if (queue.isEmpty()) return nullptr;
         AVFrame* frame = queue.peek();
         queue.pop();
+        not_full.notify_one();
         return frame;
     }
 
+    int size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.getSize();
+    }
+
     void set_eof() {
         std::lock_guard<std::mutex> lock(mutex);
         eof = true;
         cond.notify_all();
+        not_full.notify_all();
+    }
+
+    // 阶段出错：取消整个作业；未挂接令牌时只结束本队列
+    void fail(int error, const std::string& stage) {
+        if (!cancel_token || !cancel_token->cancel(error, stage)) {
+            set_eof();
+        }
+    }
+
+    bool is_cancelled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled;
+    }
+
+    // 令牌取消时调用：释放已排队的帧并唤醒等待者
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        discard();
+        cond.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    void discard() {
+        while (!queue.isEmpty()) {
+            AVFrame* frame = queue.peek();
+            queue.pop();
+            av_frame_free(&frame);
+        }
     }
 };
 
 #endif
-
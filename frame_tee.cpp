@@ -0,0 +1,23 @@
+#include "frame_tee.h"
+#include <iostream>
+
+void frame_tee(FrameQueue& input_queue, std::vector<FrameQueue*> output_queues) {
+    while (AVFrame* frame = input_queue.pop()) {
+        for (size_t i = 0; i < output_queues.size(); i++) {
+            // 最后一个输出直接转交原帧，其余输出各持有一份引用
+            AVFrame* frame_ref = i + 1 < output_queues.size() ? av_frame_clone(frame) : frame;
+            if (!frame_ref) {
+                std::cerr << "无法克隆分发帧" << std::endl;
+                continue;
+            }
+            output_queues[i]->push(frame_ref);
+        }
+        if (output_queues.empty()) {
+            av_frame_free(&frame);
+        }
+    }
+
+    for (FrameQueue* queue : output_queues) {
+        queue->set_eof();
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef FRAME_TEE_H
+#define FRAME_TEE_H
+
+#include <vector>
+#include "frame_queue.h"
+
+// 将输入队列中的每一帧按引用分发到所有输出队列（共享数据缓冲区，不复制像素/采样数据），
+// 输入结束后为所有输出队列设置结束标志
+void frame_tee(FrameQueue& input_queue, std::vector<FrameQueue*> output_queues);
+
+#endif
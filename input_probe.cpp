@@ -0,0 +1,303 @@
+#include "input_probe.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavutil/time.h"
+#include "libavutil/mem.h"
+}
+
+static const size_t HEAD_HASH_SIZE = 64 * 1024;
+
+void report_startup_time(int64_t start_time) {
+    if (start_time == 0) {
+        return;
+    }
+    std::cout << "启动耗时（到第一个数据包）: " << (av_gettime_relative() - start_time) / 1000.0 << " ms" << std::endl;
+}
+
+// FNV-1a 64 位哈希
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string to_hex(uint64_t value) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)value);
+    return buf;
+}
+
+// 文件身份：路径、大小、修改时间和头部哈希，任一变化都视为不同文件
+struct FileIdentity {
+    std::string path;
+    int64_t size = 0;
+    int64_t mtime_ns = 0;
+    std::string head_hash;
+
+    std::string key() const {
+        uint64_t hash = fnv1a(path.data(), path.size());
+        hash = fnv1a(&size, sizeof(size), hash);
+        hash = fnv1a(&mtime_ns, sizeof(mtime_ns), hash);
+        hash = fnv1a(head_hash.data(), head_hash.size(), hash);
+        return to_hex(hash);
+    }
+};
+
+static int get_file_identity(const std::string& path, FileIdentity* identity) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    std::string head(HEAD_HASH_SIZE, '\0');
+    ssize_t n = pread(fd, &head[0], head.size(), 0);
+    close(fd);
+    if (n < 0) return -1;
+
+    identity->path = path;
+    identity->size = st.st_size;
+    identity->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    identity->head_hash = to_hex(fnv1a(head.data(), n));
+    return 0;
+}
+
+// ---- 缓存文件：每行 key=value ----
+
+typedef std::map<std::string, std::string> ProbeRecord;
+
+static std::string stream_key(unsigned int index, const char* field) {
+    return "stream." + std::to_string(index) + "." + field;
+}
+
+static std::string rational_to_string(AVRational q) {
+    return std::to_string(q.num) + "/" + std::to_string(q.den);
+}
+
+static AVRational rational_from_string(const std::string& s) {
+    AVRational q = { 0, 1 };
+    sscanf(s.c_str(), "%d/%d", &q.num, &q.den);
+    return q;
+}
+
+static std::string extradata_to_hex(const uint8_t* data, int size) {
+    std::string hex;
+    hex.reserve(size * 2);
+    char buf[3];
+    for (int i = 0; i < size; i++) {
+        snprintf(buf, sizeof(buf), "%02x", data[i]);
+        hex += buf;
+    }
+    return hex;
+}
+
+static void save_record(const FileIdentity& identity, AVFormatContext* fmt_ctx, ProbeRecord& record) {
+    record["path"] = identity.path;
+    record["size"] = std::to_string(identity.size);
+    record["mtime"] = std::to_string(identity.mtime_ns);
+    record["head"] = identity.head_hash;
+    record["streams"] = std::to_string(fmt_ctx->nb_streams);
+    record["format.start_time"] = std::to_string(fmt_ctx->start_time);
+    record["format.duration"] = std::to_string(fmt_ctx->duration);
+    record["format.bit_rate"] = std::to_string(fmt_ctx->bit_rate);
+
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+        AVStream* st = fmt_ctx->streams[i];
+        AVCodecParameters* par = st->codecpar;
+        record[stream_key(i, "time_base")] = rational_to_string(st->time_base);
+        record[stream_key(i, "avg_frame_rate")] = rational_to_string(st->avg_frame_rate);
+        record[stream_key(i, "r_frame_rate")] = rational_to_string(st->r_frame_rate);
+        record[stream_key(i, "start_time")] = std::to_string(st->start_time);
+        record[stream_key(i, "duration")] = std::to_string(st->duration);
+        record[stream_key(i, "nb_frames")] = std::to_string(st->nb_frames);
+        record[stream_key(i, "codec_type")] = std::to_string(par->codec_type);
+        record[stream_key(i, "codec_id")] = std::to_string(par->codec_id);
+        record[stream_key(i, "format")] = std::to_string(par->format);
+        record[stream_key(i, "bit_rate")] = std::to_string(par->bit_rate);
+        record[stream_key(i, "profile")] = std::to_string(par->profile);
+        record[stream_key(i, "level")] = std::to_string(par->level);
+        record[stream_key(i, "width")] = std::to_string(par->width);
+        record[stream_key(i, "height")] = std::to_string(par->height);
+        record[stream_key(i, "sample_aspect_ratio")] = rational_to_string(par->sample_aspect_ratio);
+        record[stream_key(i, "field_order")] = std::to_string(par->field_order);
+        record[stream_key(i, "color_range")] = std::to_string(par->color_range);
+        record[stream_key(i, "color_space")] = std::to_string(par->color_space);
+        record[stream_key(i, "video_delay")] = std::to_string(par->video_delay);
+        record[stream_key(i, "channel_layout")] = std::to_string(par->channel_layout);
+        record[stream_key(i, "channels")] = std::to_string(par->channels);
+        record[stream_key(i, "sample_rate")] = std::to_string(par->sample_rate);
+        record[stream_key(i, "frame_size")] = std::to_string(par->frame_size);
+        record[stream_key(i, "extradata")] = extradata_to_hex(par->extradata, par->extradata_size);
+    }
+}
+
+static int write_record(const std::string& file, const ProbeRecord& record) {
+    // 先写临时文件再改名，并发作业不会读到写了一半的缓存
+    std::string tmp = file + ".tmp" + std::to_string(getpid());
+    std::ofstream out(tmp.c_str());
+    for (const auto& item : record) {
+        out << item.first << "=" << item.second << "\n";
+    }
+    out.close();
+    if (!out || rename(tmp.c_str(), file.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+static int read_record(const std::string& file, ProbeRecord& record) {
+    std::ifstream in(file.c_str());
+    if (!in) return -1;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq != std::string::npos) {
+            record[line.substr(0, eq)] = line.substr(eq + 1);
+        }
+    }
+    return 0;
+}
+
+// 把缓存的参数填回打开后的输入。容器头中没有完整流列表（如 MPEG-TS）时流数不一致，返回 -1 改为正常探测
+static int apply_record(const ProbeRecord& record, AVFormatContext* fmt_ctx) {
+    auto get = [&](const std::string& key) -> const std::string& {
+        static const std::string empty;
+        auto it = record.find(key);
+        return it == record.end() ? empty : it->second;
+    };
+    auto get_int = [&](const std::string& key) { return strtoll(get(key).c_str(), nullptr, 10); };
+
+    if (get_int("streams") != (long long)fmt_ctx->nb_streams || fmt_ctx->nb_streams == 0) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+        if (get_int(stream_key(i, "codec_id")) != fmt_ctx->streams[i]->codecpar->codec_id) {
+            return -1;
+        }
+    }
+
+    fmt_ctx->start_time = get_int("format.start_time");
+    fmt_ctx->duration = get_int("format.duration");
+    fmt_ctx->bit_rate = get_int("format.bit_rate");
+
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+        AVStream* st = fmt_ctx->streams[i];
+        AVCodecParameters* par = st->codecpar;
+        st->time_base = rational_from_string(get(stream_key(i, "time_base")));
+        st->avg_frame_rate = rational_from_string(get(stream_key(i, "avg_frame_rate")));
+        st->r_frame_rate = rational_from_string(get(stream_key(i, "r_frame_rate")));
+        st->start_time = get_int(stream_key(i, "start_time"));
+        st->duration = get_int(stream_key(i, "duration"));
+        st->nb_frames = get_int(stream_key(i, "nb_frames"));
+        par->format = (int)get_int(stream_key(i, "format"));
+        par->bit_rate = get_int(stream_key(i, "bit_rate"));
+        par->profile = (int)get_int(stream_key(i, "profile"));
+        par->level = (int)get_int(stream_key(i, "level"));
+        par->width = (int)get_int(stream_key(i, "width"));
+        par->height = (int)get_int(stream_key(i, "height"));
+        par->sample_aspect_ratio = rational_from_string(get(stream_key(i, "sample_aspect_ratio")));
+        par->field_order = (int)get_int(stream_key(i, "field_order"));
+        par->color_range = (int)get_int(stream_key(i, "color_range"));
+        par->color_space = (int)get_int(stream_key(i, "color_space"));
+        par->video_delay = (int)get_int(stream_key(i, "video_delay"));
+        par->channel_layout = strtoull(get(stream_key(i, "channel_layout")).c_str(), nullptr, 10);
+        par->channels = (int)get_int(stream_key(i, "channels"));
+        par->sample_rate = (int)get_int(stream_key(i, "sample_rate"));
+        par->frame_size = (int)get_int(stream_key(i, "frame_size"));
+
+        const std::string& hex = get(stream_key(i, "extradata"));
+        if (!hex.empty() && par->extradata_size == 0) {
+            int size = hex.size() / 2;
+            par->extradata = static_cast<uint8_t*>(av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE));
+            if (!par->extradata) return -1;
+            for (int k = 0; k < size; k++) {
+                unsigned int byte = 0;
+                sscanf(hex.c_str() + 2 * k, "%2x", &byte);
+                par->extradata[k] = (uint8_t)byte;
+            }
+            par->extradata_size = size;
+        }
+    }
+    return 0;
+}
+
+// pb 不为空时从调用方的 AVIOContext 读取，此时 path 只是名称
+static int open_input_context(const std::string& path, AVIOContext* pb, const ProbeOptions& options, AVFormatContext** fmt_ctx) {
+    int64_t start = av_gettime_relative();
+
+    if (pb) {
+        *fmt_ctx = avformat_alloc_context();
+        if (!*fmt_ctx) return -1;
+        (*fmt_ctx)->pb = pb;
+        (*fmt_ctx)->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    AVDictionary* format_opts = nullptr;
+    if (options.probesize > 0) {
+        av_dict_set_int(&format_opts, "probesize", options.probesize, 0);
+    }
+    if (options.analyzeduration > 0) {
+        av_dict_set_int(&format_opts, "analyzeduration", options.analyzeduration, 0);
+    }
+    if (options.low_delay) {
+        // 即 AVFMT_FLAG_NOBUFFER：探测读到的包不进入缓冲，读出后立即交给解复用
+        av_dict_set(&format_opts, "fflags", "nobuffer", 0);
+    }
+    int ret = avformat_open_input(fmt_ctx, path.c_str(), nullptr, &format_opts);
+    av_dict_free(&format_opts);
+    if (ret != 0) {
+        std::cerr << "无法打开输入文件: " << path << std::endl;
+        return -1;
+    }
+
+    FileIdentity identity;
+    std::string cache_file;
+    if (!pb && !options.cache_dir.empty() && get_file_identity(path, &identity) == 0) {
+        cache_file = options.cache_dir + "/" + identity.key() + ".probe";
+        ProbeRecord record;
+        if (read_record(cache_file, record) == 0 && record["path"] == identity.path &&
+            record["size"] == std::to_string(identity.size) && record["mtime"] == std::to_string(identity.mtime_ns) &&
+            record["head"] == identity.head_hash && apply_record(record, *fmt_ctx) == 0) {
+            std::cout << "探测缓存命中，跳过流信息探测，耗时 " << (av_gettime_relative() - start) / 1000.0 << " ms" << std::endl;
+            return 0;
+        }
+    }
+
+    if (avformat_find_stream_info(*fmt_ctx, nullptr) < 0) {
+        std::cerr << "无法获取流信息" << std::endl;
+        avformat_close_input(fmt_ctx);
+        return -1;
+    }
+    std::cout << "流信息探测耗时 " << (av_gettime_relative() - start) / 1000.0 << " ms" << std::endl;
+
+    if (!cache_file.empty()) {
+        ProbeRecord record;
+        save_record(identity, *fmt_ctx, record);
+        if (write_record(cache_file, record) < 0) {
+            std::cerr << "无法写入探测缓存: " << cache_file << std::endl;
+        }
+    }
+    return 0;
+}
+
+int open_input(const std::string& path, const ProbeOptions& options, AVFormatContext** fmt_ctx) {
+    return open_input_context(path, nullptr, options, fmt_ctx);
+}
+
+int open_input(AVIOContext* pb, const std::string& name, const ProbeOptions& options, AVFormatContext** fmt_ctx) {
+    return open_input_context(name, pb, options, fmt_ctx);
+}
@@ -0,0 +1,37 @@
+#ifndef INPUT_PROBE_H
+#define INPUT_PROBE_H
+
+#include <string>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavformat/avformat.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+// 输入探测参数
+struct ProbeOptions {
+    int64_t probesize = 0;        // 探测读取的最大字节数，0 为 FFmpeg 默认（5MB）
+    int64_t analyzeduration = 0;  // 探测分析的最大时长（微秒），0 为 FFmpeg 默认
+    // 探测缓存目录，为空时不使用缓存。缓存以文件身份（路径、大小、修改时间、头部 64KB 哈希）为键，
+    // 保存 avformat_find_stream_info 得到的流参数，命中时跳过探测
+    std::string cache_dir;
+    // 低延迟输入（直播模式）：解复用不为探测缓冲数据包（AVFMT_FLAG_NOBUFFER）
+    bool low_delay = false;
+};
+
+// 打开输入并取得流信息，失败返回 -1
+int open_input(const std::string& path, const ProbeOptions& options, AVFormatContext** fmt_ctx);
+// 从调用方的 AVIOContext 读取输入（见 memory_io.h），name 只用于日志和格式猜测，不使用探测缓存。
+// pb 由调用方在 avformat_close_input 之后释放
+int open_input(AVIOContext* pb, const std::string& name, const ProbeOptions& options, AVFormatContext** fmt_ctx);
+
+// 由解复用线程在读出作业的第一个数据包后调用，打印从 start_time（作业开始时刻，见 JobOptions::start_time）
+// 起的启动耗时，start_time 为 0 时不打印
+void report_startup_time(int64_t start_time);
+
+#endif
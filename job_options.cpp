@@ -0,0 +1,305 @@
+#include "job_options.h"
+#include <iostream>
+#include <cstdlib>
+#include <sstream>
+#include <cctype>
+#include <cstdio>
+
+static float clamp_speed(float speed) {
+    if (speed < 0.5) speed = 0.5;
+    if (speed > 3.0) speed = 3.0;
+    return speed;
+}
+
+std::string output_for_speed(const std::string& output, float speed) {
+    std::ostringstream suffix;
+    suffix << "_" << speed << "x";
+    size_t dot = output.find_last_of('.');
+    size_t slash = output.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return output + suffix.str();
+    }
+    return output.substr(0, dot) + suffix.str() + output.substr(dot);
+}
+
+void parse_speed_list(const std::string& list, std::vector<float>& speeds) {
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) speeds.push_back(clamp_speed(atof(item.c_str())));
+    }
+}
+
+void print_usage(const char* prog) {
+    std::cout << "用法: " << prog << " [速度] [-i 输入文件]... [-o 输出文件]" << std::endl
+              << "  速度          变速倍率，范围 0.5 - 3.0，默认 1.0" << std::endl
+              << "  -i 文件       输入文件，可重复指定，多个输入按顺序拼接，默认 1.mp4" << std::endl
+              << "  -o 文件       输出文件，默认 lzyresult.mp4" << std::endl
+              << "  --speeds 列表 逗号分隔的多个速度，如 1,1.5,2，只解码一次并输出多个文件" << std::endl
+              << "  --tempo-engine atempo|wsola  音频变速实现，默认 atempo" << std::endl
+              << "  --pcm-out 文件 同时输出解码后的音频，扩展名为 .wav 时写 WAV 头，否则为裸 PCM" << std::endl
+              << "  --peaks 文件       同时输出波形峰值（min/max/rms），扩展名为 .json 时写 JSON，否则为二进制" << std::endl
+              << "  --peaks-window N   每个峰值窗口的采样数，默认 256" << std::endl
+              << "  --yuv-out 文件 同时输出解码后的原始视频，扩展名为 .y4m 时写 Y4M 头，否则为裸数据" << std::endl
+              << "  --yuv-mmap    原始视频输出通过 mmap 写文件" << std::endl
+              << "  --yuv-out-process  原始视频在独立子进程中写出，解码帧经共享内存传递，不复制像素" << std::endl
+              << "  --frame-pool off|pool|thp|hugetlb  解码帧缓冲池，thp/hugetlb 使用大页，默认 pool" << std::endl
+              << "  --drop-static [阈值] 丢弃与上一帧相同的静止帧，输出可变帧率，阈值默认 2" << std::endl
+              << "  --thumbnails 前缀  缩略图模式：只解码关键帧，输出雪碧图 前缀_000.jpg 和索引 前缀.vtt" << std::endl
+              << "  --thumb-interval 秒  缩略图间隔，默认 10" << std::endl
+              << "  --thumb-width 宽度   单张缩略图宽度，默认 160" << std::endl
+              << "  --thumb-grid 列x行   每张雪碧图的格子数，默认 5x5" << std::endl
+              << "  --thumb-format jpg|png|webp  雪碧图格式，默认 jpg" << std::endl
+              << "  --proxy 宽[x高]    代理模式：低分辨率解码、快速缩放和快速编码预设，输出低分辨率代理文件" << std::endl
+              << "  --quality N        每 N 帧抽样解码编码输出，计算 PSNR/SSIM" << std::endl
+              << "  --loudnorm dynamic|linear  响度归一化：dynamic 为滤波器链中的动态增益，" << std::endl
+              << "                     linear 为测量后按固定增益重新解码缓存的音频包" << std::endl
+              << "  --loudnorm-target LUFS  目标积分响度，默认 -23" << std::endl
+              << "  --probesize 字节   输入探测最多读取的字节数，短片和慢速存储可调小" << std::endl
+              << "  --analyzeduration 微秒  输入探测最多分析的时长" << std::endl
+              << "  --probe-cache 目录 缓存输入的流参数，同一文件再次处理时跳过探测" << std::endl
+              << "  --target-speed X   目标实时倍数，按编码吞吐在 GOP 边界自动调整 x264 预设" << std::endl
+              << "  --deadline 秒      作业截止时长，按剩余内容换算目标实时倍数" << std::endl
+              << "  --decoder-threads N / --encoder-threads N  解码、编码线程数" << std::endl
+              << "  --frame-queue N    解码视频帧队列上限，限制内存占用" << std::endl
+              << "  --batch 清单       批处理模式：每行一个作业 input=.. output=.. [speed=..] [priority=..] [deadline=秒]，output 必填且不能重复" << std::endl
+              << "  --batch-cpus N     批处理的 CPU 线程预算，默认本机核数" << std::endl
+              << "  --batch-memory MB  批处理的内存预算，按帧尺寸和队列上限估算每个作业的占用" << std::endl
+              << "  --batch-jobs N     最多同时运行的作业数" << std::endl
+              << "  --farm-workers N   分段农场：按关键帧切分输入，由 N 个本机工作进程并行编码后拼接" << std::endl
+              << "  --farm-listen 地址 协调进程监听地址 unix:路径 或 tcp:主机:端口，其他机器的工作进程可连接" << std::endl
+              << "  --farm-worker 地址 工作模式：连接协调进程领取分段，其余参数须与协调进程一致" << std::endl
+              << "  --farm-segment 秒  目标分段时长，默认 30" << std::endl
+              << "  --farm-retries N   分段失败后的重试次数，默认 2" << std::endl
+              << "  --checkpoint 秒    断点续转：按关键帧每段约该秒数逐段转码并记录检查点，中断后以相同参数重新运行即从断点继续" << std::endl
+              << "  --segment-cache 目录  分段转码时缓存编码后的分段，输入内容和参数相同的分段直接复用" << std::endl
+              << "  --segment-cache-size MB  分段缓存容量，超出时淘汰最久未用的分段，默认 10240" << std::endl
+              << "  --live             直播模式：-i 可为 -（标准输入）、FIFO 或 udp://、tcp:// 本机地址，低延迟转码，" << std::endl
+              << "                     输出分片 MP4 或 MPEG-TS 并报告管线延迟，只支持 1 倍速" << std::endl
+              << "  --live-queue N     直播模式各帧队列的上限，默认 4" << std::endl
+              << "  --memory-io        输入读入内存，经内存 AVIO 转码后一次写出，转码过程不读写文件" << std::endl
+              << "  --placement off|node|cache  线程放置：node 把作业固定在一个 NUMA 节点并从该节点分配帧缓冲，" << std::endl
+              << "                     cache 另把解码和编码集中到共享末级缓存的核心上" << std::endl
+              << "  --numa-node N      作业使用的 NUMA 节点，默认单作业用 0 号、批处理选作业最少的节点" << std::endl;
+}
+
+int parse_job_options(int argc, char* argv[], JobOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return -1;
+        } else if (arg == "-i" && i + 1 < argc) {
+            opts.inputs.push_back(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.output = argv[++i];
+        } else if (arg == "--speeds" && i + 1 < argc) {
+            parse_speed_list(argv[++i], opts.speeds);
+        } else if (arg == "--tempo-engine" && i + 1 < argc) {
+            std::string engine = argv[++i];
+            if (engine != "atempo" && engine != "wsola") {
+                std::cerr << "未知的变速实现: " << engine << std::endl;
+                return -1;
+            }
+            opts.wsola_tempo = engine == "wsola";
+        } else if (arg == "--pcm-out" && i + 1 < argc) {
+            opts.pcm_output = argv[++i];
+        } else if (arg == "--peaks" && i + 1 < argc) {
+            opts.peaks_output = argv[++i];
+        } else if (arg == "--peaks-window" && i + 1 < argc) {
+            opts.peaks_window = atoi(argv[++i]);
+            if (opts.peaks_window <= 0) {
+                std::cerr << "无效的峰值窗口: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--yuv-out" && i + 1 < argc) {
+            opts.raw_video_output = argv[++i];
+        } else if (arg == "--yuv-mmap") {
+            opts.raw_video_mmap = true;
+        } else if (arg == "--yuv-out-process") {
+            opts.raw_video_process = true;
+        } else if (arg == "--frame-pool" && i + 1 < argc) {
+            opts.frame_pool = argv[++i];
+            if (opts.frame_pool != "off" && opts.frame_pool != "pool" && opts.frame_pool != "thp" && opts.frame_pool != "hugetlb") {
+                std::cerr << "未知的帧缓冲池模式: " << opts.frame_pool << std::endl;
+                return -1;
+            }
+        } else if (arg == "--drop-static") {
+            opts.drop_static_frames = true;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+                opts.static_threshold = atoi(argv[++i]);
+            }
+        } else if (arg == "--thumbnails" && i + 1 < argc) {
+            opts.thumbnails.output_prefix = argv[++i];
+        } else if (arg == "--thumb-interval" && i + 1 < argc) {
+            opts.thumbnails.interval = atof(argv[++i]);
+            if (opts.thumbnails.interval <= 0) {
+                std::cerr << "缩略图间隔必须大于 0" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--thumb-width" && i + 1 < argc) {
+            opts.thumbnails.width = atoi(argv[++i]);
+        } else if (arg == "--thumb-grid" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &opts.thumbnails.columns, &opts.thumbnails.rows) != 2 ||
+                opts.thumbnails.columns <= 0 || opts.thumbnails.rows <= 0) {
+                std::cerr << "无效的雪碧图格子数: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--thumb-format" && i + 1 < argc) {
+            opts.thumbnails.image_format = argv[++i];
+        } else if (arg == "--proxy" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &opts.proxy_width, &opts.proxy_height) < 1 || opts.proxy_width <= 0) {
+                std::cerr << "无效的代理尺寸: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--quality" && i + 1 < argc) {
+            opts.quality_interval = atoi(argv[++i]);
+            if (opts.quality_interval <= 0) {
+                std::cerr << "无效的质量抽样间隔: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--loudnorm" && i + 1 < argc) {
+            if (parse_loudness_mode(argv[++i], &opts.loudness.mode) < 0) {
+                std::cerr << "无效的响度归一化方式: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--loudnorm-target" && i + 1 < argc) {
+            opts.loudness.target = atof(argv[++i]);
+        } else if (arg == "--probesize" && i + 1 < argc) {
+            opts.probe.probesize = atoll(argv[++i]);
+        } else if (arg == "--analyzeduration" && i + 1 < argc) {
+            opts.probe.analyzeduration = atoll(argv[++i]);
+        } else if (arg == "--probe-cache" && i + 1 < argc) {
+            opts.probe.cache_dir = argv[++i];
+        } else if (arg == "--target-speed" && i + 1 < argc) {
+            opts.effort.target_speed = atof(argv[++i]);
+        } else if (arg == "--deadline" && i + 1 < argc) {
+            opts.effort.deadline = atof(argv[++i]);
+        } else if (arg == "--decoder-threads" && i + 1 < argc) {
+            opts.decoder_threads = atoi(argv[++i]);
+        } else if (arg == "--encoder-threads" && i + 1 < argc) {
+            opts.encoder_threads = atoi(argv[++i]);
+        } else if (arg == "--frame-queue" && i + 1 < argc) {
+            opts.frame_queue_limit = atoi(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            opts.batch.manifest = argv[++i];
+        } else if (arg == "--batch-cpus" && i + 1 < argc) {
+            opts.batch.cpus = atoi(argv[++i]);
+        } else if (arg == "--batch-memory" && i + 1 < argc) {
+            opts.batch.memory_mb = atoll(argv[++i]);
+        } else if (arg == "--batch-jobs" && i + 1 < argc) {
+            opts.batch.max_jobs = atoi(argv[++i]);
+        } else if (arg == "--farm-workers" && i + 1 < argc) {
+            opts.farm.local_workers = atoi(argv[++i]);
+        } else if (arg == "--farm-listen" && i + 1 < argc) {
+            opts.farm.listen = argv[++i];
+        } else if (arg == "--farm-worker" && i + 1 < argc) {
+            opts.farm.worker = argv[++i];
+        } else if (arg == "--farm-segment" && i + 1 < argc) {
+            opts.farm.segment_duration = atof(argv[++i]);
+            if (opts.farm.segment_duration <= 0) {
+                std::cerr << "分段时长必须大于 0" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--farm-retries" && i + 1 < argc) {
+            opts.farm.retries = atoi(argv[++i]);
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            opts.checkpoint_interval = atof(argv[++i]);
+            if (opts.checkpoint_interval <= 0) {
+                std::cerr << "检查点间隔必须大于 0" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--segment-cache" && i + 1 < argc) {
+            opts.segment_cache.dir = argv[++i];
+        } else if (arg == "--segment-cache-size" && i + 1 < argc) {
+            opts.segment_cache.max_size_mb = atoll(argv[++i]);
+            if (opts.segment_cache.max_size_mb <= 0) {
+                std::cerr << "分段缓存容量必须大于 0" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--live") {
+            opts.live.enabled = true;
+        } else if (arg == "--live-queue" && i + 1 < argc) {
+            opts.live.queue_limit = atoi(argv[++i]);
+            if (opts.live.queue_limit <= 0) {
+                std::cerr << "直播队列上限必须大于 0" << std::endl;
+                return -1;
+            }
+        } else if (arg == "--placement" && i + 1 < argc) {
+            if (parse_placement_policy(argv[++i], &opts.placement.policy) < 0) {
+                std::cerr << "未知的线程放置策略: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--numa-node" && i + 1 < argc) {
+            opts.placement.node = atoi(argv[++i]);
+            if (opts.placement.node < 0 || opts.placement.node >= numa_node_count()) {
+                std::cerr << "NUMA 节点不存在: " << argv[i] << std::endl;
+                return -1;
+            }
+        } else if (arg == "--memory-io") {
+            opts.memory_io = true;
+        } else if (i == 1 && arg[0] != '-') {
+            // 兼容旧用法：第一个参数为速度
+            opts.speed = atof(argv[i]);
+        } else {
+            std::cerr << "无法识别的参数: " << arg << std::endl;
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    opts.speed = clamp_speed(opts.speed);
+    if (opts.speeds.empty()) {
+        opts.speeds.push_back(opts.speed);
+    }
+
+    if (opts.inputs.empty()) {
+        opts.inputs.push_back("1.mp4");
+    }
+
+    if (!opts.batch.manifest.empty()) {
+        // 旁路输出的文件名是全局参数，并发的作业会写同一个文件；每个作业的输出文件由清单给出
+        if (!opts.pcm_output.empty() || !opts.peaks_output.empty() || !opts.raw_video_output.empty() ||
+            !opts.thumbnails.output_prefix.empty()) {
+            std::cerr << "批处理模式不能使用 --pcm-out、--peaks、--yuv-out 或 --thumbnails，各作业会写同一个文件" << std::endl;
+            return -1;
+        }
+        // 共享内存帧环要 fork 子进程，批处理时其他作业的线程已在运行
+        if (opts.raw_video_process) {
+            std::cerr << "批处理模式不能使用 --yuv-out-process" << std::endl;
+            return -1;
+        }
+    }
+
+    if (opts.live.enabled) {
+        if (opts.checkpoint_interval > 0 || opts.farm.local_workers > 0 || !opts.farm.listen.empty() ||
+            !opts.farm.worker.empty() || !opts.batch.manifest.empty() || opts.inputs.size() > 1) {
+            std::cerr << "直播模式不能与断点续转、分段农场、批处理或多输入拼接同时使用" << std::endl;
+            return -1;
+        }
+        // 实时输入的处理速度由输入决定，编码强度控制按目标倍数切换预设会反复重开编码器；
+        // 线性响度归一化要先测完整段输入，直播没有结尾
+        if (opts.effort.target_speed > 0 || opts.effort.deadline > 0) {
+            std::cerr << "直播模式不能与 --target-speed 或 --deadline 同时使用" << std::endl;
+            return -1;
+        }
+        if (opts.loudness.mode == LOUDNESS_LINEAR) {
+            std::cerr << "直播模式不能使用 --loudnorm linear，可改用 dynamic" << std::endl;
+            return -1;
+        }
+        // 直播输入只能按实时速度到达，变速会让延迟无限累积
+        if (opts.speeds.size() > 1 || opts.speeds[0] != 1.0f) {
+            std::cerr << "直播模式只支持 1 倍速，忽略速度参数" << std::endl;
+            opts.speeds.assign(1, 1.0f);
+        }
+        if (opts.inputs[0] == "-") {
+            opts.inputs[0] = "pipe:0";
+        }
+        // 探测尽量少读，首帧尽快开始解码
+        if (opts.probe.probesize == 0) opts.probe.probesize = 32768;
+        if (opts.probe.analyzeduration == 0) opts.probe.analyzeduration = 500000;
+        opts.probe.low_delay = true;
+        opts.frame_queue_limit = opts.live.queue_limit;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef JOB_OPTIONS_H
+#define JOB_OPTIONS_H
+
+#include <string>
+#include <vector>
+#include "thumbnail.h"
+#include "loudness.h"
+#include "input_probe.h"
+#include "effort_controller.h"
+#include "thread_placement.h"
+
+struct MediaSource;
+struct MediaSink;
+
+// 批处理模式：按清单在同一进程内调度多个作业（见 batch_scheduler.h）
+struct BatchOptions {
+    // 作业清单，每行一个作业：input=.. output=.. [speed=1,1.5] [priority=0] [deadline=秒]
+    std::string manifest;
+    int cpus = 0;                // CPU 线程预算，0 为本机核数
+    int64_t memory_mb = 0;       // 内存预算（MB），0 为不限
+    int max_jobs = 0;            // 最多同时运行的作业数，0 为按 CPU 预算自动确定
+    int frame_queue_limit = 8;   // 每个作业解码视频帧队列的上限
+};
+
+// 分段农场：协调进程按关键帧切分输入，分发给工作进程编码后拼接（见 segment_farm.h）
+struct FarmOptions {
+    int local_workers = 0;         // 本机启动的工作进程数，大于 0 时进入协调模式
+    std::string listen;            // 协调进程监听地址，为空时使用临时 Unix 套接字
+    std::string worker;            // 工作模式：连接到该地址领取分段
+    double segment_duration = 30;  // 目标分段时长（秒），实际在其后的第一个关键帧处切分
+    int retries = 2;               // 每个分段失败后的重试次数
+};
+
+// 直播模式：输入为标准输入（-）、FIFO 或本机 UDP/TCP 套接字（如 udp://127.0.0.1:5000、
+// tcp://127.0.0.1:5000?listen），按低延迟配置解复用、解码和编码，边转码边输出
+// 分片 MP4 或 MPEG-TS（扩展名无法确定格式时，如 udp:// 输出，使用 MPEG-TS）
+struct LiveOptions {
+    bool enabled = false;
+    int queue_limit = 4;  // 各帧队列的上限，排队本身就是延迟
+};
+
+// 编码分段缓存：分段转码（分段农场、断点续转）复用内容和参数都相同的已编码分段（见 segment_cache.h）
+struct SegmentCacheOptions {
+    std::string dir;              // 缓存目录，为空时不使用
+    int64_t max_size_mb = 10240;  // 容量预算（MB），超出时淘汰最久未用的分段
+};
+
+struct JobOptions {
+    // 输入文件列表，多于一个时按顺序无缝拼接到同一输出
+    std::vector<std::string> inputs;
+    std::string output = "lzyresult.mp4";
+    float speed = 1.0;
+    // 多倍速输出：共享一次解码，每个速度各自滤波、编码并输出到独立文件
+    std::vector<float> speeds;
+    // 音频变速使用内置 WSOLA 代替 atempo
+    bool wsola_tempo = false;
+    // 解码后的音频另存为 PCM（.wav 或裸 PCM），为空时不输出
+    std::string pcm_output;
+    // 解码时顺带输出波形峰值文件（.json 或二进制，见 peaks_writer.h），为空时不输出
+    std::string peaks_output;
+    int peaks_window = 256;
+    // 解码后的视频另存为原始数据（.y4m 或裸数据），为空时不输出
+    std::string raw_video_output;
+    bool raw_video_mmap = false;
+    // 原始视频在独立子进程中写出，解码帧经共享内存帧环传递（见 shm_frame_ring.h）
+    bool raw_video_process = false;
+    // 解码帧缓冲来源：off / pool / thp / hugetlb，见 frame_pool.h
+    std::string frame_pool = "pool";
+    // 丢弃静止帧（录屏、幻灯片类内容），阈值为块内平均每像素绝对差
+    bool drop_static_frames = false;
+    int static_threshold = 2;
+    // 缩略图模式：设置输出前缀后只生成雪碧图和 WebVTT 索引，不转码
+    ThumbnailOptions thumbnails;
+    // 代理模式：输出缩小到该宽度（高度为 0 时按比例），解码和编码使用最快的选项
+    int proxy_width = 0;
+    int proxy_height = 0;
+    // 抽样质量测量：每 N 帧解码一次编码输出并计算 PSNR/SSIM，0 为关闭
+    int quality_interval = 0;
+    // 响度归一化（EBU R128），不需要单独的分析遍
+    LoudnessOptions loudness;
+    // 输入探测的读取上限和探测缓存
+    ProbeOptions probe;
+    // 按目标实时倍数或截止时间自动调整编码预设
+    EffortControlOptions effort;
+    // 解码和编码线程数，0 为编解码器默认
+    int decoder_threads = 0;
+    int encoder_threads = 0;
+    // 解码视频帧队列的上限，0 为不限
+    int frame_queue_limit = 0;
+    BatchOptions batch;
+    FarmOptions farm;
+    // 只转码输入的 [range_start, range_end) 区间（微秒），range_end 为 0 时转码全部。
+    // 起点须为视频关键帧的时间戳，由分段农场按关键帧切分后填入
+    int64_t range_start = 0;
+    int64_t range_end = 0;
+    // 断点续转：每段约该秒数，逐段转码并记录检查点，中断后重新运行从检查点继续（见 checkpoint.h），0 为关闭
+    double checkpoint_interval = 0;
+    SegmentCacheOptions segment_cache;
+    LiveOptions live;
+    // 调用方在内存中提供输入、接收输出（见 memory_io.h），不为空时代替 inputs[0] 和 output 的文件读写，
+    // 两者仍用作名称和按扩展名猜测格式。只支持单个输入和单一速度
+    MediaSource* input_source = nullptr;
+    MediaSink* output_sink = nullptr;
+    // 流水线线程的 CPU 亲和性和 NUMA 放置（见 thread_placement.h）
+    PlacementOptions placement;
+    // 命令行：输入整体读入内存，经内存接口转码后一次写出（见 run_memory_job）
+    bool memory_io = false;
+    // 作业开始时刻（av_gettime_relative），非 0 时解复用线程读出第一个数据包后打印启动耗时。
+    // 每个作业各自记录，批处理中并发的作业互不影响
+    int64_t start_time = 0;
+};
+
+// 多倍速输出时各速度对应的输出文件名，如 lzyresult_1.5x.mp4
+std::string output_for_speed(const std::string& output, float speed);
+
+// 解析逗号分隔的速度列表（如 1,1.5,2），每项限制在 0.5 - 3.0
+void parse_speed_list(const std::string& list, std::vector<float>& speeds);
+
+// 解析命令行参数，失败返回 -1
+int parse_job_options(int argc, char* argv[], JobOptions& opts);
+
+void print_usage(const char* prog);
+
+#endif
@@ -0,0 +1,68 @@
+#include "live_latency.h"
+#include <iostream>
+
+extern "C" {
+#include "libavutil/avutil.h"
+#include "libavutil/time.h"
+}
+
+// 到达记录的保留时长，丢弃的帧（静止帧）对应的记录超时后清理
+static const int64_t ARRIVAL_TTL = 30 * AV_TIME_BASE;
+// 区间统计的打印间隔
+static const int64_t REPORT_INTERVAL = 5 * AV_TIME_BASE;
+// 输入和输出时间基准不同，换算后允许的时间戳误差
+static const int64_t TS_TOLERANCE = 1000;
+
+LatencyTracker::LatencyTracker(double gop_duration) : gop_us((int64_t)(gop_duration * AV_TIME_BASE)) {}
+
+void LatencyTracker::Stats::add(int64_t latency, int64_t gop) {
+    count++;
+    total += latency;
+    if (latency > max) max = latency;
+    if (latency > gop) over_gop++;
+}
+
+void LatencyTracker::Stats::print(const char* label, int64_t gop) const {
+    if (count == 0) return;
+    std::cout << label << ": 平均 " << total / count / 1000.0 << " ms，最大 " << max / 1000.0
+              << " ms，超过一个 GOP（" << gop / 1000.0 << " ms）的包 " << over_gop << "/" << count << std::endl;
+}
+
+void LatencyTracker::packet_in(int64_t ts) {
+    if (ts == AV_NOPTS_VALUE) return;
+    int64_t now = av_gettime_relative();
+    std::lock_guard<std::mutex> lock(mutex);
+    arrivals.push_back({ ts, now });
+    while (!arrivals.empty() && now - arrivals.front().wall_time > ARRIVAL_TTL) {
+        arrivals.pop_front();
+    }
+}
+
+void LatencyTracker::packet_out(int64_t ts) {
+    if (ts == AV_NOPTS_VALUE) return;
+    int64_t now = av_gettime_relative();
+    std::lock_guard<std::mutex> lock(mutex);
+    // 输入可能含 B 帧，包按解码顺序到达，取时间戳不晚于该输出包的最新一帧
+    const Arrival* match = nullptr;
+    for (const Arrival& arrival : arrivals) {
+        if (arrival.ts <= ts + TS_TOLERANCE && (!match || arrival.ts > match->ts)) {
+            match = &arrival;
+        }
+    }
+    if (!match) return;
+    int64_t latency = now - match->wall_time;
+    interval.add(latency, gop_us);
+    total.add(latency, gop_us);
+
+    if (interval_start == 0) interval_start = now;
+    if (now - interval_start >= REPORT_INTERVAL) {
+        interval.print("直播延迟（最近 5 秒）", gop_us);
+        interval = Stats();
+        interval_start = now;
+    }
+}
+
+void LatencyTracker::report() {
+    std::lock_guard<std::mutex> lock(mutex);
+    total.print("直播延迟（全程）", gop_us);
+}
@@ -0,0 +1,46 @@
+#ifndef LIVE_LATENCY_H
+#define LIVE_LATENCY_H
+
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+// 直播模式的管线延迟测量：解复用线程读出视频包时记录到达时刻，复用线程写出对应时间戳的编码包时
+// 计算经过的墙钟时间，即从输入到达到输出写出的延迟（不含发送端采集和网络传输）。
+// 按时间戳对应输入和输出，只在速度为 1 时有意义，直播模式固定使用 1 倍速
+class LatencyTracker {
+public:
+    // gop_duration 为输出 GOP 时长（秒），报告时作为延迟目标
+    explicit LatencyTracker(double gop_duration);
+
+    // 解复用线程：读出一个视频包，ts 为 AV_TIME_BASE 时间戳
+    void packet_in(int64_t ts);
+    // 复用线程：写出一个视频包。每隔几秒打印一次区间统计
+    void packet_out(int64_t ts);
+
+    // 打印全程统计
+    void report();
+
+private:
+    struct Arrival {
+        int64_t ts;
+        int64_t wall_time;
+    };
+    struct Stats {
+        int64_t count = 0;
+        int64_t total = 0;
+        int64_t max = 0;
+        int64_t over_gop = 0;   // 超过一个 GOP 时长的包数
+
+        void add(int64_t latency, int64_t gop);
+        void print(const char* label, int64_t gop) const;
+    };
+
+    std::mutex mutex;
+    std::deque<Arrival> arrivals;
+    int64_t gop_us;
+    Stats interval, total;
+    int64_t interval_start = 0;
+};
+
+#endif
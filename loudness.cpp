@@ -0,0 +1,346 @@
+#include "loudness.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+int parse_loudness_mode(const std::string& name, LoudnessMode* mode) {
+    if (name == "off") {
+        *mode = LOUDNESS_OFF;
+    } else if (name == "dynamic") {
+        *mode = LOUDNESS_DYNAMIC;
+    } else if (name == "linear") {
+        *mode = LOUDNESS_LINEAR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void read_audio_channel(const AVFrame* frame, int ch, float* out) {
+    AVSampleFormat fmt = static_cast<AVSampleFormat>(frame->format);
+    bool planar = av_sample_fmt_is_planar(fmt);
+    const uint8_t* base = frame->extended_data[planar ? ch : 0];
+    int stride = planar ? 1 : frame->channels;
+    int offset = planar ? 0 : ch;
+    int n = frame->nb_samples;
+
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:
+        for (int i = 0; i < n; i++) out[i] = (base[i * stride + offset] - 128) / 128.0f;
+        break;
+    case AV_SAMPLE_FMT_S16: {
+        const int16_t* p = reinterpret_cast<const int16_t*>(base);
+        for (int i = 0; i < n; i++) out[i] = p[i * stride + offset] / 32768.0f;
+        break;
+    }
+    case AV_SAMPLE_FMT_S32: {
+        const int32_t* p = reinterpret_cast<const int32_t*>(base);
+        for (int i = 0; i < n; i++) out[i] = (float)(p[i * stride + offset] / 2147483648.0);
+        break;
+    }
+    case AV_SAMPLE_FMT_FLT: {
+        const float* p = reinterpret_cast<const float*>(base);
+        for (int i = 0; i < n; i++) out[i] = p[i * stride + offset];
+        break;
+    }
+    case AV_SAMPLE_FMT_DBL: {
+        const double* p = reinterpret_cast<const double*>(base);
+        for (int i = 0; i < n; i++) out[i] = (float)p[i * stride + offset];
+        break;
+    }
+    default:
+        std::fill(out, out + n, 0.0f);
+        break;
+    }
+}
+
+template <typename T>
+static void scale_integer(uint8_t* data, int count, double gain, double low, double high) {
+    T* p = reinterpret_cast<T*>(data);
+    for (int i = 0; i < count; i++) {
+        double v = std::max(low, std::min(high, p[i] * gain));
+        p[i] = (T)std::lrint(v);
+    }
+}
+
+template <typename T>
+static void scale_float(uint8_t* data, int count, double gain) {
+    T* p = reinterpret_cast<T*>(data);
+    for (int i = 0; i < count; i++) {
+        p[i] = (T)(p[i] * gain);
+    }
+}
+
+// 对可写帧就地施加线性增益，整数格式饱和截断
+static void apply_gain(AVFrame* frame, double gain) {
+    AVSampleFormat fmt = static_cast<AVSampleFormat>(frame->format);
+    bool planar = av_sample_fmt_is_planar(fmt);
+    int planes = planar ? frame->channels : 1;
+    int count = planar ? frame->nb_samples : frame->nb_samples * frame->channels;
+
+    for (int p = 0; p < planes; p++) {
+        uint8_t* data = frame->extended_data[p];
+        switch (av_get_packed_sample_fmt(fmt)) {
+        case AV_SAMPLE_FMT_U8:
+            for (int i = 0; i < count; i++) {
+                long v = std::lrint((data[i] - 128) * gain) + 128;
+                data[i] = (uint8_t)std::max(0L, std::min(255L, v));
+            }
+            break;
+        case AV_SAMPLE_FMT_S16:
+            scale_integer<int16_t>(data, count, gain, -32768.0, 32767.0);
+            break;
+        case AV_SAMPLE_FMT_S32:
+            scale_integer<int32_t>(data, count, gain, -2147483648.0, 2147483647.0);
+            break;
+        case AV_SAMPLE_FMT_FLT:
+            scale_float<float>(data, count, gain);
+            break;
+        case AV_SAMPLE_FMT_DBL:
+            scale_float<double>(data, count, gain);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// ---- LoudnessMeter ----
+
+int LoudnessMeter::init(int channels, int sample_rate, uint64_t channel_layout) {
+    if (channels <= 0 || sample_rate <= 0) {
+        return -1;
+    }
+    this->channels = channels;
+    this->sample_rate = sample_rate;
+    step_samples = std::max(1, sample_rate / 10);
+
+    // K 加权的两级双二阶滤波器（高频搁架 + RLB 高通），按采样率由 BS.1770 的模拟原型导出
+    double f0 = 1681.974450955533;
+    double gain_db = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / sample_rate);
+    double vh = pow(10.0, gain_db / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    highpass.b0 = 1.0;
+    highpass.b1 = -2.0;
+    highpass.b2 = 1.0;
+    highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass.a2 = (1.0 - k / q + k * k) / a0;
+
+    uint64_t layout = channel_layout ? channel_layout : av_get_default_channel_layout(channels);
+    weights.assign(channels, 1.0);
+    for (int ch = 0; ch < channels; ch++) {
+        uint64_t channel = av_channel_layout_extract_channel(layout, ch);
+        if (channel & (AV_CH_LOW_FREQUENCY | AV_CH_LOW_FREQUENCY_2)) {
+            weights[ch] = 0.0;
+        } else if (channel & (AV_CH_BACK_LEFT | AV_CH_BACK_RIGHT | AV_CH_SIDE_LEFT | AV_CH_SIDE_RIGHT)) {
+            weights[ch] = 1.41;
+        }
+    }
+    state.assign(channels * 4, 0.0);
+
+    step_fill = 0;
+    step_energy = 0;
+    step_count = 0;
+    blocks.clear();
+    max_sample = 0;
+    return 0;
+}
+
+bool LoudnessMeter::matches(const AVFrame* frame) const {
+    return frame->channels == channels && frame->sample_rate == sample_rate;
+}
+
+void LoudnessMeter::add(const AVFrame* frame) {
+    int n = frame->nb_samples;
+    samples.resize(n);
+    energy.assign(n, 0.0);
+
+    for (int ch = 0; ch < channels; ch++) {
+        read_audio_channel(frame, ch, samples.data());
+        double* z = &state[ch * 4];
+        double w = weights[ch];
+        for (int i = 0; i < n; i++) {
+            double x = samples[i];
+            max_sample = std::max(max_sample, std::fabs(x));
+
+            double y = shelf.b0 * x + z[0];
+            z[0] = shelf.b1 * x - shelf.a1 * y + z[1];
+            z[1] = shelf.b2 * x - shelf.a2 * y;
+
+            double y2 = highpass.b0 * y + z[2];
+            z[2] = highpass.b1 * y - highpass.a1 * y2 + z[3];
+            z[3] = highpass.b2 * y - highpass.a2 * y2;
+
+            energy[i] += w * y2 * y2;
+        }
+    }
+
+    // 每 100ms 结束一个步长，最近 4 个步长组成一个 400ms 块
+    for (int i = 0; i < n; i++) {
+        step_energy += energy[i];
+        if (++step_fill < step_samples) continue;
+
+        steps[step_count % 4] = step_energy;
+        step_count++;
+        step_fill = 0;
+        step_energy = 0;
+        if (step_count >= 4) {
+            blocks.push_back((steps[0] + steps[1] + steps[2] + steps[3]) / (4.0 * step_samples));
+        }
+    }
+}
+
+double LoudnessMeter::integrated() const {
+    const double absolute_gate = pow(10.0, (-70.0 + 0.691) / 10.0);
+    double sum = 0;
+    size_t count = 0;
+    for (double block : blocks) {
+        if (block > absolute_gate) {
+            sum += block;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return -70.0;
+    }
+
+    double gate = std::max(absolute_gate, sum / count * 0.1);
+    sum = 0;
+    count = 0;
+    for (double block : blocks) {
+        if (block > gate) {
+            sum += block;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return -70.0;
+    }
+    return -0.691 + 10.0 * log10(sum / count);
+}
+
+double LoudnessMeter::peak() const {
+    return max_sample > 0 ? 20.0 * log10(max_sample) : -120.0;
+}
+
+// ---- 线性归一化解码 ----
+
+void loudness_linear_decoder(AVCodecContext* codec_ctx, PacketQueue& packet_queue, FrameQueue& frame_queue,
+                             const LoudnessOptions& options) {
+    AVFrame* frame = av_frame_alloc();
+    LoudnessMeter meter;
+    bool meter_ready = false;
+    std::vector<AVPacket*> packets;
+    int64_t packet_bytes = 0;
+
+    auto measure_frames = [&]() {
+        while (avcodec_receive_frame(codec_ctx, frame) >= 0) {
+            if (!meter_ready) {
+                meter_ready = meter.init(frame->channels, frame->sample_rate, frame->channel_layout) >= 0;
+            }
+            // 拼接输入中途声道数或采样率变化时，只按首段参数测量
+            if (meter_ready && meter.matches(frame)) {
+                meter.add(frame);
+            }
+            av_frame_unref(frame);
+        }
+    };
+
+    // 第一遍：随视频一起解码测量，压缩包留在内存中
+    while (AVPacket* pkt = packet_queue.pop()) {
+        packets.push_back(pkt);
+        packet_bytes += pkt->size;
+        if (avcodec_send_packet(codec_ctx, pkt) < 0) {
+            continue;
+        }
+        measure_frames();
+    }
+    avcodec_send_packet(codec_ctx, nullptr);
+    measure_frames();
+
+    double loudness = meter.integrated();
+    double gain_db = options.target - loudness;
+    // 采样峰值不超过上限；没有过采样，真峰值可能略高
+    gain_db = std::min(gain_db, options.peak_limit - meter.peak());
+    double gain = pow(10.0, gain_db / 20.0);
+    std::cout << "响度测量: 积分响度 " << loudness << " LUFS，峰值 " << meter.peak() << " dBFS，增益 " << gain_db
+              << " dB（缓存音频包 " << packets.size() << " 个，" << packet_bytes / 1024 << " KB）" << std::endl;
+
+    // 第二遍：重新解码缓存的压缩包并施加固定增益
+    avcodec_flush_buffers(codec_ctx);
+    auto output_frames = [&]() {
+        while (avcodec_receive_frame(codec_ctx, frame) >= 0) {
+            if (av_frame_make_writable(frame) >= 0) {
+                apply_gain(frame, gain);
+            }
+            frame_queue.push(av_frame_clone(frame));
+            av_frame_unref(frame);
+        }
+    };
+    for (AVPacket*& pkt : packets) {
+        if (avcodec_send_packet(codec_ctx, pkt) >= 0) {
+            output_frames();
+        }
+        av_packet_free(&pkt);
+    }
+    avcodec_send_packet(codec_ctx, nullptr);
+    output_frames();
+
+    frame_queue.set_eof();
+    av_frame_free(&frame);
+}
+
+// 线性归一化允许缓冲的编码数据上限
+static const int64_t LINEAR_BUFFER_LIMIT = 1ll << 30;
+
+int check_linear_loudness_buffer(AVFormatContext* fmt_ctx, const std::vector<std::string>& inputs, const ProbeOptions& probe,
+                                 const std::vector<float>& speeds) {
+    // 输出码率与输入相当，每路输出的时长为输入时长除以速度
+    double output_scale = 0;
+    for (float speed : speeds) {
+        output_scale += 1.0 / speed;
+    }
+
+    double buffered = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        AVFormatContext* in_ctx = fmt_ctx;
+        if (i > 0 && open_input(inputs[i], probe, &in_ctx) < 0) {
+            return -1;
+        }
+        int64_t duration = in_ctx->duration;
+        int64_t bit_rate = in_ctx->bit_rate;
+        if (i > 0) {
+            avformat_close_input(&in_ctx);
+        }
+        if (duration <= 0 || bit_rate <= 0) {
+            std::cerr << "线性响度归一化需要已知时长和码率的输入，无法估算缓冲量: " << inputs[i] << std::endl;
+            return -1;
+        }
+        buffered += bit_rate / 8.0 * duration / AV_TIME_BASE * output_scale;
+    }
+
+    if (buffered > LINEAR_BUFFER_LIMIT) {
+        std::cerr << "线性响度归一化需要缓冲约 " << (int64_t)(buffered / (1 << 20)) << " MB 编码数据，超过上限 "
+                  << (LINEAR_BUFFER_LIMIT >> 20) << " MB，请改用 --loudnorm dynamic" << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef LOUDNESS_H
+#define LOUDNESS_H
+
+#include <string>
+#include <vector>
+#include "packet_queue.h"
+#include "frame_queue.h"
+#include "input_probe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// 响度归一化方式
+enum LoudnessMode {
+    LOUDNESS_OFF,
+    LOUDNESS_DYNAMIC,  // 单遍：音频滤波器链中的 loudnorm，带前瞻限幅的动态增益
+    LOUDNESS_LINEAR    // 单遍解码视频：解码时测量积分响度并缓存压缩音频包，结束后重新解码这些包并施加固定增益
+};
+
+struct LoudnessOptions {
+    LoudnessMode mode = LOUDNESS_OFF;
+    double target = -23.0;     // 目标积分响度（LUFS），EBU R128 为 -23
+    double peak_limit = -1.0;  // 峰值上限（dBFS）
+    double range = 7.0;        // 动态模式的目标响度范围（LU）
+};
+
+// 解析 off / dynamic / linear，失败返回 -1
+int parse_loudness_mode(const std::string& name, LoudnessMode* mode);
+
+// 取出音频帧一个声道的采样并转换为 [-1, 1] 的浮点，支持 u8/s16/s32/flt/dbl 的平面和打包格式
+void read_audio_channel(const AVFrame* frame, int ch, float* out);
+
+// ITU-R BS.1770 积分响度测量：K 加权、400ms 块（75% 重叠）、-70 LUFS 绝对门限和 -10 LU 相对门限
+class LoudnessMeter {
+public:
+    int init(int channels, int sample_rate, uint64_t channel_layout);
+    bool matches(const AVFrame* frame) const;
+    void add(const AVFrame* frame);
+
+    // 积分响度（LUFS），音频不足一个块时返回 -70
+    double integrated() const;
+    // 采样峰值（dBFS）
+    double peak() const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+    Biquad shelf = {}, highpass = {};
+    std::vector<double> state;    // 每声道两级滤波器各两个状态
+    std::vector<double> weights;  // 声道权重，环绕声道 1.41，LFE 0
+
+    int channels = 0;
+    int sample_rate = 0;
+    int step_samples = 0;  // 100ms
+    int step_fill = 0;
+    double step_energy = 0;
+    double steps[4] = {};
+    int step_count = 0;
+    std::vector<double> blocks;  // 每 100ms 一个 400ms 块的均方能量
+    double max_sample = 0;
+
+    std::vector<float> samples;
+    std::vector<double> energy;
+};
+
+// 线性归一化的音频解码线程：接管 audio_decoder 的位置，先解码全部音频包测量响度，
+// 压缩包保留在内存中，输入结束后按测得的增益重新解码输出。使用前须经 check_linear_loudness_buffer 检查
+void loudness_linear_decoder(AVCodecContext* codec_ctx, PacketQueue& packet_queue, FrameQueue& frame_queue,
+                             const LoudnessOptions& options);
+
+// 线性归一化在输入结束前不输出音频，复用线程等待音频期间全部编码后的视频包都留在内存中。
+// 按各输入的时长和码率估算需要缓冲的数据量，时长或码率未知、或超过上限时拒绝该模式。
+// fmt_ctx 为已打开的首个输入，其余输入按 probe 打开估算。可以使用返回 0，否则返回 -1
+int check_linear_loudness_buffer(AVFormatContext* fmt_ctx, const std::vector<std::string>& inputs, const ProbeOptions& probe,
+                                 const std::vector<float>& speeds);
+
+#endif
@@ -0,0 +1,175 @@
+#include "memory_io.h"
+#include "job_options.h"
+#include "transcode_job.h"
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+extern "C" {
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+}
+
+// 自定义 AVIOContext 的缓冲区大小
+static const int MEMORY_IO_BUFFER_SIZE = 64 * 1024;
+
+// 按 whence 计算新的读写位置，越界返回负值
+static int64_t seek_position(int64_t offset, int whence, int64_t pos, int64_t size) {
+    switch (whence) {
+    case AVSEEK_SIZE:
+        return size;
+    case SEEK_SET:
+        pos = offset;
+        break;
+    case SEEK_CUR:
+        pos += offset;
+        break;
+    case SEEK_END:
+        pos = size + offset;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    return pos < 0 ? AVERROR(EINVAL) : pos;
+}
+
+MediaSource memory_source(const uint8_t* data, size_t size) {
+    // 读取位置由两个回调共享
+    std::shared_ptr<int64_t> pos(new int64_t(0));
+    MediaSource source;
+    source.read = [data, size, pos](uint8_t* buf, int buf_size) -> int {
+        int64_t remaining = (int64_t)size - *pos;
+        if (remaining <= 0) return AVERROR_EOF;
+        int n = (int)std::min<int64_t>(remaining, buf_size);
+        memcpy(buf, data + *pos, n);
+        *pos += n;
+        return n;
+    };
+    source.seek = [size, pos](int64_t offset, int whence) -> int64_t {
+        int64_t next = seek_position(offset, whence, *pos, (int64_t)size);
+        if (whence != AVSEEK_SIZE && next >= 0) {
+            if (next > (int64_t)size) return AVERROR(EINVAL);
+            *pos = next;
+        }
+        return next;
+    };
+    return source;
+}
+
+MediaSink memory_sink(std::vector<uint8_t>* buffer) {
+    std::shared_ptr<int64_t> pos(new int64_t(0));
+    MediaSink sink;
+    sink.write = [buffer, pos](const uint8_t* buf, int size) -> int {
+        size_t end = (size_t)*pos + size;
+        if (end > buffer->size()) buffer->resize(end);
+        memcpy(buffer->data() + *pos, buf, size);
+        *pos += size;
+        return size;
+    };
+    // 回写 MP4 的 moov 等头部时在已写出的范围内移动，越过末尾的部分在下次写入时补零
+    sink.seek = [buffer, pos](int64_t offset, int whence) -> int64_t {
+        int64_t next = seek_position(offset, whence, *pos, (int64_t)buffer->size());
+        if (whence != AVSEEK_SIZE && next >= 0) *pos = next;
+        return next;
+    };
+    return sink;
+}
+
+static int source_read(void* opaque, uint8_t* buf, int buf_size) {
+    MediaSource* source = static_cast<MediaSource*>(opaque);
+    int n = source->read(buf, buf_size);
+    return n == 0 ? AVERROR_EOF : n;
+}
+
+static int64_t source_seek(void* opaque, int64_t offset, int whence) {
+    MediaSource* source = static_cast<MediaSource*>(opaque);
+    return source->seek(offset, whence & ~AVSEEK_FORCE);
+}
+
+static int sink_write(void* opaque, uint8_t* buf, int buf_size) {
+    MediaSink* sink = static_cast<MediaSink*>(opaque);
+    return sink->write(buf, buf_size);
+}
+
+static int64_t sink_seek(void* opaque, int64_t offset, int whence) {
+    MediaSink* sink = static_cast<MediaSink*>(opaque);
+    return sink->seek(offset, whence & ~AVSEEK_FORCE);
+}
+
+AVIOContext* open_source_io(MediaSource* source) {
+    unsigned char* buffer = static_cast<unsigned char*>(av_malloc(MEMORY_IO_BUFFER_SIZE));
+    if (!buffer) return nullptr;
+    AVIOContext* pb = avio_alloc_context(buffer, MEMORY_IO_BUFFER_SIZE, 0, source, source_read, nullptr,
+                                         source->seek ? source_seek : nullptr);
+    if (!pb) {
+        av_free(buffer);
+        return nullptr;
+    }
+    pb->seekable = source->seek ? AVIO_SEEKABLE_NORMAL : 0;
+    return pb;
+}
+
+AVIOContext* open_sink_io(MediaSink* sink) {
+    unsigned char* buffer = static_cast<unsigned char*>(av_malloc(MEMORY_IO_BUFFER_SIZE));
+    if (!buffer) return nullptr;
+    AVIOContext* pb = avio_alloc_context(buffer, MEMORY_IO_BUFFER_SIZE, 1, sink, nullptr, sink_write,
+                                         sink->seek ? sink_seek : nullptr);
+    if (!pb) {
+        av_free(buffer);
+        return nullptr;
+    }
+    pb->seekable = sink->seek ? AVIO_SEEKABLE_NORMAL : 0;
+    return pb;
+}
+
+void close_memory_io(AVIOContext** pb) {
+    if (!*pb) return;
+    if ((*pb)->write_flag) {
+        avio_flush(*pb);
+    }
+    // 缓冲区可能已被 AVIOContext 重新分配，释放当前指针
+    av_freep(&(*pb)->buffer);
+    avio_context_free(pb);
+}
+
+static int read_file(const std::string& path, std::vector<uint8_t>* data) {
+    std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+    if (!in) return -1;
+    std::streamsize size = in.tellg();
+    in.seekg(0);
+    data->resize(size);
+    return in.read(reinterpret_cast<char*>(data->data()), size) ? 0 : -1;
+}
+
+int run_memory_job(const JobOptions& opts) {
+    std::vector<uint8_t> input_data;
+    if (read_file(opts.inputs[0], &input_data) < 0) {
+        std::cerr << "无法读取输入文件: " << opts.inputs[0] << std::endl;
+        return -1;
+    }
+    std::vector<uint8_t> output_data;
+    MediaSource source = memory_source(input_data.data(), input_data.size());
+    MediaSink sink = memory_sink(&output_data);
+
+    JobOptions job = opts;
+    job.input_source = &source;
+    job.output_sink = &sink;
+    int64_t start = av_gettime_relative();
+    int ret = run_transcode_job(job);
+    std::cout << "内存转码: 输入 " << input_data.size() / (1024.0 * 1024.0) << " MB，输出 "
+              << output_data.size() / (1024.0 * 1024.0) << " MB，耗时 " << (av_gettime_relative() - start) / 1000000.0 << " 秒" << std::endl;
+    if (ret < 0) {
+        return ret;
+    }
+
+    std::ofstream out(opts.output.c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(output_data.data()), output_data.size());
+    if (!out) {
+        std::cerr << "无法写出输出文件: " << opts.output << std::endl;
+        return -1;
+    }
+    return 0;
+}
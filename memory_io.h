@@ -0,0 +1,52 @@
+#ifndef MEMORY_IO_H
+#define MEMORY_IO_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavformat/avformat.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+struct JobOptions;
+
+// 调用方提供的输入：read 读取最多 size 字节，返回读到的字节数，结束返回 AVERROR_EOF，出错返回负的 AVERROR。
+// seek 可为空（只能顺序读取，部分格式如 moov 在末尾的 MP4 无法打开），whence 为 SEEK_SET / SEEK_CUR /
+// SEEK_END 或 AVSEEK_SIZE（返回总大小，未知时返回负值），返回新位置
+struct MediaSource {
+    std::function<int(uint8_t* buf, int size)> read;
+    std::function<int64_t(int64_t offset, int whence)> seek;
+};
+
+// 调用方接收的输出：write 写入 size 字节，返回写入的字节数或负的 AVERROR。seek 可为空，
+// 此时 MP4 输出改为分片写出（不需要回写 moov），其他格式不受影响
+struct MediaSink {
+    std::function<int(const uint8_t* buf, int size)> write;
+    std::function<int64_t(int64_t offset, int whence)> seek;
+};
+
+// 以一段连续内存为输入，内存须在作业结束前保持有效，读取时不复制整段数据
+MediaSource memory_source(const uint8_t* data, size_t size);
+// 输出写入 buffer，支持回写，buffer 须在作业结束前保持有效
+MediaSink memory_sink(std::vector<uint8_t>* buffer);
+
+// 以调用方的回调创建 AVIOContext，缓冲区用 av_malloc 分配，失败返回 nullptr。
+// source / sink 须比返回的上下文活得更久
+AVIOContext* open_source_io(MediaSource* source);
+AVIOContext* open_sink_io(MediaSink* sink);
+// 冲洗并释放上述上下文及其缓冲区，不能用 avio_closep 释放
+void close_memory_io(AVIOContext** pb);
+
+// 内存作业：把输入文件整体读入内存，经内存输入、内存输出完成转码，结束后一次写出输出文件，
+// 转码过程本身不访问文件系统。用于验证内存接口和对比文件读写的开销。成功返回 0
+int run_memory_job(const JobOptions& opts);
+
+#endif
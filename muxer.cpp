@@ -1,6 +1,7 @@
 #include "muxer.h"
 #include <iostream>
 #include <iomanip>
+#include <vector>
 
 extern "C" {
 #include <libavutil/mathematics.h>
@@ -9,10 +10,12 @@ extern "C" {
 
 void muxer(AVFormatContext* out_fmt,
           PacketQueue& video_queue,
-          PacketQueue& audio_queue) {
+          PacketQueue& audio_queue,
+          LatencyTracker* latency) {
     // 写入头部前确保输出格式已正确配置
     if (!out_fmt || !out_fmt->pb) {
         std::cerr << "输出格式上下文未正确初始化" << std::endl;
+        video_queue.fail(AVERROR(EINVAL), "复用");
         return;
     }
 
@@ -20,15 +23,24 @@ void muxer(AVFormatContext* out_fmt,
     std::cout << "输出格式中的流数量: " << out_fmt->nb_streams << std::endl;
     if (out_fmt->nb_streams < 1) {
         std::cerr << "输出格式中没有流" << std::endl;
+        video_queue.fail(AVERROR(EINVAL), "复用");
         return;
     }
 
+    // 包的时间戳沿用写入头部之前各流设置的时间基准（编码器或分段文件的时间基准）。
+    // 写入头部时复用器可能改写流的时间基准（MPEG-TS 统一为 1/90000，MP4 调整视频时间刻度），写出前逐包换算
+    std::vector<AVRational> packet_time_base;
+    for (unsigned int i = 0; i < out_fmt->nb_streams; i++) {
+        packet_time_base.push_back(out_fmt->streams[i]->time_base);
+    }
+
     // 写入文件头
     int ret = avformat_write_header(out_fmt, NULL);
     if (ret < 0) {
         char errbuf[AV_ERROR_MAX_STRING_SIZE];
         av_strerror(ret, errbuf, sizeof(errbuf));
         std::cerr << "无法写入输出文件头部: " << errbuf << std::endl;
+        video_queue.fail(ret, "复用");
         return;
     }
 
@@ -70,8 +82,8 @@ void muxer(AVFormatContext* out_fmt,
             }
 
             // 计算视频和音频的实际时间（秒）
-            double video_ts = video_pkt ? av_q2d(out_fmt->streams[0]->time_base) * video_pkt->pts : INFINITY;
-            double audio_ts = audio_pkt ? av_q2d(out_fmt->streams[1]->time_base) * audio_pkt->pts : INFINITY;
+            double video_ts = video_pkt ? av_q2d(packet_time_base[0]) * video_pkt->pts : INFINITY;
+            double audio_ts = audio_pkt && out_fmt->nb_streams > 1 ? av_q2d(packet_time_base[1]) * audio_pkt->pts : INFINITY;
 
             // 打印当前时间戳信息（调试用）
             if (video_pkt && audio_pkt) {
@@ -108,11 +120,17 @@ void muxer(AVFormatContext* out_fmt,
                     //           << " DTS: " << video_pkt->dts
                     //           << " 大小: " << video_pkt->size << " 字节" << std::endl;
                     
+                    av_packet_rescale_ts(video_pkt, packet_time_base[0], out_fmt->streams[0]->time_base);
+                    int64_t written_ts = av_rescale_q(video_pkt->pts, out_fmt->streams[0]->time_base, AV_TIME_BASE_Q);
                     ret = av_interleaved_write_frame(out_fmt, video_pkt);
+                    if (ret >= 0 && latency) {
+                        latency->packet_out(written_ts);
+                    }
                     if (ret < 0) {
                         char errbuf[AV_ERROR_MAX_STRING_SIZE];
                         av_strerror(ret, errbuf, sizeof(errbuf));
                         std::cerr << "写入视频帧失败: " << errbuf << std::endl;
+                        video_queue.fail(ret, "复用");
                         error_occurred = true;
                     }
                 } else {
@@ -147,11 +165,13 @@ void muxer(AVFormatContext* out_fmt,
                     //           << " DTS: " << audio_pkt->dts
                     //           << " 大小: " << audio_pkt->size << " 字节" << std::endl;
                     
+                    av_packet_rescale_ts(audio_pkt, packet_time_base[1], out_fmt->streams[1]->time_base);
                     ret = av_interleaved_write_frame(out_fmt, audio_pkt);
                     if (ret < 0) {
                         char errbuf[AV_ERROR_MAX_STRING_SIZE];
                         av_strerror(ret, errbuf, sizeof(errbuf));
                         std::cerr << "写入音频帧失败: " << errbuf << std::endl;
+                        video_queue.fail(ret, "复用");
                         error_occurred = true;
                     }
                 } else {
@@ -163,6 +183,7 @@ void muxer(AVFormatContext* out_fmt,
         }
     } catch (const std::exception& e) {
         std::cerr << "复用过程异常: " << e.what() << std::endl;
+        video_queue.fail(AVERROR_UNKNOWN, "复用");
         error_occurred = true;
     }
 
@@ -187,6 +208,7 @@ void muxer(AVFormatContext* out_fmt,
         char errbuf[AV_ERROR_MAX_STRING_SIZE];
         av_strerror(ret, errbuf, sizeof(errbuf));
         std::cerr << "写入文件尾部失败: " << errbuf << std::endl;
+        video_queue.fail(ret, "复用");
     } else {
         std::cout << "文件尾部写入成功" << std::endl;
     }
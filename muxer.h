@@ -13,10 +13,13 @@ extern "C" {
 #endif
 
 #include "packet_queue.h"
+#include "live_latency.h"
 
+// latency 不为空时每写出一个视频包计算一次管线延迟（直播模式）
 void muxer(AVFormatContext* out_fmt,
           PacketQueue& video_queue,
-          PacketQueue& audio_queue);
+          PacketQueue& audio_queue,
+          LatencyTracker* latency = nullptr);
 
 
 #endif
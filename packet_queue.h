@@ -2,6 +2,7 @@
 #define PACKET_QUEUE_H
 
 #include "Queue.h"
+#include "cancel_token.h"
 #include <mutex>
 #include <condition_variable>
 
@@ -20,16 +21,38 @@ struct PacketQueue {
     std::mutex mutex;
     std::condition_variable cond;
     bool eof = false;
+    bool cancelled = false;
+    CancelToken* cancel_token = nullptr;
+    int listener_id = -1;
+
+    PacketQueue() = default;
+    PacketQueue(const PacketQueue&) = delete;
+    PacketQueue& operator=(const PacketQueue&) = delete;
+
+    ~PacketQueue() {
+        if (cancel_token) cancel_token->remove_listener(listener_id);
+        discard();
+    }
+
+    // 挂接作业的取消令牌，须在生产和消费线程启动之前调用
+    void attach(CancelToken* token) {
+        cancel_token = token;
+        listener_id = token->add_listener([this]() { cancel(); });
+    }
 
     void push(AVPacket* pkt) {
         std::lock_guard<std::mutex> lock(mutex);
+        if (cancelled) {
+            av_packet_free(&pkt);
+            return;
+        }
         queue.push(pkt);
         cond.notify_one();
     }
 
     AVPacket* pop() {
         std::unique_lock<std::mutex> lock(mutex);
-        while (queue.isEmpty() && !eof) {
+        while (queue.isEmpty() && !eof && !cancelled) {
             cond.wait(lock);
         }
         if (queue.isEmpty()) return nullptr;
@@ -43,7 +66,36 @@ struct PacketQueue {
         eof = true;
         cond.notify_all();
     }
+
+    // 阶段出错：取消整个作业；未挂接令牌时只结束本队列
+    void fail(int error, const std::string& stage) {
+        if (!cancel_token || !cancel_token->cancel(error, stage)) {
+            set_eof();
+        }
+    }
+
+    // 作业是否已取消，生产者据此提前停止
+    bool is_cancelled() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled;
+    }
+
+    // 令牌取消时调用：释放已排队的包并唤醒等待者
+    void cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        discard();
+        cond.notify_all();
+    }
+
+private:
+    void discard() {
+        while (!queue.isEmpty()) {
+            AVPacket* pkt = queue.peek();
+            queue.pop();
+            av_packet_free(&pkt);
+        }
+    }
 };
 
 #endif
-
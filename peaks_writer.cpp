@@ -0,0 +1,208 @@
+#include "peaks_writer.h"
+#include "loudness.h"
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+
+extern "C" {
+#include "libavutil/samplefmt.h"
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// 一个声道在当前窗口内的统计
+struct PeakStats {
+    float min = FLT_MAX;
+    float max = -FLT_MAX;
+    double sum_squares = 0;
+};
+
+// 把 n 个采样累加到窗口统计
+static void accumulate_peaks(const float* p, int n, PeakStats& stats) {
+    float mn = stats.min, mx = stats.max;
+    double sum = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    if (n >= 4) {
+        __m128 vmin = _mm_set1_ps(mn), vmax = _mm_set1_ps(mx), vsum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4) {
+            __m128 v = _mm_loadu_ps(p + i);
+            vmin = _mm_min_ps(vmin, v);
+            vmax = _mm_max_ps(vmax, v);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+        }
+        float lanes_min[4], lanes_max[4], lanes_sum[4];
+        _mm_storeu_ps(lanes_min, vmin);
+        _mm_storeu_ps(lanes_max, vmax);
+        _mm_storeu_ps(lanes_sum, vsum);
+        for (int k = 0; k < 4; k++) {
+            mn = std::min(mn, lanes_min[k]);
+            mx = std::max(mx, lanes_max[k]);
+            sum += lanes_sum[k];
+        }
+    }
+#elif defined(__ARM_NEON)
+    if (n >= 4) {
+        float32x4_t vmin = vdupq_n_f32(mn), vmax = vdupq_n_f32(mx), vsum = vdupq_n_f32(0);
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t v = vld1q_f32(p + i);
+            vmin = vminq_f32(vmin, v);
+            vmax = vmaxq_f32(vmax, v);
+            vsum = vmlaq_f32(vsum, v, v);
+        }
+        float lanes_min[4], lanes_max[4], lanes_sum[4];
+        vst1q_f32(lanes_min, vmin);
+        vst1q_f32(lanes_max, vmax);
+        vst1q_f32(lanes_sum, vsum);
+        for (int k = 0; k < 4; k++) {
+            mn = std::min(mn, lanes_min[k]);
+            mx = std::max(mx, lanes_max[k]);
+            sum += lanes_sum[k];
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        mn = std::min(mn, p[i]);
+        mx = std::max(mx, p[i]);
+        sum += p[i] * p[i];
+    }
+    stats.min = mn;
+    stats.max = mx;
+    stats.sum_squares += sum;
+}
+
+static int16_t to_int16(double v) {
+    return (int16_t)std::lrint(std::max(-1.0, std::min(1.0, v)) * 32767.0);
+}
+
+static void put_le32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    p[2] = (v >> 16) & 0xff;
+    p[3] = v >> 24;
+}
+
+static bool has_json_extension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    return dot != std::string::npos && path.substr(dot + 1) == "json";
+}
+
+void peaks_writer(FrameQueue& frame_queue, const std::string& output_file, int window_samples) {
+    FILE* file = fopen(output_file.c_str(), "wb");
+    if (!file) {
+        std::cerr << "无法打开峰值输出文件: " << output_file << std::endl;
+        // 继续取出并释放帧，避免上游分发线程的引用无人释放
+        while (AVFrame* frame = frame_queue.pop()) {
+            av_frame_free(&frame);
+        }
+        return;
+    }
+
+    bool json = has_json_extension(output_file);
+    int window = std::max(1, window_samples);
+    int channels = 0, sample_rate = 0;
+    std::vector<PeakStats> stats;
+    std::vector<float> samples;
+    int fill = 0;
+    uint32_t window_count = 0;
+
+    auto emit_window = [&]() {
+        for (int ch = 0; ch < channels; ch++) {
+            int16_t values[3] = { to_int16(stats[ch].min), to_int16(stats[ch].max),
+                                  to_int16(sqrt(stats[ch].sum_squares / fill)) };
+            if (json) {
+                fprintf(file, "%s%d,%d,%d", window_count == 0 && ch == 0 ? "" : ",", values[0], values[1], values[2]);
+            } else {
+                uint8_t bytes[6];
+                for (int k = 0; k < 3; k++) {
+                    bytes[2 * k] = (uint16_t)values[k] & 0xff;
+                    bytes[2 * k + 1] = (uint16_t)values[k] >> 8;
+                }
+                fwrite(bytes, 1, sizeof(bytes), file);
+            }
+            stats[ch] = PeakStats();
+        }
+        window_count++;
+        fill = 0;
+    };
+
+    while (AVFrame* frame = frame_queue.pop()) {
+        if (channels == 0) {
+            // 以第一帧的参数作为输出格式
+            channels = frame->channels;
+            sample_rate = frame->sample_rate;
+            stats.assign(channels, PeakStats());
+            if (json) {
+                fprintf(file, "{\"version\":1,\"sample_rate\":%d,\"channels\":%d,\"samples_per_window\":%d,\"data\":[",
+                        sample_rate, channels, window);
+            } else {
+                uint8_t header[24];
+                memcpy(header, "PEAK", 4);
+                put_le32(header + 4, 1);
+                put_le32(header + 8, sample_rate);
+                put_le32(header + 12, channels);
+                put_le32(header + 16, window);
+                put_le32(header + 20, 0);
+                fwrite(header, 1, sizeof(header), file);
+            }
+        } else if (frame->channels != channels || frame->sample_rate != sample_rate) {
+            std::cerr << "音频参数中途变化，峰值输出丢弃该帧" << std::endl;
+            av_frame_free(&frame);
+            continue;
+        }
+
+        // 平面浮点直接读取，其他格式先逐声道转换
+        bool direct = frame->format == AV_SAMPLE_FMT_FLTP || (frame->format == AV_SAMPLE_FMT_FLT && channels == 1);
+        int n = frame->nb_samples;
+        if (!direct) {
+            samples.resize((size_t)n * channels);
+            for (int ch = 0; ch < channels; ch++) {
+                read_audio_channel(frame, ch, samples.data() + (size_t)ch * n);
+            }
+        }
+
+        int pos = 0;
+        while (pos < n) {
+            int take = std::min(n - pos, window - fill);
+            for (int ch = 0; ch < channels; ch++) {
+                const float* p = direct ? reinterpret_cast<const float*>(frame->extended_data[ch]) : samples.data() + (size_t)ch * n;
+                accumulate_peaks(p + pos, take, stats[ch]);
+            }
+            pos += take;
+            fill += take;
+            if (fill == window) {
+                emit_window();
+            }
+        }
+        av_frame_free(&frame);
+    }
+
+    if (fill > 0) {
+        emit_window();
+    }
+    if (json) {
+        if (channels == 0) {
+            fprintf(file, "{\"version\":1,\"data\":[");
+        }
+        fprintf(file, "],\"length\":%u}\n", window_count);
+    } else if (channels > 0) {
+        // 回填窗口数
+        uint8_t count[4];
+        put_le32(count, window_count);
+        fseek(file, 20, SEEK_SET);
+        fwrite(count, 1, sizeof(count), file);
+    }
+    if (fclose(file) != 0) {
+        std::cerr << "写入峰值输出文件失败: " << output_file << std::endl;
+    }
+
+    std::cout << "波形峰值写入完成，共 " << window_count << " 个窗口" << std::endl;
+}
@@ -0,0 +1,17 @@
+#ifndef PEAKS_WRITER_H
+#define PEAKS_WRITER_H
+
+#include <string>
+#include "frame_queue.h"
+
+// 波形峰值输出：从帧队列读取解码后的音频，每 window_samples 个采样为一个窗口，
+// 按声道计算最小值、最大值和均方根（SIMD），转码过程中顺带写出，供编辑器绘制波形。
+//
+// 扩展名为 .json 时写 JSON：
+//   {"version":1,"sample_rate":..,"channels":..,"samples_per_window":..,"data":[min,max,rms,...],"length":窗口数}
+// 否则写小端二进制：
+//   "PEAK" | uint32 版本(1) | uint32 采样率 | uint32 声道数 | uint32 窗口采样数 | uint32 窗口数（结束时回填）
+//   之后每个窗口按声道依次为 int16 min, int16 max, int16 rms，满幅为 32767
+void peaks_writer(FrameQueue& frame_queue, const std::string& output_file, int window_samples);
+
+#endif
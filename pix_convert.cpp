@@ -0,0 +1,428 @@
+#include "pix_convert.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/cpu.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PIX_X86 1
+#endif
+
+// 每个切片至少包含的行数，太小时线程唤醒开销超过收益
+static const int MIN_SLICE_ROWS = 64;
+static const int MAX_SLICE_THREADS = 8;
+
+// 4x4 Bayer 矩阵右移 2 位（0-3），作为 10 位转 8 位时的有序抖动，按行号和列号取值
+static const uint16_t DITHER_4X4[4][4] = {
+    { 0, 2, 0, 2 },
+    { 3, 1, 3, 1 },
+    { 0, 2, 0, 2 },
+    { 3, 1, 3, 1 },
+};
+
+// ---- 行内核：标量实现 ----
+
+static void deinterleave_uv_c(uint8_t* u, uint8_t* v, const uint8_t* uv, int n) {
+    for (int i = 0; i < n; i++) {
+        u[i] = uv[2 * i];
+        v[i] = uv[2 * i + 1];
+    }
+}
+
+static void interleave_uv_c(uint8_t* uv, const uint8_t* u, const uint8_t* v, int n) {
+    for (int i = 0; i < n; i++) {
+        uv[2 * i] = u[i];
+        uv[2 * i + 1] = v[i];
+    }
+}
+
+static void avg_rows_c(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n) {
+    for (int i = 0; i < n; i++) {
+        dst[i] = (a[i] + b[i] + 1) >> 1;
+    }
+}
+
+static void dither_10to8_c(uint8_t* dst, const uint16_t* src, int n, const uint16_t* dither) {
+    for (int i = 0; i < n; i++) {
+        int v = (src[i] + dither[i & 3]) >> 2;
+        dst[i] = v > 255 ? 255 : v;
+    }
+}
+
+static void avg_dither_10to8_c(uint8_t* dst, const uint16_t* a, const uint16_t* b, int n, const uint16_t* dither) {
+    for (int i = 0; i < n; i++) {
+        int v = (((a[i] + b[i] + 1) >> 1) + dither[i & 3]) >> 2;
+        dst[i] = v > 255 ? 255 : v;
+    }
+}
+
+// ---- 行内核：SSE2 / AVX2 ----
+
+#ifdef PIX_X86
+static void deinterleave_uv_sse2(uint8_t* u, uint8_t* v, const uint8_t* uv, int n) {
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * i + 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(u + i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(v + i),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    deinterleave_uv_c(u + i, v + i, uv + 2 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void deinterleave_uv_avx2(uint8_t* u, uint8_t* v, const uint8_t* uv, int n) {
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + 2 * i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(uv + 2 * i + 32));
+        // packus 按 128 位通道交叉，permute 恢复顺序
+        __m256i uu = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+        __m256i vv = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(u + i), _mm256_permute4x64_epi64(uu, 0xd8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(v + i), _mm256_permute4x64_epi64(vv, 0xd8));
+    }
+    deinterleave_uv_sse2(u + i, v + i, uv + 2 * i, n - i);
+}
+
+static void interleave_uv_sse2(uint8_t* uv, const uint8_t* u, const uint8_t* v, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    interleave_uv_c(uv + 2 * i, u + i, v + i, n - i);
+}
+
+static void avg_rows_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_avg_epu8(x, y));
+    }
+    avg_rows_c(dst + i, a + i, b + i, n - i);
+}
+
+static void dither_10to8_sse2(uint8_t* dst, const uint16_t* src, int n, const uint16_t* dither) {
+    const __m128i d = _mm_setr_epi16(dither[0], dither[1], dither[2], dither[3], dither[0], dither[1], dither[2], dither[3]);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        a = _mm_srli_epi16(_mm_adds_epu16(a, d), 2);
+        b = _mm_srli_epi16(_mm_adds_epu16(b, d), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+    }
+    dither_10to8_c(dst + i, src + i, n - i, dither);
+}
+
+__attribute__((target("avx2")))
+static void dither_10to8_avx2(uint8_t* dst, const uint16_t* src, int n, const uint16_t* dither) {
+    const __m256i d = _mm256_setr_epi16(dither[0], dither[1], dither[2], dither[3], dither[0], dither[1], dither[2], dither[3],
+                                        dither[0], dither[1], dither[2], dither[3], dither[0], dither[1], dither[2], dither[3]);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 16));
+        a = _mm256_srli_epi16(_mm256_adds_epu16(a, d), 2);
+        b = _mm256_srli_epi16(_mm256_adds_epu16(b, d), 2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8));
+    }
+    dither_10to8_sse2(dst + i, src + i, n - i, dither);
+}
+
+static void avg_dither_10to8_sse2(uint8_t* dst, const uint16_t* a, const uint16_t* b, int n, const uint16_t* dither) {
+    const __m128i d = _mm_setr_epi16(dither[0], dither[1], dither[2], dither[3], dither[0], dither[1], dither[2], dither[3]);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m128i hi = _mm_avg_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8)),
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 8)));
+        lo = _mm_srli_epi16(_mm_adds_epu16(lo, d), 2);
+        hi = _mm_srli_epi16(_mm_adds_epu16(hi, d), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    avg_dither_10to8_c(dst + i, a + i, b + i, n - i, dither);
+}
+#endif
+
+// ---- 运行时选择 ----
+
+typedef void (*DeinterleaveFunc)(uint8_t*, uint8_t*, const uint8_t*, int);
+typedef void (*InterleaveFunc)(uint8_t*, const uint8_t*, const uint8_t*, int);
+typedef void (*AvgRowsFunc)(uint8_t*, const uint8_t*, const uint8_t*, int);
+typedef void (*DitherFunc)(uint8_t*, const uint16_t*, int, const uint16_t*);
+typedef void (*AvgDitherFunc)(uint8_t*, const uint16_t*, const uint16_t*, int, const uint16_t*);
+
+struct RowKernels {
+    DeinterleaveFunc deinterleave_uv = deinterleave_uv_c;
+    InterleaveFunc interleave_uv = interleave_uv_c;
+    AvgRowsFunc avg_rows = avg_rows_c;
+    DitherFunc dither_10to8 = dither_10to8_c;
+    AvgDitherFunc avg_dither_10to8 = avg_dither_10to8_c;
+};
+
+static RowKernels select_kernels() {
+    RowKernels k;
+#ifdef PIX_X86
+    int flags = av_get_cpu_flags();
+    if (flags & AV_CPU_FLAG_SSE2) {
+        k.deinterleave_uv = deinterleave_uv_sse2;
+        k.interleave_uv = interleave_uv_sse2;
+        k.avg_rows = avg_rows_sse2;
+        k.dither_10to8 = dither_10to8_sse2;
+        k.avg_dither_10to8 = avg_dither_10to8_sse2;
+    }
+    if (flags & AV_CPU_FLAG_AVX2) {
+        k.deinterleave_uv = deinterleave_uv_avx2;
+        k.dither_10to8 = dither_10to8_avx2;
+    }
+#endif
+    return k;
+}
+
+static const RowKernels kernels = select_kernels();
+
+static const uint16_t* dither_row(int y) {
+    return DITHER_4X4[y & 3];
+}
+
+template <typename T>
+static const T* row_ptr(const AVFrame* frame, int plane, int y) {
+    return reinterpret_cast<const T*>(frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane]);
+}
+
+static uint8_t* row_ptr(AVFrame* frame, int plane, int y) {
+    return frame->data[plane] + (ptrdiff_t)y * frame->linesize[plane];
+}
+
+// ---- PixConverter ----
+
+PixConverter::~PixConverter() {
+    reset();
+}
+
+void PixConverter::reset() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    start_cond.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    quit = false;
+
+    sws_freeContext(sws);
+    sws = nullptr;
+    slice_rows.clear();
+    kernel = KERNEL_NONE;
+}
+
+bool PixConverter::matches(const AVFrame* frame, AVPixelFormat dst) const {
+    return kernel != KERNEL_NONE && frame->width == width && frame->height == height &&
+           frame->format == src_fmt && dst == dst_fmt;
+}
+
+int PixConverter::init(int w, int h, AVPixelFormat src, AVPixelFormat dst, int threads) {
+    reset();
+    width = w;
+    height = h;
+    src_fmt = src;
+    dst_fmt = dst;
+
+    if (src == AV_PIX_FMT_NV12 && dst == AV_PIX_FMT_YUV420P) {
+        kernel = KERNEL_NV12_TO_I420;
+    } else if (src == AV_PIX_FMT_YUV420P && dst == AV_PIX_FMT_NV12) {
+        kernel = KERNEL_I420_TO_NV12;
+    } else if (src == AV_PIX_FMT_YUV422P && dst == AV_PIX_FMT_YUV420P) {
+        kernel = KERNEL_I422_TO_I420;
+    } else if (src == AV_PIX_FMT_YUV420P10LE && dst == AV_PIX_FMT_YUV420P) {
+        kernel = KERNEL_I420P10_TO_I420;
+    } else if (src == AV_PIX_FMT_YUV422P10LE && dst == AV_PIX_FMT_YUV420P) {
+        kernel = KERNEL_I422P10_TO_I420;
+    } else {
+        kernel = KERNEL_SWSCALE;
+    }
+
+    // 切片高度取 4 的倍数，保证各种色度下采样的行都落在同一切片内
+    if (threads <= 0) {
+        threads = std::min(av_cpu_count(), MAX_SLICE_THREADS);
+    }
+    if (kernel == KERNEL_SWSCALE) {
+        // swscale 的垂直滤波器抽头跨越多行，切片各自作为独立图像转换时抽头在切片边缘被截断，
+        // 色度需要垂直重采样时每个切片边界出现接缝，回退路径整帧转换
+        threads = 1;
+    }
+    threads = std::max(1, std::min(threads, height / MIN_SLICE_ROWS));
+    int rows_per_slice = FFALIGN((height + threads - 1) / threads, 4);
+    for (int y = 0; y < height; y += rows_per_slice) {
+        slice_rows.push_back(y);
+    }
+    slice_rows.push_back(height);
+    int slices = (int)slice_rows.size() - 1;
+
+    if (kernel == KERNEL_SWSCALE) {
+        sws = sws_getContext(width, height, src, width, height, dst, SWS_BICUBIC, nullptr, nullptr, nullptr);
+        if (!sws) {
+            std::cerr << "无法创建像素格式转换上下文: " << av_get_pix_fmt_name(src)
+                      << " -> " << av_get_pix_fmt_name(dst) << std::endl;
+            reset();
+            return -1;
+        }
+    }
+
+    uint64_t start_generation = generation;
+    for (int i = 1; i < slices; i++) {
+        workers.emplace_back([this, i, start_generation]() {
+            uint64_t seen = start_generation;
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    start_cond.wait(lock, [&]() { return quit || generation != seen; });
+                    if (quit) return;
+                    seen = generation;
+                }
+                run_worker_slice(i);
+            }
+        });
+    }
+
+    std::cout << "像素格式转换: " << av_get_pix_fmt_name(src) << " -> " << av_get_pix_fmt_name(dst)
+              << (kernel == KERNEL_SWSCALE ? " (swscale)" : " (SIMD)") << "，" << slices << " 个切片" << std::endl;
+    return 0;
+}
+
+// 工作线程执行一个切片，完成后通知调用方
+void PixConverter::run_worker_slice(int slice) {
+    job(slice);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pending_slices == 0) {
+        done_cond.notify_one();
+    }
+}
+
+void PixConverter::run_slices(const std::function<void(int)>& slice_job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = slice_job;
+        pending_slices = (int)workers.size();
+        generation++;
+    }
+    start_cond.notify_all();
+
+    // 调用线程处理第 0 个切片
+    slice_job(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cond.wait(lock, [&]() { return pending_slices == 0; });
+}
+
+void PixConverter::convert_slice(const AVFrame* src, AVFrame* dst, int slice) {
+    int y0 = slice_rows[slice];
+    int y1 = slice_rows[slice + 1];
+    int chroma_w = AV_CEIL_RSHIFT(width, 1);
+
+    switch (kernel) {
+    case KERNEL_NV12_TO_I420:
+        for (int y = y0; y < y1; y++) {
+            memcpy(row_ptr(dst, 0, y), row_ptr<uint8_t>(src, 0, y), width);
+        }
+        for (int y = y0 / 2; y < AV_CEIL_RSHIFT(y1, 1); y++) {
+            kernels.deinterleave_uv(row_ptr(dst, 1, y), row_ptr(dst, 2, y), row_ptr<uint8_t>(src, 1, y), chroma_w);
+        }
+        break;
+
+    case KERNEL_I420_TO_NV12:
+        for (int y = y0; y < y1; y++) {
+            memcpy(row_ptr(dst, 0, y), row_ptr<uint8_t>(src, 0, y), width);
+        }
+        for (int y = y0 / 2; y < AV_CEIL_RSHIFT(y1, 1); y++) {
+            kernels.interleave_uv(row_ptr(dst, 1, y), row_ptr<uint8_t>(src, 1, y), row_ptr<uint8_t>(src, 2, y), chroma_w);
+        }
+        break;
+
+    case KERNEL_I422_TO_I420:
+        for (int y = y0; y < y1; y++) {
+            memcpy(row_ptr(dst, 0, y), row_ptr<uint8_t>(src, 0, y), width);
+        }
+        // 4:2:2 的色度行两两平均，奇数高度的最后一行与自身平均
+        for (int p = 1; p <= 2; p++) {
+            for (int y = y0 / 2; y < AV_CEIL_RSHIFT(y1, 1); y++) {
+                int next = std::min(2 * y + 1, height - 1);
+                kernels.avg_rows(row_ptr(dst, p, y), row_ptr<uint8_t>(src, p, 2 * y), row_ptr<uint8_t>(src, p, next), chroma_w);
+            }
+        }
+        break;
+
+    case KERNEL_I420P10_TO_I420:
+        for (int y = y0; y < y1; y++) {
+            kernels.dither_10to8(row_ptr(dst, 0, y), row_ptr<uint16_t>(src, 0, y), width, dither_row(y));
+        }
+        for (int p = 1; p <= 2; p++) {
+            for (int y = y0 / 2; y < AV_CEIL_RSHIFT(y1, 1); y++) {
+                kernels.dither_10to8(row_ptr(dst, p, y), row_ptr<uint16_t>(src, p, y), chroma_w, dither_row(y));
+            }
+        }
+        break;
+
+    case KERNEL_I422P10_TO_I420:
+        for (int y = y0; y < y1; y++) {
+            kernels.dither_10to8(row_ptr(dst, 0, y), row_ptr<uint16_t>(src, 0, y), width, dither_row(y));
+        }
+        for (int p = 1; p <= 2; p++) {
+            for (int y = y0 / 2; y < AV_CEIL_RSHIFT(y1, 1); y++) {
+                int next = std::min(2 * y + 1, height - 1);
+                kernels.avg_dither_10to8(row_ptr(dst, p, y), row_ptr<uint16_t>(src, p, 2 * y),
+                                         row_ptr<uint16_t>(src, p, next), chroma_w, dither_row(y));
+            }
+        }
+        break;
+
+    case KERNEL_SWSCALE:
+        // 只有一个切片，整帧转换
+        sws_scale(sws, src->data, src->linesize, 0, height, dst->data, dst->linesize);
+        break;
+
+    default:
+        break;
+    }
+}
+
+AVFrame* PixConverter::convert(const AVFrame* src) {
+    if (kernel == KERNEL_NONE) {
+        return nullptr;
+    }
+
+    AVFrame* dst = av_frame_alloc();
+    if (!dst) {
+        return nullptr;
+    }
+    dst->format = dst_fmt;
+    dst->width = width;
+    dst->height = height;
+    if (av_frame_get_buffer(dst, 32) < 0 || av_frame_copy_props(dst, src) < 0) {
+        std::cerr << "无法分配像素格式转换输出帧" << std::endl;
+        av_frame_free(&dst);
+        return nullptr;
+    }
+
+    run_slices([this, src, dst](int slice) { convert_slice(src, dst, slice); });
+    return dst;
+}
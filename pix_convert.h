@@ -0,0 +1,78 @@
+#ifndef PIX_CONVERT_H
+#define PIX_CONVERT_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+struct SwsContext;
+
+// 编码前的像素格式转换（不缩放）。常见转换使用 SIMD 内核：
+//   NV12 <-> YUV420P、YUV422P -> YUV420P、10 位 4:2:0/4:2:2 -> 8 位 4:2:0（有序抖动），
+// 其他组合回退到 swscale（整帧转换，不切片）。SIMD 内核按行切片，由固定的工作线程并行处理。
+class PixConverter {
+public:
+    PixConverter() = default;
+    ~PixConverter();
+    PixConverter(const PixConverter&) = delete;
+    PixConverter& operator=(const PixConverter&) = delete;
+
+    // threads <= 0 时按 CPU 核数和图像高度自动选择
+    int init(int width, int height, AVPixelFormat src_fmt, AVPixelFormat dst_fmt, int threads = 0);
+
+    // 当前配置是否适用于该帧
+    bool matches(const AVFrame* frame, AVPixelFormat dst_fmt) const;
+
+    // 转换一帧，返回新分配的帧（复制时间戳等属性），失败返回 nullptr
+    AVFrame* convert(const AVFrame* src);
+
+private:
+    enum Kernel {
+        KERNEL_NONE,
+        KERNEL_NV12_TO_I420,
+        KERNEL_I420_TO_NV12,
+        KERNEL_I422_TO_I420,
+        KERNEL_I420P10_TO_I420,
+        KERNEL_I422P10_TO_I420,
+        KERNEL_SWSCALE
+    };
+
+    int width = 0;
+    int height = 0;
+    AVPixelFormat src_fmt = AV_PIX_FMT_NONE;
+    AVPixelFormat dst_fmt = AV_PIX_FMT_NONE;
+    Kernel kernel = KERNEL_NONE;
+
+    // 切片边界（亮度行号），slice_rows.size() == 切片数 + 1
+    std::vector<int> slice_rows;
+    SwsContext* sws = nullptr;   // swscale 回退路径的上下文
+
+    // 常驻工作线程，每帧唤醒一次，按切片号分工
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_cond, done_cond;
+    std::function<void(int)> job;
+    uint64_t generation = 0;
+    int pending_slices = 0;
+    bool quit = false;
+
+    void reset();
+    void run_worker_slice(int slice);
+    void run_slices(const std::function<void(int)>& slice_job);
+    void convert_slice(const AVFrame* src, AVFrame* dst, int slice);
+};
+
+#endif
@@ -0,0 +1,34 @@
+#include "proxy_mode.h"
+#include <iostream>
+#include <algorithm>
+
+void proxy_output_size(int in_width, int in_height, int width, int height, int* out_width, int* out_height) {
+    if (width <= 0 || width > in_width) {
+        width = in_width;
+    }
+    if (height <= 0) {
+        height = in_width > 0 ? (int)((int64_t)width * in_height / in_width) : in_height;
+    }
+    height = std::min(height, in_height);
+    *out_width = std::max(2, width & ~1);
+    *out_height = std::max(2, height & ~1);
+}
+
+void apply_proxy_decode_options(AVCodecContext* dec_ctx, const AVCodec* codec, int target_width, int target_height) {
+    // 每级 lowres 宽高减半，取仍不小于目标尺寸的最大级数
+    int lowres = 0;
+    while (lowres < codec->max_lowres &&
+           (dec_ctx->width >> (lowres + 1)) >= target_width &&
+           (dec_ctx->height >> (lowres + 1)) >= target_height) {
+        lowres++;
+    }
+    dec_ctx->lowres = lowres;
+
+    dec_ctx->skip_loop_filter = AVDISCARD_ALL;
+    dec_ctx->skip_idct = AVDISCARD_NONREF;
+    dec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+
+    std::cout << "代理模式解码: " << codec->name << " lowres=" << lowres
+              << (lowres > 0 ? "" : "（解码器不支持或无需降低分辨率）")
+              << "，跳过去块滤波，非参考帧跳过 IDCT" << std::endl;
+}
@@ -0,0 +1,23 @@
+#ifndef PROXY_MODE_H
+#define PROXY_MODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavcodec/avcodec.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+// 代理输出尺寸：只给宽度（height <= 0）时按输入宽高比计算高度，结果取偶数且不超过输入尺寸
+void proxy_output_size(int in_width, int in_height, int width, int height, int* out_width, int* out_height);
+
+// 按代理输出尺寸为解码器选择代价最低的选项，须在 avcodec_open2 之前调用：
+//   lowres      解码器支持时按 2 的幂降低解码分辨率，但不低于目标尺寸
+//   skip_loop_filter  跳过去块滤波（H.264/HEVC 等），误差不会跨帧累积到肉眼可见
+//   skip_idct   只对非参考帧跳过，避免误差通过参考帧传播
+void apply_proxy_decode_options(AVCodecContext* dec_ctx, const AVCodec* codec, int target_width, int target_height);
+
+#endif
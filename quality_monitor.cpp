@@ -0,0 +1,270 @@
+#include "quality_monitor.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ---- 平面误差平方和 ----
+
+static uint64_t plane_sse_c(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int width, int height) {
+    uint64_t total = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int d = a[x] - b[x];
+            total += d * d;
+        }
+        a += a_stride;
+        b += b_stride;
+    }
+    return total;
+}
+
+#if defined(__SSE2__)
+static uint64_t plane_sse_sse2(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int width, int height) {
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t total = 0;
+    for (int y = 0; y < height; y++) {
+        // 每行单独累加 32 位和，宽度不超过一万多像素时不会溢出
+        __m128i acc = _mm_setzero_si128();
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+            __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+            __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(lo, lo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(hi, hi));
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        total += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        for (; x < width; x++) {
+            int d = a[x] - b[x];
+            total += d * d;
+        }
+        a += a_stride;
+        b += b_stride;
+    }
+    return total;
+}
+#define plane_sse plane_sse_sse2
+#else
+#define plane_sse plane_sse_c
+#endif
+
+// ---- SSIM：8x8 窗口，步长 4 ----
+
+struct SsimSums {
+    int s1, s2, ss, s12;
+};
+
+static SsimSums ssim_sums_c(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride) {
+    SsimSums sums = { 0, 0, 0, 0 };
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            sums.s1 += a[x];
+            sums.s2 += b[x];
+            sums.ss += a[x] * a[x] + b[x] * b[x];
+            sums.s12 += a[x] * b[x];
+        }
+        a += a_stride;
+        b += b_stride;
+    }
+    return sums;
+}
+
+#if defined(__SSE2__)
+static int hsum_epi32(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+static SsimSums ssim_sums_sse2(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i s1 = zero, s2 = zero, ss = zero, s12 = zero;
+    for (int y = 0; y < 8; y++) {
+        __m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)), zero);
+        __m128i vb = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)), zero);
+        s1 = _mm_add_epi32(s1, _mm_madd_epi16(va, ones));
+        s2 = _mm_add_epi32(s2, _mm_madd_epi16(vb, ones));
+        ss = _mm_add_epi32(ss, _mm_add_epi32(_mm_madd_epi16(va, va), _mm_madd_epi16(vb, vb)));
+        s12 = _mm_add_epi32(s12, _mm_madd_epi16(va, vb));
+        a += a_stride;
+        b += b_stride;
+    }
+    SsimSums sums = { hsum_epi32(s1), hsum_epi32(s2), hsum_epi32(ss), hsum_epi32(s12) };
+    return sums;
+}
+#define ssim_sums ssim_sums_sse2
+#else
+#define ssim_sums ssim_sums_c
+#endif
+
+// 与 x264 相同的 SSIM 公式，窗口像素数 64
+static double ssim_window(const SsimSums& s) {
+    const double c1 = 0.01 * 0.01 * 255 * 255 * 64 * 64;
+    const double c2 = 0.03 * 0.03 * 255 * 255 * 64 * 63;
+    double fs1 = s.s1, fs2 = s.s2;
+    double vars = (double)s.ss * 64 - fs1 * fs1 - fs2 * fs2;
+    double covar = (double)s.s12 * 64 - fs1 * fs2;
+    return (2 * fs1 * fs2 + c1) * (2 * covar + c2) / ((fs1 * fs1 + fs2 * fs2 + c1) * (vars + c2));
+}
+
+static double plane_ssim(const uint8_t* a, int a_stride, const uint8_t* b, int b_stride, int width, int height) {
+    double total = 0;
+    int count = 0;
+    for (int y = 0; y + 8 <= height; y += 4) {
+        for (int x = 0; x + 8 <= width; x += 4) {
+            total += ssim_window(ssim_sums(a + (ptrdiff_t)y * a_stride + x, a_stride, b + (ptrdiff_t)y * b_stride + x, b_stride));
+            count++;
+        }
+    }
+    return count > 0 ? total / count : 1.0;
+}
+
+static double psnr_from_sse(uint64_t sse, int64_t pixels) {
+    if (sse == 0 || pixels == 0) return 100.0;
+    double mse = (double)sse / pixels;
+    return std::min(100.0, 10.0 * log10(255.0 * 255.0 / mse));
+}
+
+// ---- QualityMonitor ----
+
+QualityMonitor::~QualityMonitor() {
+    for (auto& item : references) {
+        av_frame_free(&item.second);
+    }
+    avcodec_free_context(&dec_ctx);
+}
+
+int QualityMonitor::open(const AVCodecContext* enc_ctx) {
+    AVCodec* codec = avcodec_find_decoder(enc_ctx->codec_id);
+    if (!codec) {
+        std::cerr << "质量测量: 找不到对应的解码器" << std::endl;
+        return -1;
+    }
+
+    dec_ctx = avcodec_alloc_context3(codec);
+    AVCodecParameters* par = avcodec_parameters_alloc();
+    avcodec_parameters_from_context(par, enc_ctx);
+    avcodec_parameters_to_context(dec_ctx, par);
+    avcodec_parameters_free(&par);
+    dec_ctx->pkt_timebase = enc_ctx->time_base;
+    dec_ctx->time_base = enc_ctx->time_base;
+    // 校验解码只占一个线程，避免与编码争抢
+    dec_ctx->thread_count = 1;
+
+    if (avcodec_open2(dec_ctx, codec, nullptr) < 0) {
+        std::cerr << "质量测量: 无法打开解码器" << std::endl;
+        avcodec_free_context(&dec_ctx);
+        return -1;
+    }
+
+    std::cout << "质量测量: 每 " << sample_interval << " 帧抽样一帧计算 PSNR/SSIM" << std::endl;
+    return 0;
+}
+
+void QualityMonitor::add_reference(const AVFrame* frame) {
+    if (input_count++ % sample_interval != 0 || frame->pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    AVFrame* ref = av_frame_clone(frame);
+    if (!ref) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    AVFrame*& slot = references[frame->pts];
+    av_frame_free(&slot);
+    slot = ref;
+}
+
+void QualityMonitor::add_packet(const AVPacket* pkt) {
+    if (dec_ctx) {
+        packet_queue.push(av_packet_clone(pkt));
+    }
+}
+
+void QualityMonitor::finish() {
+    packet_queue.set_eof();
+}
+
+void QualityMonitor::measure(const AVFrame* reference, const AVFrame* decoded) {
+    if (reference->width != decoded->width || reference->height != decoded->height ||
+        reference->format != decoded->format || reference->format != AV_PIX_FMT_YUV420P) {
+        return;
+    }
+
+    int w = decoded->width, h = decoded->height;
+    int cw = AV_CEIL_RSHIFT(w, 1), ch = AV_CEIL_RSHIFT(h, 1);
+    uint64_t sse_y = plane_sse(reference->data[0], reference->linesize[0], decoded->data[0], decoded->linesize[0], w, h);
+    uint64_t sse_u = plane_sse(reference->data[1], reference->linesize[1], decoded->data[1], decoded->linesize[1], cw, ch);
+    uint64_t sse_v = plane_sse(reference->data[2], reference->linesize[2], decoded->data[2], decoded->linesize[2], cw, ch);
+    double ssim = plane_ssim(reference->data[0], reference->linesize[0], decoded->data[0], decoded->linesize[0], w, h);
+
+    samples++;
+    sum_psnr_y += psnr_from_sse(sse_y, (int64_t)w * h);
+    sum_psnr_u += psnr_from_sse(sse_u, (int64_t)cw * ch);
+    sum_psnr_v += psnr_from_sse(sse_v, (int64_t)cw * ch);
+    sum_ssim += ssim;
+    min_ssim = std::min(min_ssim, ssim);
+}
+
+void QualityMonitor::run() {
+    if (!dec_ctx) {
+        while (AVPacket* pkt = packet_queue.pop()) {
+            av_packet_free(&pkt);
+        }
+        return;
+    }
+
+    AVFrame* frame = av_frame_alloc();
+    auto receive_frames = [&]() {
+        while (avcodec_receive_frame(dec_ctx, frame) >= 0) {
+            int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+            AVFrame* reference = nullptr;
+            {
+                // 解码输出按显示顺序递增，更早的未配对输入帧已不可能再配对
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = references.begin();
+                while (it != references.end() && it->first < pts) {
+                    av_frame_free(&it->second);
+                    it = references.erase(it);
+                }
+                if (it != references.end() && it->first == pts) {
+                    reference = it->second;
+                    references.erase(it);
+                }
+            }
+            if (reference) {
+                measure(reference, frame);
+                av_frame_free(&reference);
+            }
+            av_frame_unref(frame);
+        }
+    };
+
+    while (AVPacket* pkt = packet_queue.pop()) {
+        avcodec_send_packet(dec_ctx, pkt);
+        av_packet_free(&pkt);
+        receive_frames();
+    }
+    avcodec_send_packet(dec_ctx, nullptr);
+    receive_frames();
+    av_frame_free(&frame);
+}
+
+void QualityMonitor::report(const std::string& name) const {
+    if (samples == 0) {
+        std::cout << "质量测量 [" << name << "]: 没有可比较的抽样帧" << std::endl;
+        return;
+    }
+    double y = sum_psnr_y / samples, u = sum_psnr_u / samples, v = sum_psnr_v / samples;
+    std::cout << "质量测量 [" << name << "]: 抽样 " << samples << " 帧"
+              << "，PSNR Y " << y << " U " << u << " V " << v
+              << " 平均 " << (4 * y + u + v) / 6
+              << "，SSIM 平均 " << sum_ssim / samples << " 最低 " << min_ssim << std::endl;
+}
@@ -0,0 +1,63 @@
+#ifndef QUALITY_MONITOR_H
+#define QUALITY_MONITOR_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "packet_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavcodec/avcodec.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+// 转码过程中的抽样质量测量：保留每第 N 个编码器输入帧的引用，
+// 在独立线程中解码编码器自己输出的包，与对应输入帧按 PTS 配对计算 PSNR 和 SSIM（SIMD）。
+// 对比的是编码器输入（滤波、缩放之后），因此度量的是编码损失。
+class QualityMonitor {
+public:
+    explicit QualityMonitor(int sample_interval) : sample_interval(sample_interval > 0 ? sample_interval : 1) {}
+    ~QualityMonitor();
+    QualityMonitor(const QualityMonitor&) = delete;
+    QualityMonitor& operator=(const QualityMonitor&) = delete;
+
+    // 按编码器参数打开校验用的解码器，须在编码器打开之后调用
+    int open(const AVCodecContext* enc_ctx);
+
+    // 编码线程调用：每个送入编码器的帧，按抽样间隔保留引用
+    void add_reference(const AVFrame* frame);
+    // 编码线程调用：每个编码输出的包
+    void add_packet(const AVPacket* pkt);
+    // 编码结束
+    void finish();
+
+    // 测量线程主体，处理完所有包后返回
+    void run();
+
+    // 打印汇总结果
+    void report(const std::string& name) const;
+
+private:
+    int sample_interval;
+    int64_t input_count = 0;
+    AVCodecContext* dec_ctx = nullptr;
+    PacketQueue packet_queue;
+
+    std::mutex mutex;
+    std::map<int64_t, AVFrame*> references;  // 按 PTS 索引的待比较输入帧
+
+    // 统计结果
+    int samples = 0;
+    double sum_psnr_y = 0, sum_psnr_u = 0, sum_psnr_v = 0;
+    double sum_ssim = 0;
+    double min_ssim = 1.0;
+
+    void measure(const AVFrame* reference, const AVFrame* decoded);
+};
+
+#endif
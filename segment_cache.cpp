@@ -0,0 +1,280 @@
+#include "segment_cache.h"
+#include "input_probe.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/hash.h"
+#include "libavutil/time.h"
+}
+
+// 缓存键格式版本，分段编码方式变化时递增使旧条目失效
+static const int CACHE_KEY_VERSION = 1;
+static const char* ENTRY_SUFFIX = ".seg";
+
+SegmentCache::SegmentCache(const SegmentCacheOptions& options) : options(options) {
+    if (mkdir(options.dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "无法创建分段缓存目录: " << options.dir << std::endl;
+    }
+}
+
+std::string SegmentCache::entry_path(const std::string& key) const {
+    return options.dir + "/" + key + ENTRY_SUFFIX;
+}
+
+// 输出格式由扩展名决定，编码器参数由输入流参数和预设推导，FFmpeg 版本不同时编码结果也可能不同
+std::string segment_encode_config(const JobOptions& opts) {
+    const std::string& output = opts.output;
+    size_t dot = output.find_last_of('.');
+    std::ostringstream config;
+    config << "version=" << CACHE_KEY_VERSION
+           << " lavc=" << LIBAVCODEC_IDENT << " lavf=" << LIBAVFORMAT_IDENT
+           << " format=" << (dot == std::string::npos ? "" : output.substr(dot))
+           << " speed=" << opts.speeds[0] << " wsola=" << opts.wsola_tempo
+           << " proxy=" << opts.proxy_width << "x" << opts.proxy_height
+           << " drop_static=" << opts.drop_static_frames << ":" << opts.static_threshold
+           << " loudness=" << opts.loudness.mode << ":" << opts.loudness.target << ":" << opts.loudness.peak_limit << ":" << opts.loudness.range
+           << " effort=" << opts.effort.target_speed << ":" << opts.effort.deadline << ":" << opts.effort.decision_gops
+           << " encoder_threads=" << opts.encoder_threads;
+    return config.str();
+}
+
+static void hash_value(AVHashContext* hash, int64_t value) {
+    av_hash_update(hash, (const uint8_t*)&value, sizeof(value));
+}
+
+static void hash_stream(AVHashContext* hash, const AVStream* st) {
+    const AVCodecParameters* par = st->codecpar;
+    hash_value(hash, par->codec_id);
+    hash_value(hash, par->format);
+    hash_value(hash, par->width);
+    hash_value(hash, par->height);
+    hash_value(hash, par->sample_rate);
+    hash_value(hash, par->channels);
+    hash_value(hash, par->bit_rate);
+    hash_value(hash, st->time_base.num);
+    hash_value(hash, st->time_base.den);
+    hash_value(hash, st->avg_frame_rate.num);
+    hash_value(hash, st->avg_frame_rate.den);
+    if (par->extradata_size > 0) {
+        av_hash_update(hash, par->extradata, par->extradata_size);
+    }
+}
+
+// 按 segment_demuxer 的规则取出区间内的数据包计入哈希：视频从不早于起点的第一个关键帧到终点处的关键帧，
+// 音频按时间戳截取。时间戳取相对区间首包的偏移，同样内容出现在不同位置时键相同
+static int hash_segment_packets(AVHashContext* hash, const std::string& input, const ProbeOptions& probe,
+                                const SegmentRange& range) {
+    AVFormatContext* fmt_ctx = nullptr;
+    if (open_input(input, probe, &fmt_ctx) < 0) {
+        return -1;
+    }
+    int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int audio_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (video_stream < 0) {
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+        if ((int)i != video_stream && (int)i != audio_stream) fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+    hash_stream(hash, fmt_ctx->streams[video_stream]);
+    if (audio_stream >= 0) {
+        hash_stream(hash, fmt_ctx->streams[audio_stream]);
+    }
+    if (range.start > 0 && avformat_seek_file(fmt_ctx, -1, INT64_MIN, range.start, range.start, 0) < 0) {
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    bool video_started = false;
+    bool video_done = false;
+    bool audio_done = audio_stream < 0;
+    int64_t base_time = AV_NOPTS_VALUE;
+    int64_t packets = 0;
+    int ret;
+    while ((ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+        if (ts != AV_NOPTS_VALUE) {
+            ts = av_rescale_q(ts, fmt_ctx->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+        }
+        bool take = false;
+        if (pkt->stream_index == video_stream) {
+            bool key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+            if (key && ts != AV_NOPTS_VALUE && ts >= range.end) video_done = true;
+            if (!video_started && key && ts != AV_NOPTS_VALUE && ts >= range.start) video_started = true;
+            take = video_started && !video_done;
+        } else if (pkt->stream_index == audio_stream && ts != AV_NOPTS_VALUE) {
+            if (ts >= range.end) audio_done = true;
+            else take = ts >= range.start;
+        }
+        if (take) {
+            if (base_time == AV_NOPTS_VALUE && ts != AV_NOPTS_VALUE) base_time = ts;
+            hash_value(hash, pkt->stream_index == video_stream ? 0 : 1);
+            hash_value(hash, ts == AV_NOPTS_VALUE || base_time == AV_NOPTS_VALUE ? AV_NOPTS_VALUE : ts - base_time);
+            hash_value(hash, pkt->duration);
+            hash_value(hash, pkt->flags & AV_PKT_FLAG_KEY);
+            hash_value(hash, pkt->size);
+            av_hash_update(hash, pkt->data, pkt->size);
+            packets++;
+        }
+        av_packet_unref(pkt);
+        if (video_done && audio_done) break;
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt_ctx);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        return -1;
+    }
+    return packets > 0 ? 0 : -1;
+}
+
+std::string SegmentCache::segment_key(const JobOptions& opts, const SegmentRange& range) {
+    int64_t start = av_gettime_relative();
+    AVHashContext* hash = nullptr;
+    if (av_hash_alloc(&hash, "SHA256") < 0) {
+        return "";
+    }
+    av_hash_init(hash);
+    std::string config = segment_encode_config(opts);
+    av_hash_update(hash, (const uint8_t*)config.data(), (int)config.size());
+
+    std::string key;
+    if (hash_segment_packets(hash, opts.inputs[0], opts.probe, range) == 0) {
+        char hex[2 * 32 + 1];
+        av_hash_final_hex(hash, (uint8_t*)hex, sizeof(hex));
+        key = hex;
+    } else {
+        std::cerr << "无法读取分段 #" << range.index << " 的输入数据，不使用缓存" << std::endl;
+    }
+    av_hash_freep(&hash);
+    key_time += (av_gettime_relative() - start) / 1000000.0;
+    return key;
+}
+
+// 复制文件内容，先写临时文件再改名
+static int copy_file(const std::string& from, const std::string& to) {
+    std::string tmp = to + ".tmp" + std::to_string(getpid());
+    {
+        std::ifstream in(from.c_str(), std::ios::binary);
+        std::ofstream out(tmp.c_str(), std::ios::binary);
+        if (!in || !out) {
+            unlink(tmp.c_str());
+            return -1;
+        }
+        out << in.rdbuf();
+        out.close();
+        if (!out) {
+            unlink(tmp.c_str());
+            return -1;
+        }
+    }
+    if (rename(tmp.c_str(), to.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+// 同一文件系统上用硬链接，避免复制整个分段
+static int link_or_copy(const std::string& from, const std::string& to) {
+    unlink(to.c_str());
+    if (link(from.c_str(), to.c_str()) == 0) {
+        return 0;
+    }
+    return copy_file(from, to);
+}
+
+bool SegmentCache::fetch(const std::string& key, const std::string& file) {
+    std::string entry = entry_path(key);
+    struct stat st;
+    if (key.empty() || stat(entry.c_str(), &st) < 0 || st.st_size == 0 || link_or_copy(entry, file) < 0) {
+        miss_count++;
+        return false;
+    }
+    // 修改时间作为最近使用时间，atime 在 noatime 挂载下不更新
+    utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+    hit_count++;
+    reused_bytes += st.st_size;
+    return true;
+}
+
+void SegmentCache::store(const std::string& key, const std::string& file) {
+    if (key.empty()) return;
+    std::string entry = entry_path(key);
+    // 先链接到临时名再改名，其他进程不会看到不完整的条目
+    std::string tmp = entry + ".tmp" + std::to_string(getpid());
+    unlink(tmp.c_str());
+    if (link(file.c_str(), tmp.c_str()) == 0) {
+        if (rename(tmp.c_str(), entry.c_str()) != 0) {
+            unlink(tmp.c_str());
+            return;
+        }
+    } else if (copy_file(file, entry) < 0) {
+        std::cerr << "无法写入分段缓存: " << entry << std::endl;
+        return;
+    }
+    utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+    store_count++;
+    evict();
+}
+
+void SegmentCache::evict() {
+    struct Entry {
+        std::string path;
+        int64_t size;
+        int64_t mtime_ns;
+    };
+    std::vector<Entry> entries;
+    int64_t total = 0;
+    DIR* dir = opendir(options.dir.c_str());
+    if (!dir) return;
+    size_t suffix_len = strlen(ENTRY_SUFFIX);
+    while (dirent* ent = readdir(dir)) {
+        std::string name = ent->d_name;
+        if (name.size() <= suffix_len || name.compare(name.size() - suffix_len, suffix_len, ENTRY_SUFFIX) != 0) continue;
+        Entry entry;
+        entry.path = options.dir + "/" + name;
+        struct stat st;
+        if (stat(entry.path.c_str(), &st) < 0) continue;
+        entry.size = st.st_size;
+        entry.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    closedir(dir);
+
+    int64_t budget = options.max_size_mb * 1024 * 1024;
+    if (total <= budget) return;
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.mtime_ns < b.mtime_ns; });
+    for (const Entry& entry : entries) {
+        if (total <= budget) break;
+        if (unlink(entry.path.c_str()) == 0) {
+            total -= entry.size;
+            evict_count++;
+        }
+    }
+}
+
+void SegmentCache::report() const {
+    int64_t lookups = hit_count + miss_count;
+    std::cout << "分段缓存: 命中 " << hit_count << "，未命中 " << miss_count;
+    if (lookups > 0) {
+        std::cout << "（命中率 " << 100.0 * hit_count / lookups << "%）";
+    }
+    std::cout << "，复用 " << reused_bytes / (1024.0 * 1024.0) << " MB，写入 " << store_count
+              << " 段，淘汰 " << evict_count << " 段，计算缓存键耗时 " << key_time << " 秒" << std::endl;
+}
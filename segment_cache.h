@@ -0,0 +1,44 @@
+#ifndef SEGMENT_CACHE_H
+#define SEGMENT_CACHE_H
+
+#include <string>
+#include "segment_plan.h"
+
+// 编码分段的内容寻址缓存：键为分段输入区间内音视频数据包字节（含流参数和相对时间戳）与
+// 全部影响输出的编码、滤波配置的 SHA-256，值为该段编码后的分段文件。同一素材以相同参数
+// 重复转码（重试、重新发布、部分重叠的剪辑）时，内容未变的分段直接复用，只编码变化的部分。
+//
+// 缓存目录可由多个进程共享（分段农场的工作进程），条目经临时文件改名写入。
+// 命中时刷新条目的修改时间，写入后按修改时间淘汰最久未用的条目，直到总大小不超过预算
+// 影响分段编码输出的全部配置，单行文本。缓存键和断点续转的检查点都据此判断已编码的分段能否沿用
+std::string segment_encode_config(const JobOptions& opts);
+
+class SegmentCache {
+public:
+    explicit SegmentCache(const SegmentCacheOptions& options);
+
+    // 读取分段的输入数据包计算缓存键，失败返回空串（该段不经过缓存）
+    std::string segment_key(const JobOptions& opts, const SegmentRange& range);
+    // 命中时把缓存的分段放到 file 并返回 true
+    bool fetch(const std::string& key, const std::string& file);
+    // 编码完成的分段加入缓存，并按容量预算淘汰
+    void store(const std::string& key, const std::string& file);
+
+    int64_t hits() const { return hit_count; }
+    // 打印命中、未命中、复用字节数和淘汰统计
+    void report() const;
+
+private:
+    SegmentCacheOptions options;
+    int64_t hit_count = 0;
+    int64_t miss_count = 0;
+    int64_t store_count = 0;
+    int64_t evict_count = 0;
+    int64_t reused_bytes = 0;
+    double key_time = 0;      // 计算缓存键的累计耗时（秒）
+
+    std::string entry_path(const std::string& key) const;
+    void evict();
+};
+
+#endif
@@ -0,0 +1,297 @@
+#include "segment_farm.h"
+#include "segment_plan.h"
+#include "segment_cache.h"
+#include "farm_transport.h"
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavutil/time.h"
+}
+
+enum SegmentState {
+    SEGMENT_PENDING,
+    SEGMENT_RUNNING,
+    SEGMENT_DONE
+};
+
+struct FarmSegment : SegmentRange {
+    SegmentState state = SEGMENT_PENDING;
+    int attempts = 0;
+    double wall_time = 0;
+    int64_t dispatch_time = 0;
+};
+
+struct FarmWorker {
+    int fd = -1;
+    std::string buffer;
+    std::string name;
+    int segment = -1;    // 正在处理的分段，-1 为空闲
+};
+
+static pid_t spawn_local_worker(int listen_fd, const std::vector<FarmWorker>& workers, const std::string& address,
+                                const JobOptions& opts) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "无法启动工作进程: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    if (pid == 0) {
+        // 子进程不持有协调进程的套接字
+        close(listen_fd);
+        for (const FarmWorker& worker : workers) close(worker.fd);
+        int ret = run_farm_worker(address, opts);
+        std::cout.flush();
+        _exit(ret == 0 ? 0 : 1);
+    }
+    return pid;
+}
+
+int run_farm_coordinator(const FarmOptions& farm, const JobOptions& opts) {
+    if (opts.speeds.size() > 1) {
+        std::cerr << "分段农场只支持单一速度，使用 " << opts.speeds[0] << std::endl;
+    }
+
+    std::vector<SegmentRange> ranges;
+    if (plan_segments(opts.inputs[0], opts.probe, farm.segment_duration, opts.output, ranges) < 0) {
+        return -1;
+    }
+    std::vector<FarmSegment> segments;
+    for (const SegmentRange& range : ranges) {
+        FarmSegment segment;
+        static_cast<SegmentRange&>(segment) = range;
+        segments.push_back(segment);
+    }
+    std::string dir = segment_dir(opts.output);
+
+    std::string address = farm.listen;
+    if (address.empty()) {
+        address = "unix:/tmp/videotranscode-farm-" + std::to_string(getpid()) + ".sock";
+    }
+    int listen_fd = farm_listen(address);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    std::cout << "分段农场: " << segments.size() << " 段，监听 " << address
+              << "，本机工作进程 " << farm.local_workers << " 个" << std::endl;
+
+    std::vector<FarmWorker> workers;
+    std::vector<pid_t> children;
+    // 本机工作进程异常退出后补充启动，总次数有上限，避免反复崩溃时无限 fork
+    int spawn_budget = farm.local_workers * (farm.retries + 2);
+    for (int i = 0; i < farm.local_workers && spawn_budget > 0; i++, spawn_budget--) {
+        pid_t pid = spawn_local_worker(listen_fd, workers, address, opts);
+        if (pid > 0) children.push_back(pid);
+    }
+
+    int64_t farm_start = av_gettime_relative();
+    size_t done = 0;
+    size_t cached = 0;
+    bool failed = false;
+    size_t next_pending = 0;
+
+    // 分段失败：未超过重试次数时放回待派发，否则整个作业失败
+    auto segment_failed = [&](int index, const std::string& reason) {
+        FarmSegment& segment = segments[index];
+        std::cerr << "分段 #" << index << " 失败（" << reason << "），已尝试 " << segment.attempts << " 次" << std::endl;
+        if (segment.attempts > farm.retries) {
+            failed = true;
+        } else {
+            segment.state = SEGMENT_PENDING;
+            next_pending = std::min(next_pending, (size_t)index);
+        }
+    };
+
+    while (done < segments.size() && !failed) {
+        // 回收退出的本机工作进程，仍有分段未完成时补充
+        for (size_t i = 0; i < children.size();) {
+            int status = 0;
+            if (waitpid(children[i], &status, WNOHANG) == children[i]) {
+                children.erase(children.begin() + i);
+                if (spawn_budget > 0) {
+                    spawn_budget--;
+                    pid_t pid = spawn_local_worker(listen_fd, workers, address, opts);
+                    if (pid > 0) children.push_back(pid);
+                }
+            } else {
+                i++;
+            }
+        }
+        if (farm.listen.empty() && children.empty() && workers.empty()) {
+            std::cerr << "没有可用的工作进程" << std::endl;
+            failed = true;
+            break;
+        }
+
+        // 按顺序把待派发的分段交给空闲的工作进程
+        for (FarmWorker& worker : workers) {
+            if (worker.segment >= 0) continue;
+            while (next_pending < segments.size() && segments[next_pending].state != SEGMENT_PENDING) next_pending++;
+            if (next_pending >= segments.size()) break;
+            FarmSegment& segment = segments[next_pending];
+            std::ostringstream message;
+            message << "SEGMENT " << segment.index << " " << segment.start << " " << segment.end << " " << segment.file;
+            if (farm_send_line(worker.fd, message.str()) < 0) {
+                continue; // 连接已断开，下面读取时清理
+            }
+            segment.state = SEGMENT_RUNNING;
+            segment.attempts++;
+            segment.dispatch_time = av_gettime_relative();
+            worker.segment = segment.index;
+        }
+
+        std::vector<pollfd> fds(workers.size() + 1);
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < workers.size(); i++) {
+            fds[i + 1].fd = workers[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        // 定时醒来回收子进程
+        if (poll(fds.data(), fds.size(), 500) < 0 && errno != EINTR) {
+            std::cerr << "poll 失败: " << strerror(errno) << std::endl;
+            failed = true;
+            break;
+        }
+
+        for (size_t i = workers.size(); i > 0; i--) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            FarmWorker& worker = workers[i - 1];
+            // 一次读到的数据可能包含多行（如 HELLO 和命中缓存的 DONE 同时到达），缓冲中的完整行须全部处理，
+            // 否则剩余的行要等连接再次可读，而工作进程正等待下一个分段
+            bool disconnected = false;
+            do {
+                std::string line;
+                if (farm_recv_line(worker.fd, worker.buffer, &line) < 0) {
+                    disconnected = true;
+                    break;
+                }
+
+                std::istringstream message(line);
+                std::string command, flag;
+                int index = -1;
+                message >> command >> index >> flag;
+                if (command == "HELLO") {
+                    worker.name = line.size() > 6 ? line.substr(6) : worker.name;
+                    std::cout << "工作进程已连接: " << worker.name << std::endl;
+                } else if ((command == "DONE" || command == "FAIL") && index == worker.segment) {
+                    FarmSegment& segment = segments[index];
+                    worker.segment = -1;
+                    if (command == "DONE") {
+                        segment.state = SEGMENT_DONE;
+                        segment.wall_time = (av_gettime_relative() - segment.dispatch_time) / 1000000.0;
+                        done++;
+                        if (flag == "CACHED") cached++;
+                        std::cout << "分段 #" << index << (flag == "CACHED" ? " 取自缓存（" : " 完成（") << worker.name << "，" << segment.wall_time << " 秒），进度 "
+                                  << done << "/" << segments.size() << std::endl;
+                    } else {
+                        segment_failed(index, worker.name + " 转码失败");
+                    }
+                } else {
+                    std::cerr << "无法识别的工作进程消息: " << line << std::endl;
+                }
+            } while (worker.buffer.find('\n') != std::string::npos);
+
+            if (disconnected) {
+                std::cerr << "工作进程断开: " << worker.name << std::endl;
+                if (worker.segment >= 0) {
+                    segment_failed(worker.segment, "工作进程断开");
+                }
+                close(worker.fd);
+                workers.erase(workers.begin() + (i - 1));
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                FarmWorker worker;
+                worker.fd = fd;
+                worker.name = "fd" + std::to_string(fd);
+                workers.push_back(worker);
+            }
+        }
+    }
+
+    for (FarmWorker& worker : workers) {
+        farm_send_line(worker.fd, "EXIT");
+        close(worker.fd);
+    }
+    farm_close_listener(listen_fd, address);
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+
+    double encode_time = (av_gettime_relative() - farm_start) / 1000000.0;
+    if (failed) {
+        std::cerr << "分段农场失败，已完成 " << done << "/" << segments.size() << " 段，分段文件保留在 " << dir << std::endl;
+        return -1;
+    }
+    std::cout << "全部 " << segments.size() << " 段编码完成，其中 " << cached << " 段取自缓存，耗时 " << encode_time << " 秒，开始拼接" << std::endl;
+
+    if (stitch_segments(ranges, opts.output) < 0) {
+        std::cerr << "拼接分段失败，分段文件保留在 " << dir << std::endl;
+        return -1;
+    }
+    remove_segments(ranges, opts.output);
+    std::cout << "分段农场完成: " << opts.output << "，总耗时 " << (av_gettime_relative() - farm_start) / 1000000.0 << " 秒" << std::endl;
+    return 0;
+}
+
+int run_farm_worker(const std::string& address, const JobOptions& opts) {
+    int fd = farm_connect(address, 10000);
+    if (fd < 0) {
+        return -1;
+    }
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    farm_send_line(fd, "HELLO " + std::string(host) + ":" + std::to_string(getpid()));
+
+    std::unique_ptr<SegmentCache> cache;
+    if (!opts.segment_cache.dir.empty()) {
+        cache.reset(new SegmentCache(opts.segment_cache));
+    }
+
+    std::string buffer, line;
+    int ret = 0;
+    while (farm_recv_line(fd, buffer, &line) == 0) {
+        std::istringstream message(line);
+        std::string command;
+        message >> command;
+        if (command == "EXIT") {
+            break;
+        }
+        if (command != "SEGMENT") {
+            std::cerr << "无法识别的协调进程消息: " << line << std::endl;
+            continue;
+        }
+
+        SegmentRange range;
+        message >> range.index >> range.start >> range.end;
+        std::getline(message >> std::ws, range.file);
+        int64_t hits = cache ? cache->hits() : 0;
+        int result = transcode_segment(opts, range, cache.get());
+        std::string reply = (result == 0 ? "DONE " : "FAIL ") + std::to_string(range.index);
+        if (result == 0 && cache && cache->hits() > hits) {
+            reply += " CACHED";
+        }
+        if (farm_send_line(fd, reply) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+    close(fd);
+    if (cache) cache->report();
+    return ret;
+}
@@ -0,0 +1,25 @@
+#ifndef SEGMENT_FARM_H
+#define SEGMENT_FARM_H
+
+#include "job_options.h"
+
+// 分段农场：一个长输入由多个工作进程并行编码。
+// 协调进程扫描视频关键帧，按 farm.segment_duration 在关键帧处切分，分段编号和时间区间通过
+// farm_transport.h 的连接逐个派发给空闲的工作进程；工作进程按区间转码到各自的分段文件后回报结果，
+// 失败或连接断开的分段重新派发，超过 farm.retries 次则整个作业失败。全部完成后按顺序拼接、
+// 复用为 opts.output，并删除分段文件。
+//
+// 协议（每行一条消息）：
+//   工作进程 -> 协调进程  HELLO <名称>          连接后发送
+//                         DONE <编号> [CACHED] / FAIL <编号>    CACHED 表示分段取自分段缓存
+//   协调进程 -> 工作进程  SEGMENT <编号> <起点微秒> <终点微秒> <分段文件>
+//                         EXIT
+//
+// 本机工作进程由协调进程 fork 启动；其他机器上的工作进程用相同参数加 --farm-worker 地址启动，
+// 分段文件路径须在共享存储上可见。成功返回 0
+int run_farm_coordinator(const FarmOptions& farm, const JobOptions& opts);
+
+// 工作模式：连接协调进程，循环领取分段并转码，收到 EXIT 或连接断开时返回
+int run_farm_worker(const std::string& address, const JobOptions& opts);
+
+#endif
@@ -0,0 +1,217 @@
+#include "segment_plan.h"
+#include "segment_cache.h"
+#include "transcode_job.h"
+#include "input_probe.h"
+#include "demuxer.h"
+#include "muxer.h"
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include "libavformat/avformat.h"
+}
+
+// 扫描输入的视频关键帧时间（AV_TIME_BASE），换算方式与 segment_demuxer 一致，保证切点精确对应
+static int scan_keyframes(const std::string& path, const ProbeOptions& probe, std::vector<int64_t>* keyframes) {
+    AVFormatContext* fmt_ctx = nullptr;
+    if (open_input(path, probe, &fmt_ctx) < 0) {
+        return -1;
+    }
+    int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (video_stream < 0) {
+        std::cerr << "找不到视频流" << std::endl;
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+    for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+        if ((int)i != video_stream) fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    AVRational time_base = fmt_ctx->streams[video_stream]->time_base;
+    AVPacket* pkt = av_packet_alloc();
+    while (av_read_frame(fmt_ctx, pkt) >= 0) {
+        if (pkt->stream_index == video_stream && (pkt->flags & AV_PKT_FLAG_KEY)) {
+            int64_t ts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                keyframes->push_back(av_rescale_q(ts, time_base, AV_TIME_BASE_Q));
+            }
+        }
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt_ctx);
+
+    std::sort(keyframes->begin(), keyframes->end());
+    keyframes->erase(std::unique(keyframes->begin(), keyframes->end()), keyframes->end());
+    return keyframes->empty() ? -1 : 0;
+}
+
+std::string segment_dir(const std::string& output) {
+    return output + ".segments";
+}
+
+static std::string segment_file(const std::string& dir, int index, const std::string& output) {
+    size_t dot = output.find_last_of('.');
+    size_t slash = output.find_last_of('/');
+    std::string ext = dot == std::string::npos || (slash != std::string::npos && dot < slash) ? ".mp4" : output.substr(dot);
+    char name[32];
+    snprintf(name, sizeof(name), "/segment_%05d", index);
+    return dir + name + ext;
+}
+
+// 在目标时长之后的第一个关键帧处切分
+static void split_segments(const std::vector<int64_t>& keyframes, double segment_duration, const std::string& dir,
+                           const std::string& output, std::vector<SegmentRange>& segments) {
+    int64_t step = (int64_t)(segment_duration * AV_TIME_BASE);
+    std::vector<int64_t> cuts;
+    int64_t next_cut = keyframes[0] + step;
+    for (int64_t keyframe : keyframes) {
+        if (keyframe >= next_cut) {
+            cuts.push_back(keyframe);
+            next_cut = keyframe + step;
+        }
+    }
+
+    for (size_t i = 0; i <= cuts.size(); i++) {
+        SegmentRange segment;
+        segment.index = (int)i;
+        // 首段包含第一个关键帧之前的音频，末段读到文件结束
+        segment.start = i == 0 ? INT64_MIN : cuts[i - 1];
+        segment.end = i < cuts.size() ? cuts[i] : INT64_MAX;
+        segment.file = segment_file(dir, (int)i, output);
+        segments.push_back(segment);
+    }
+}
+
+int stitch_segments(const std::vector<SegmentRange>& segments, const std::string& output) {
+    std::vector<std::string> files;
+    for (const SegmentRange& segment : segments) {
+        files.push_back(segment.file);
+    }
+
+    // 分段是临时文件，不写探测缓存
+    ProbeOptions probe;
+    AVFormatContext* in_ctx = nullptr;
+    if (open_input(files[0], probe, &in_ctx) < 0) {
+        return -1;
+    }
+    int video_stream = av_find_best_stream(in_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int audio_stream = av_find_best_stream(in_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (video_stream < 0) {
+        std::cerr << "分段文件中没有视频流: " << files[0] << std::endl;
+        avformat_close_input(&in_ctx);
+        return -1;
+    }
+
+    AVFormatContext* out_fmt = nullptr;
+    int ret = avformat_alloc_output_context2(&out_fmt, nullptr, nullptr, output.c_str());
+    if (ret < 0 || !out_fmt) {
+        std::cerr << "无法创建输出上下文: " << output << std::endl;
+        avformat_close_input(&in_ctx);
+        return -1;
+    }
+
+    // 复用线程约定视频为 0 号流、音频为 1 号流，时间戳沿用分段文件的时间基准
+    int in_streams[2] = { video_stream, audio_stream };
+    for (int i = 0; i < 2 && in_streams[i] >= 0; i++) {
+        AVStream* in_st = in_ctx->streams[in_streams[i]];
+        AVStream* out_st = avformat_new_stream(out_fmt, nullptr);
+        avcodec_parameters_copy(out_st->codecpar, in_st->codecpar);
+        out_st->codecpar->codec_tag = 0;
+        out_st->time_base = in_st->time_base;
+    }
+
+    if (!(out_fmt->oformat->flags & AVFMT_NOFILE) && avio_open(&out_fmt->pb, output.c_str(), AVIO_FLAG_WRITE) < 0) {
+        std::cerr << "无法打开输出文件: " << output << std::endl;
+        avformat_free_context(out_fmt);
+        avformat_close_input(&in_ctx);
+        return -1;
+    }
+
+    // 拼接和复用的错误通过令牌带回，任一段缺失或写入失败都不能当作成功
+    CancelToken cancel_token;
+    PacketQueue video_queue, audio_queue;
+    video_queue.attach(&cancel_token);
+    audio_queue.attach(&cancel_token);
+    std::thread concat_thread(concat_demuxer, in_ctx, std::cref(files), std::cref(probe), std::ref(video_queue), std::ref(audio_queue), video_stream, audio_stream);
+    std::thread mux_thread(muxer, out_fmt, std::ref(video_queue), std::ref(audio_queue), nullptr);
+    concat_thread.join();
+    mux_thread.join();
+
+    avformat_close_input(&in_ctx);
+    if (out_fmt->pb) avio_closep(&out_fmt->pb);
+    avformat_free_context(out_fmt);
+    if (cancel_token.cancelled()) {
+        std::cerr << "拼接失败: " << cancel_token.stage() << " 出错，删除不完整的输出 " << output << std::endl;
+        unlink(output.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+int plan_segments(const std::string& input, const ProbeOptions& probe, double segment_duration, const std::string& output,
+                  std::vector<SegmentRange>& segments) {
+    std::vector<int64_t> keyframes;
+    if (scan_keyframes(input, probe, &keyframes) < 0) {
+        std::cerr << "无法扫描关键帧: " << input << std::endl;
+        return -1;
+    }
+    std::string dir = segment_dir(output);
+    if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        std::cerr << "无法创建分段目录: " << dir << std::endl;
+        return -1;
+    }
+    split_segments(keyframes, segment_duration, dir, output, segments);
+    std::cout << "按关键帧切分: " << keyframes.size() << " 个关键帧，" << segments.size() << " 段" << std::endl;
+    return 0;
+}
+
+int transcode_segment(const JobOptions& opts, const SegmentRange& range, SegmentCache* cache) {
+    std::string key;
+    if (cache) {
+        key = cache->segment_key(opts, range);
+        if (cache->fetch(key, range.file)) {
+            std::cout << "分段 #" << range.index << " 命中缓存" << std::endl;
+            return 0;
+        }
+        // 分段文件可能是缓存条目的硬链接，先删除再写，不能原地截断
+        unlink(range.file.c_str());
+    }
+
+    JobOptions job = opts;
+    job.range_start = range.start;
+    job.range_end = range.end;
+    job.output = range.file;
+    job.speeds.assign(1, opts.speeds[0]);
+    job.inputs.resize(1);
+    job.pcm_output.clear();
+    job.peaks_output.clear();
+    job.raw_video_output.clear();
+    job.farm = FarmOptions();
+    job.checkpoint_interval = 0;
+    // 启动耗时只对整个作业有意义，不按分段打印
+    job.start_time = 0;
+
+    int result = run_transcode_job(job);
+    struct stat st;
+    if (result == 0 && (stat(job.output.c_str(), &st) < 0 || st.st_size == 0)) {
+        result = -1;
+    }
+    if (result == 0 && cache) {
+        cache->store(key, range.file);
+    }
+    return result;
+}
+
+void remove_segments(const std::vector<SegmentRange>& segments, const std::string& output) {
+    for (const SegmentRange& segment : segments) {
+        unlink(segment.file.c_str());
+    }
+    rmdir(segment_dir(output).c_str());
+}
@@ -0,0 +1,37 @@
+#ifndef SEGMENT_PLAN_H
+#define SEGMENT_PLAN_H
+
+#include <string>
+#include <vector>
+#include "job_options.h"
+
+// 按视频关键帧切分的一段输入，分段农场和断点续转共用。各段独立编码到自己的文件，
+// 可以单独解码，最后按顺序拼接
+struct SegmentRange {
+    int index = 0;
+    int64_t start = 0;   // AV_TIME_BASE，首段为 INT64_MIN
+    int64_t end = 0;     // 末段为 INT64_MAX
+    std::string file;    // 分段输出文件
+};
+
+// 分段文件所在目录：输出文件名加 .segments
+std::string segment_dir(const std::string& output);
+
+// 扫描输入的视频关键帧，在每隔 segment_duration 秒之后的第一个关键帧处切分，并创建分段目录。失败返回 -1
+int plan_segments(const std::string& input, const ProbeOptions& probe, double segment_duration, const std::string& output,
+                  std::vector<SegmentRange>& segments);
+
+class SegmentCache;
+
+// 把一段转码到 range.file：只用第一个速度，不输出 PCM、峰值、原始视频等旁路文件。
+// 给出 cache 时先查缓存，命中则直接取用缓存的分段，否则编码后写入缓存。成功返回 0
+int transcode_segment(const JobOptions& opts, const SegmentRange& range, SegmentCache* cache = nullptr);
+
+// 分段文件按顺序拼接并复用为 output，编码数据直接复制，时间戳按已拼接部分的时长偏移。成功返回 0；
+// 任一分段无法读取或写入失败时删除不完整的输出并返回 -1，调用方据此保留分段文件
+int stitch_segments(const std::vector<SegmentRange>& segments, const std::string& output);
+
+// 删除分段文件和分段目录
+void remove_segments(const std::vector<SegmentRange>& segments, const std::string& output);
+
+#endif
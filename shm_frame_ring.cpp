@@ -0,0 +1,479 @@
+#include "shm_frame_ring.h"
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+static const uint32_t RING_MAGIC = 0x46524e47;  // "FRNG"
+// 平面起始地址和行宽的对齐，与 frame_pool 一致
+static const int FRAME_ALIGN = 64;
+// 等待对端时的检查间隔
+static const int WAIT_INTERVAL_MS = 100;
+
+// 一条帧描述：帧槽编号、各平面在帧槽内的偏移和行宽，以及编码和显示需要的帧属性
+struct ShmFrameEntry {
+    int32_t slot;
+    int32_t format, width, height;
+    int32_t linesize[4];
+    uint32_t offset[4];
+    int64_t pts, pkt_dts, best_effort_timestamp, pkt_duration;
+    int32_t key_frame, pict_type, repeat_pict, interlaced_frame, top_field_first;
+    int32_t sar_num, sar_den;
+    int32_t color_range, color_primaries, color_trc, colorspace, chroma_location;
+};
+
+// 共享内存头部，其后依次为帧描述队列、帧槽引用计数和按页对齐的帧槽数据
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t slot_count;
+    uint32_t entry_count;
+    uint64_t slot_size;
+    uint64_t data_offset;
+
+    // futex 等待字：write_seq 在每次 push 和 set_eof 时递增，release_seq 在每次 pop 和帧槽释放时递增
+    std::atomic<uint32_t> write_seq;
+    std::atomic<uint32_t> release_seq;
+    std::atomic<uint32_t> write_pos;
+    std::atomic<uint32_t> read_pos;
+    std::atomic<uint32_t> eof;
+    std::atomic<int32_t> producer_pid;
+    std::atomic<int32_t> consumer_pid;
+};
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex 要求 32 位等待字");
+
+static size_t entries_offset() {
+    return FFALIGN(sizeof(ShmRingHeader), 64);
+}
+
+static ShmFrameEntry* ring_entries(ShmRingHeader* header) {
+    return reinterpret_cast<ShmFrameEntry*>(reinterpret_cast<uint8_t*>(header) + entries_offset());
+}
+
+static std::atomic<int32_t>* slot_refs(ShmRingHeader* header) {
+    return reinterpret_cast<std::atomic<int32_t>*>(ring_entries(header) + header->entry_count);
+}
+
+static void futex_wait(std::atomic<uint32_t>* word, uint32_t expected) {
+    timespec timeout = { 0, WAIT_INTERVAL_MS * 1000000L };
+    // 共享映射上的 futex 不能用 FUTEX_PRIVATE_FLAG
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// 一帧在帧槽内的布局：各平面依次存放，行宽和起始地址按 FRAME_ALIGN 对齐，末尾留出 SIMD 越界读取的填充
+static int frame_layout(int format, int width, int height, int linesize[4], uint32_t offset[4], size_t* size) {
+    AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+    int linesizes[4];
+    if (!desc || av_image_fill_linesizes(linesizes, pix_fmt, width) < 0) {
+        return -1;
+    }
+
+    size_t total = 0;
+    int nb_planes = av_pix_fmt_count_planes(pix_fmt);
+    for (int i = 0; i < 4; i++) {
+        linesize[i] = 0;
+        offset[i] = 0;
+        if (i >= nb_planes) continue;
+        linesize[i] = FFALIGN(linesizes[i], FRAME_ALIGN);
+        int rows = i == 1 || i == 2 ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+        offset[i] = (uint32_t)total;
+        total += FFALIGN((size_t)linesize[i] * rows + AV_INPUT_BUFFER_PADDING_SIZE, FRAME_ALIGN);
+    }
+    *size = total;
+    return 0;
+}
+
+ShmFrameRing* ShmFrameRing::create(int slots, size_t slot_size) {
+    if (slots <= 0 || slot_size == 0) {
+        return nullptr;
+    }
+    int fd = memfd_create("frame-ring", MFD_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "无法创建共享内存: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    uint32_t entry_count = slots * 2;
+    size_t page = sysconf(_SC_PAGESIZE);
+    slot_size = FFALIGN(slot_size, page);
+    size_t data_offset = FFALIGN(entries_offset() + entry_count * sizeof(ShmFrameEntry) + slots * sizeof(std::atomic<int32_t>), page);
+    size_t total = data_offset + slot_size * slots;
+    if (ftruncate(fd, total) < 0) {
+        std::cerr << "无法分配共享内存: " << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+
+    ShmFrameRing* ring = new ShmFrameRing;
+    // ftruncate 得到的内存已清零，原子变量的初始值即为 0
+    if (ring->map(fd, total) < 0) {
+        delete ring;
+        return nullptr;
+    }
+    ShmRingHeader* header = ring->header;
+    header->slot_count = slots;
+    header->entry_count = entry_count;
+    header->slot_size = slot_size;
+    header->data_offset = data_offset;
+    header->magic = RING_MAGIC;
+    ring->slot_data = ring->base + data_offset;
+    ring->slot_contexts.resize(slots);
+    for (int i = 0; i < slots; i++) {
+        ring->slot_contexts[i] = { ring, i };
+    }
+
+    std::cout << "共享内存帧环: " << slots << " 个帧槽，每槽 " << (slot_size >> 10) << " KB" << std::endl;
+    return ring;
+}
+
+ShmFrameRing* ShmFrameRing::attach(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmRingHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    ShmFrameRing* ring = new ShmFrameRing;
+    if (ring->map(fd, st.st_size) < 0) {
+        delete ring;
+        return nullptr;
+    }
+    if (ring->header->magic != RING_MAGIC) {
+        std::cerr << "不是共享内存帧环" << std::endl;
+        delete ring;
+        return nullptr;
+    }
+    ring->slot_data = ring->base + ring->header->data_offset;
+    ring->slot_contexts.resize(ring->header->slot_count);
+    for (uint32_t i = 0; i < ring->header->slot_count; i++) {
+        ring->slot_contexts[i] = { ring, (int)i };
+    }
+    return ring;
+}
+
+int ShmFrameRing::map(int fd, size_t size) {
+    memfd = fd;
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "无法映射共享内存: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    base = static_cast<uint8_t*>(data);
+    mapped_size = size;
+    header = reinterpret_cast<ShmRingHeader*>(base);
+    return 0;
+}
+
+ShmFrameRing::~ShmFrameRing() {
+    if (base) munmap(base, mapped_size);
+    if (memfd >= 0) close(memfd);
+}
+
+size_t ShmFrameRing::slot_size_for(AVCodecContext* dec_ctx) {
+    int width = dec_ctx->width;
+    int height = dec_ctx->height;
+    int stride_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(dec_ctx, &width, &height, stride_align);
+
+    int format = dec_ctx->pix_fmt != AV_PIX_FMT_NONE ? dec_ctx->pix_fmt : AV_PIX_FMT_YUV420P;
+    int linesize[4];
+    uint32_t offset[4];
+    size_t size = 0;
+    if (frame_layout(format, width, height, linesize, offset, &size) < 0) {
+        return 0;
+    }
+    return size;
+}
+
+void ShmFrameRing::bind_producer(pid_t pid) {
+    header->producer_pid = pid > 0 ? pid : getpid();
+}
+
+void ShmFrameRing::bind_consumer(pid_t pid) {
+    header->consumer_pid = pid > 0 ? pid : getpid();
+}
+
+// 对端进程是否仍在运行。对端是本进程的子进程时不回收僵尸进程，只查看状态
+bool ShmFrameRing::peer_alive(bool producer_side) const {
+    pid_t pid = producer_side ? header->consumer_pid.load() : header->producer_pid.load();
+    if (pid <= 0) {
+        return true;
+    }
+    siginfo_t info;
+    memset(&info, 0, sizeof(info));
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0) {
+        return info.si_pid != pid;
+    }
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+int ShmFrameRing::slot_of(const uint8_t* data) const {
+    if (data < slot_data || data >= base + mapped_size) {
+        return -1;
+    }
+    return (int)((data - slot_data) / header->slot_size);
+}
+
+int ShmFrameRing::acquire_slot(bool wait) {
+    std::atomic<int32_t>* refs = slot_refs(header);
+    int count = header->slot_count;
+    for (;;) {
+        uint32_t seq = header->release_seq.load(std::memory_order_acquire);
+        int start = next_slot.load(std::memory_order_relaxed);
+        for (int k = 0; k < count; k++) {
+            int slot = (start + k) % count;
+            int32_t expected = 0;
+            if (refs[slot].compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+                next_slot.store(slot + 1, std::memory_order_relaxed);
+                return slot;
+            }
+        }
+        if (!wait || !peer_alive(true)) {
+            return -1;
+        }
+        futex_wait(&header->release_seq, seq);
+    }
+}
+
+void ShmFrameRing::release_slot(int slot) {
+    if (slot_refs(header)[slot].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        header->release_seq.fetch_add(1, std::memory_order_release);
+        futex_wake(&header->release_seq);
+    }
+}
+
+void ShmFrameRing::free_slot_buffer(void* opaque, uint8_t* /*data*/) {
+    SlotContext* context = static_cast<SlotContext*>(opaque);
+    context->ring->release_slot(context->slot);
+}
+
+int ShmFrameRing::get_buffer(AVCodecContext* s, AVFrame* frame, int flags) {
+    ShmFrameRing* ring = static_cast<ShmFrameRing*>(s->opaque);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    if (!ring || !(s->codec->capabilities & AV_CODEC_CAP_DR1) || !desc ||
+        (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+        return avcodec_default_get_buffer2(s, frame, flags);
+    }
+
+    // 解码器可能写出超出可见区域的宏块，按其要求对齐尺寸
+    int width = frame->width;
+    int height = frame->height;
+    int stride_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(s, &width, &height, stride_align);
+
+    int linesize[4];
+    uint32_t offset[4];
+    size_t size = 0;
+    if (frame_layout(frame->format, width, height, linesize, offset, &size) < 0 || size > ring->header->slot_size) {
+        return avcodec_default_get_buffer2(s, frame, flags);
+    }
+    // 不等待：帧槽都被占用时（解码器参考帧加队列中的帧超过帧槽数）这一帧走普通内存，push 时复制
+    int slot = ring->acquire_slot(false);
+    if (slot < 0) {
+        return avcodec_default_get_buffer2(s, frame, flags);
+    }
+
+    uint8_t* data = ring->slot_data + (size_t)slot * ring->header->slot_size;
+    frame->buf[0] = av_buffer_create(data, (int)ring->header->slot_size, free_slot_buffer, &ring->slot_contexts[slot], 0);
+    if (!frame->buf[0]) {
+        ring->release_slot(slot);
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < 4; i++) {
+        frame->data[i] = linesize[i] > 0 ? data + offset[i] : nullptr;
+        frame->linesize[i] = linesize[i];
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+void ShmFrameRing::install_decoder(AVCodecContext* dec_ctx) {
+    dec_ctx->opaque = this;
+    dec_ctx->get_buffer2 = get_buffer;
+#if FF_API_THREAD_SAFE_CALLBACKS
+    dec_ctx->thread_safe_callbacks = 1;
+#endif
+}
+
+int ShmFrameRing::push(const AVFrame* frame) {
+    // 等待队列中有空位
+    for (;;) {
+        uint32_t seq = header->release_seq.load(std::memory_order_acquire);
+        uint32_t write = header->write_pos.load(std::memory_order_relaxed);
+        if (write - header->read_pos.load(std::memory_order_acquire) < header->entry_count) break;
+        if (!peer_alive(true)) return -1;
+        futex_wait(&header->release_seq, seq);
+    }
+
+    ShmFrameEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    int slot = frame->buf[0] ? slot_of(frame->buf[0]->data) : -1;
+    if (slot >= 0) {
+        // 帧已在共享内存中，增加一个引用交给消费者
+        slot_refs(header)[slot].fetch_add(1, std::memory_order_relaxed);
+        uint8_t* slot_base = slot_data + (size_t)slot * header->slot_size;
+        for (int i = 0; i < 4; i++) {
+            entry.linesize[i] = frame->data[i] ? frame->linesize[i] : 0;
+            entry.offset[i] = frame->data[i] ? (uint32_t)(frame->data[i] - slot_base) : 0;
+        }
+    } else {
+        size_t size = 0;
+        if (frame_layout(frame->format, frame->width, frame->height, entry.linesize, entry.offset, &size) < 0 ||
+            size > header->slot_size) {
+            std::cerr << "帧大小超出共享内存帧槽: " << frame->width << "x" << frame->height << std::endl;
+            return -1;
+        }
+        slot = acquire_slot(true);
+        if (slot < 0) {
+            return -1;
+        }
+        uint8_t* slot_base = slot_data + (size_t)slot * header->slot_size;
+        uint8_t* dst[4];
+        for (int i = 0; i < 4; i++) {
+            dst[i] = slot_base + entry.offset[i];
+        }
+        av_image_copy(dst, entry.linesize, const_cast<const uint8_t**>(frame->data), frame->linesize,
+                      static_cast<AVPixelFormat>(frame->format), frame->width, frame->height);
+    }
+
+    entry.slot = slot;
+    entry.format = frame->format;
+    entry.width = frame->width;
+    entry.height = frame->height;
+    entry.pts = frame->pts;
+    entry.pkt_dts = frame->pkt_dts;
+    entry.best_effort_timestamp = frame->best_effort_timestamp;
+    entry.pkt_duration = frame->pkt_duration;
+    entry.key_frame = frame->key_frame;
+    entry.pict_type = frame->pict_type;
+    entry.repeat_pict = frame->repeat_pict;
+    entry.interlaced_frame = frame->interlaced_frame;
+    entry.top_field_first = frame->top_field_first;
+    entry.sar_num = frame->sample_aspect_ratio.num;
+    entry.sar_den = frame->sample_aspect_ratio.den;
+    entry.color_range = frame->color_range;
+    entry.color_primaries = frame->color_primaries;
+    entry.color_trc = frame->color_trc;
+    entry.colorspace = frame->colorspace;
+    entry.chroma_location = frame->chroma_location;
+
+    uint32_t write = header->write_pos.load(std::memory_order_relaxed);
+    ring_entries(header)[write % header->entry_count] = entry;
+    header->write_pos.store(write + 1, std::memory_order_release);
+    header->write_seq.fetch_add(1, std::memory_order_release);
+    futex_wake(&header->write_seq);
+    return 0;
+}
+
+AVFrame* ShmFrameRing::pop() {
+    for (;;) {
+        uint32_t seq = header->write_seq.load(std::memory_order_acquire);
+        uint32_t read = header->read_pos.load(std::memory_order_relaxed);
+        if (read != header->write_pos.load(std::memory_order_acquire)) {
+            const ShmFrameEntry& entry = ring_entries(header)[read % header->entry_count];
+            AVFrame* frame = av_frame_alloc();
+            uint8_t* slot_base = slot_data + (size_t)entry.slot * header->slot_size;
+            // 帧直接引用共享内存，释放最后一个引用时归还帧槽
+            frame->buf[0] = av_buffer_create(slot_base, (int)header->slot_size, free_slot_buffer, &slot_contexts[entry.slot], 0);
+            for (int i = 0; i < 4; i++) {
+                frame->data[i] = entry.linesize[i] > 0 ? slot_base + entry.offset[i] : nullptr;
+                frame->linesize[i] = entry.linesize[i];
+            }
+            frame->extended_data = frame->data;
+            frame->format = entry.format;
+            frame->width = entry.width;
+            frame->height = entry.height;
+            frame->pts = entry.pts;
+            frame->pkt_dts = entry.pkt_dts;
+            frame->best_effort_timestamp = entry.best_effort_timestamp;
+            frame->pkt_duration = entry.pkt_duration;
+            frame->key_frame = entry.key_frame;
+            frame->pict_type = static_cast<AVPictureType>(entry.pict_type);
+            frame->repeat_pict = entry.repeat_pict;
+            frame->interlaced_frame = entry.interlaced_frame;
+            frame->top_field_first = entry.top_field_first;
+            frame->sample_aspect_ratio = (AVRational){ entry.sar_num, entry.sar_den };
+            frame->color_range = static_cast<AVColorRange>(entry.color_range);
+            frame->color_primaries = static_cast<AVColorPrimaries>(entry.color_primaries);
+            frame->color_trc = static_cast<AVColorTransferCharacteristic>(entry.color_trc);
+            frame->colorspace = static_cast<AVColorSpace>(entry.colorspace);
+            frame->chroma_location = static_cast<AVChromaLocation>(entry.chroma_location);
+
+            header->read_pos.store(read + 1, std::memory_order_release);
+            header->release_seq.fetch_add(1, std::memory_order_release);
+            futex_wake(&header->release_seq);
+            return frame;
+        }
+        if (header->eof.load(std::memory_order_acquire) || !peer_alive(false)) {
+            return nullptr;
+        }
+        futex_wait(&header->write_seq, seq);
+    }
+}
+
+void ShmFrameRing::set_eof() {
+    header->eof.store(1, std::memory_order_release);
+    header->write_seq.fetch_add(1, std::memory_order_release);
+    futex_wake(&header->write_seq);
+}
+
+int ShmFrameRing::size() const {
+    return (int)(header->write_pos.load() - header->read_pos.load());
+}
+
+pid_t spawn_frame_stage(ShmFrameRing* ring, const std::function<void(FrameQueue&)>& stage) {
+    ring->bind_producer();
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "无法启动帧处理子进程: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    if (pid == 0) {
+        ring->bind_consumer();
+        FrameQueue queue;
+        std::thread pump([&]() {
+            while (AVFrame* frame = ring->pop()) {
+                queue.push(frame);
+            }
+            queue.set_eof();
+        });
+        stage(queue);
+        pump.join();
+        std::cout.flush();
+        _exit(0);
+    }
+    // 子进程登记之前父进程就可能开始等待，先写入子进程的 pid
+    ring->bind_consumer(pid);
+    return pid;
+}
+
+void forward_to_ring(FrameQueue& input, ShmFrameRing* ring) {
+    bool forwarding = true;
+    while (AVFrame* frame = input.pop()) {
+        if (forwarding && ring->push(frame) < 0) {
+            std::cerr << "帧处理子进程已退出或无法接收帧，丢弃剩余帧" << std::endl;
+            forwarding = false;
+        }
+        av_frame_free(&frame);
+    }
+    ring->set_eof();
+}
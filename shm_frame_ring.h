@@ -0,0 +1,94 @@
+#ifndef SHM_FRAME_RING_H
+#define SHM_FRAME_RING_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <sys/types.h>
+#include "frame_queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libavcodec/avcodec.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+struct ShmRingHeader;
+
+// 进程间的视频帧环：memfd 共享内存划分为固定大小的帧槽，接口与 FrameQueue 相同（push / pop / set_eof），
+// 用于把帧交给另一个进程中的处理阶段（隔离容易崩溃的第三方滤镜、分段农场的本机工作进程）。
+//
+// 帧槽带有跨进程引用计数。生产进程的帧若已位于帧槽中（解码器经 install_decoder 直接解码到共享内存），
+// push 只写入一条帧描述，不复制像素；否则先取一个空闲帧槽复制。消费进程 pop 得到的 AVFrame 直接引用
+// 共享内存，最后一个引用释放时帧槽回到空闲状态。等待使用 futex，每 100ms 检查一次对端进程是否仍在运行，
+// 对端退出后 push 返回错误、pop 返回 nullptr，不会永久阻塞。
+//
+// 单生产者、单消费者。消费进程通过 fork 继承映射，或由 attach 映射经 SCM_RIGHTS 传来的描述符。
+// 引用帧槽的 AVFrame 须在环对象销毁之前释放。
+class ShmFrameRing {
+public:
+    // 创建 slots 个帧槽、每槽 slot_size 字节的环，失败返回 nullptr
+    static ShmFrameRing* create(int slots, size_t slot_size);
+    // 映射另一进程创建的环，描述符由环对象接管
+    static ShmFrameRing* attach(int fd);
+    ~ShmFrameRing();
+    ShmFrameRing(const ShmFrameRing&) = delete;
+    ShmFrameRing& operator=(const ShmFrameRing&) = delete;
+
+    // 按解码器的对齐要求计算容纳一帧所需的帧槽大小
+    static size_t slot_size_for(AVCodecContext* dec_ctx);
+
+    int fd() const { return memfd; }
+
+    // 登记生产者或消费者进程，用于对端存活检查，pid 为 0 时登记当前进程
+    void bind_producer(pid_t pid = 0);
+    void bind_consumer(pid_t pid = 0);
+
+    // 为解码器安装 get_buffer2，须在 avcodec_open2 之前调用。没有空闲帧槽或帧放不下时退回默认分配
+    void install_decoder(AVCodecContext* dec_ctx);
+
+    // 生产者：发送一帧，不取走 frame 的引用。消费者已退出或帧放不下帧槽时返回 -1
+    int push(const AVFrame* frame);
+    // 消费者：取出一帧，结束或生产者已退出时返回 nullptr
+    AVFrame* pop();
+    void set_eof();
+    int size() const;
+
+private:
+    struct SlotContext {
+        ShmFrameRing* ring;
+        int slot;
+    };
+
+    int memfd = -1;
+    uint8_t* base = nullptr;
+    size_t mapped_size = 0;
+    ShmRingHeader* header = nullptr;
+    uint8_t* slot_data = nullptr;
+    std::vector<SlotContext> slot_contexts;
+    std::atomic<int> next_slot{0};
+
+    ShmFrameRing() = default;
+    int map(int fd, size_t size);
+    int slot_of(const uint8_t* data) const;
+    int acquire_slot(bool wait);
+    void release_slot(int slot);
+    bool peer_alive(bool producer_side) const;
+
+    static void free_slot_buffer(void* opaque, uint8_t* data);
+    static int get_buffer(AVCodecContext* s, AVFrame* frame, int flags);
+};
+
+// 在子进程中运行一个处理阶段：stage 从 FrameQueue 读取环中的帧。须在当前进程启动其他线程之前调用。
+// 返回子进程 pid，失败返回 -1
+pid_t spawn_frame_stage(ShmFrameRing* ring, const std::function<void(FrameQueue&)>& stage);
+
+// 转发线程：把 input 中的帧逐个送入环，结束后设置环的结束标志。子进程退出后丢弃剩余帧
+void forward_to_ring(FrameQueue& input, ShmFrameRing* ring);
+
+#endif
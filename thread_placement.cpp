@@ -0,0 +1,170 @@
+#include "thread_placement.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+static const char* NODE_DIR = "/sys/devices/system/node";
+static const char* CPU_DIR = "/sys/devices/system/cpu";
+
+int parse_placement_policy(const std::string& name, PlacementPolicy* policy) {
+    if (name == "off") {
+        *policy = PLACEMENT_OFF;
+    } else if (name == "node") {
+        *policy = PLACEMENT_NODE;
+    } else if (name == "cache") {
+        *policy = PLACEMENT_CACHE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 解析 sysfs 的 CPU 列表，如 0-15,32-47
+static std::vector<int> read_cpu_list(const std::string& path) {
+    std::vector<int> cpus;
+    std::ifstream in(path.c_str());
+    std::string list;
+    if (!(in >> list)) return cpus;
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        int first = 0, last = 0;
+        int n = sscanf(item.c_str(), "%d-%d", &first, &last);
+        if (n < 1) continue;
+        if (n == 1) last = first;
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+static std::string node_cpulist(int node) {
+    return std::string(NODE_DIR) + "/node" + std::to_string(node) + "/cpulist";
+}
+
+int numa_node_count() {
+    int count = 0;
+    while (access(node_cpulist(count).c_str(), R_OK) == 0) count++;
+    return count > 0 ? count : 1;
+}
+
+// 与 cpu 共享末级缓存的 CPU（编号最大的缓存层级）
+static std::vector<int> llc_siblings(int cpu) {
+    std::vector<int> siblings;
+    int best_level = 0;
+    for (int index = 0;; index++) {
+        std::string dir = std::string(CPU_DIR) + "/cpu" + std::to_string(cpu) + "/cache/index" + std::to_string(index);
+        std::ifstream level_file((dir + "/level").c_str());
+        int level = 0;
+        if (!(level_file >> level)) break;
+        if (level > best_level) {
+            std::vector<int> shared = read_cpu_list(dir + "/shared_cpu_list");
+            if (!shared.empty()) {
+                best_level = level;
+                siblings = shared;
+            }
+        }
+    }
+    if (siblings.empty()) siblings.push_back(cpu);
+    return siblings;
+}
+
+static void set_affinity(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+// 当前线程的内存优先从 node 分配
+static void set_preferred_node(int node) {
+    unsigned long mask[16] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8);
+}
+
+ThreadPlacement* ThreadPlacement::create(const PlacementOptions& options) {
+    if (options.policy == PLACEMENT_OFF) {
+        return nullptr;
+    }
+    int node = options.node >= 0 ? options.node : 0;
+    std::vector<int> cpus = read_cpu_list(node_cpulist(node));
+    if (cpus.empty() && node == 0) {
+        // 没有 NUMA 信息的机器视为单节点
+        cpus = read_cpu_list(std::string(CPU_DIR) + "/online");
+    }
+
+    ThreadPlacement* placement = new ThreadPlacement;
+    sched_getaffinity(0, sizeof(placement->original_affinity), &placement->original_affinity);
+    // 调用方可能已设置内存策略（如 numactl --preferred），析构时原样恢复；读取失败时恢复为默认策略
+    if (syscall(SYS_get_mempolicy, &placement->original_policy, placement->original_nodemask,
+                sizeof(placement->original_nodemask) * 8, nullptr, 0) < 0) {
+        placement->original_policy = MPOL_DEFAULT;
+        std::fill(placement->original_nodemask, placement->original_nodemask + 16, 0ul);
+    }
+    // 只使用本进程允许运行的 CPU（taskset、cgroup 的限制）
+    for (int cpu : cpus) {
+        if (CPU_ISSET(cpu, &placement->original_affinity)) placement->node_cpus.push_back(cpu);
+    }
+    if (placement->node_cpus.empty()) {
+        std::cerr << "NUMA 节点 " << node << " 没有可用的 CPU，不固定线程" << std::endl;
+        delete placement;
+        return nullptr;
+    }
+    placement->numa_node = node;
+    placement->codec_cpus = placement->node_cpus;
+    placement->other_cpus = placement->node_cpus;
+
+    if (options.policy == PLACEMENT_CACHE) {
+        // 解码和编码放在节点内第一组共享末级缓存的核心上，解码输出的帧在缓存中交给编码器；
+        // 其余阶段放在组外，节点只有一组末级缓存时与解码、编码共用
+        std::vector<int> siblings = llc_siblings(placement->node_cpus[0]);
+        std::vector<int> codec, other;
+        for (int cpu : placement->node_cpus) {
+            (std::find(siblings.begin(), siblings.end(), cpu) != siblings.end() ? codec : other).push_back(cpu);
+        }
+        placement->codec_cpus = codec;
+        if (!other.empty()) placement->other_cpus = other;
+    }
+    return placement;
+}
+
+ThreadPlacement::~ThreadPlacement() {
+    sched_setaffinity(0, sizeof(original_affinity), &original_affinity);
+    syscall(SYS_set_mempolicy, original_policy, original_nodemask, sizeof(original_nodemask) * 8);
+}
+
+void ThreadPlacement::enter(PipelineStage stage) {
+    set_affinity(stage == STAGE_OTHER ? other_cpus : codec_cpus);
+    set_preferred_node(numa_node);
+}
+
+void ThreadPlacement::bind_memory(void* data, size_t length, int node) {
+    if (node < 0) return;
+    unsigned long mask[16] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    // 尚未触碰的页在首次写入时从该节点分配，节点内存不足时退回其他节点
+    syscall(SYS_mbind, data, length, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0);
+}
+
+static std::string format_cpus(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t i = 0; i < cpus.size(); i++) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) j++;
+        if (!text.empty()) text += ",";
+        text += std::to_string(cpus[i]);
+        if (j > i) text += "-" + std::to_string(cpus[j]);
+        i = j;
+    }
+    return text;
+}
+
+void ThreadPlacement::report() const {
+    std::cout << "线程放置: NUMA 节点 " << numa_node << "，解码/编码 CPU " << format_cpus(codec_cpus)
+              << "，其他阶段 CPU " << format_cpus(other_cpus) << std::endl;
+}
@@ -0,0 +1,64 @@
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <string>
+#include <vector>
+#include <sched.h>
+
+// 流水线线程放置策略
+enum PlacementPolicy {
+    PLACEMENT_OFF,    // 由操作系统调度
+    PLACEMENT_NODE,   // 作业的全部线程固定在一个 NUMA 节点的 CPU 上，内存优先从该节点分配
+    PLACEMENT_CACHE   // 在 node 基础上，解码和编码线程集中到共享同一末级缓存的一组核心
+};
+
+struct PlacementOptions {
+    PlacementPolicy policy = PLACEMENT_OFF;
+    int node = -1;   // NUMA 节点，-1 为自动（单作业用 0 号节点，批处理选运行作业最少的节点）
+};
+
+// 解析 off / node / cache，失败返回 -1
+int parse_placement_policy(const std::string& name, PlacementPolicy* policy);
+
+// 本机 NUMA 节点数，没有 NUMA 信息时为 1
+int numa_node_count();
+
+// 流水线阶段，决定线程放置在哪组 CPU 上
+enum PipelineStage {
+    STAGE_DECODE,
+    STAGE_ENCODE,
+    STAGE_OTHER      // 解复用、音频、分发、复用等轻量阶段
+};
+
+// 一个作业的线程放置。线程创建时继承创建者的 CPU 亲和性和内存策略，编解码器的内部线程在 avcodec_open2 中
+// 由作业线程创建，因此作业线程在打开编解码器和启动各阶段线程之前先调用 enter(阶段)，新线程即落在该阶段的
+// CPU 组上，内存优先从作业的节点分配。析构时恢复作业线程原来的亲和性和内存策略
+class ThreadPlacement {
+public:
+    // 策略为 off、节点不存在或可用 CPU 为空时返回 nullptr
+    static ThreadPlacement* create(const PlacementOptions& options);
+    ~ThreadPlacement();
+    ThreadPlacement(const ThreadPlacement&) = delete;
+    ThreadPlacement& operator=(const ThreadPlacement&) = delete;
+
+    int node() const { return numa_node; }
+    // 把当前线程切换到 stage 的 CPU 组
+    void enter(PipelineStage stage);
+    // 把一段内存绑定到作业的节点（帧缓冲池的大缓冲）
+    static void bind_memory(void* data, size_t length, int node);
+
+    void report() const;
+
+private:
+    int numa_node = -1;
+    std::vector<int> node_cpus;    // 节点内本进程可用的 CPU
+    std::vector<int> codec_cpus;   // 解码和编码使用的 CPU 组
+    std::vector<int> other_cpus;   // 其余阶段使用的 CPU 组
+    cpu_set_t original_affinity;
+    int original_policy = 0;       // 作业线程原来的内存策略（get_mempolicy 返回的模式和标志）
+    unsigned long original_nodemask[16] = {};
+
+    ThreadPlacement() = default;
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "thumbnail.h"
+#include "demuxer.h"
+#include "video_decoder.h"
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+}
+
+// 一张缩略图在雪碧图中的位置
+struct ThumbnailCue {
+    double time;
+    int sheet;
+    int x, y;
+};
+
+static std::string sheet_path(const ThumbnailOptions& options, int sheet) {
+    char name[32];
+    snprintf(name, sizeof(name), "_%03d.", sheet);
+    return options.output_prefix + name + options.image_format;
+}
+
+static std::string vtt_time(double seconds) {
+    int64_t ms = llround(seconds * 1000);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%03d", (int)(ms / 3600000), (int)(ms / 60000 % 60),
+             (int)(ms / 1000 % 60), (int)(ms % 1000));
+    return buf;
+}
+
+// 图片格式对应的编码器和像素格式
+static int image_codec_for(const std::string& format, AVCodecID* codec_id, AVPixelFormat* pix_fmt) {
+    if (format == "jpg" || format == "jpeg") {
+        *codec_id = AV_CODEC_ID_MJPEG;
+        *pix_fmt = AV_PIX_FMT_YUVJ420P;
+    } else if (format == "png") {
+        *codec_id = AV_CODEC_ID_PNG;
+        *pix_fmt = AV_PIX_FMT_RGB24;
+    } else if (format == "webp") {
+        *codec_id = AV_CODEC_ID_WEBP;
+        *pix_fmt = AV_PIX_FMT_YUV420P;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// 编码一张雪碧图并写入文件
+static int encode_sheet(const AVFrame* sheet, AVCodecID codec_id, const std::string& path) {
+    AVCodec* codec = avcodec_find_encoder(codec_id);
+    if (!codec) {
+        std::cerr << "找不到图片编码器: " << avcodec_get_name(codec_id) << std::endl;
+        return -1;
+    }
+
+    AVCodecContext* enc_ctx = avcodec_alloc_context3(codec);
+    enc_ctx->width = sheet->width;
+    enc_ctx->height = sheet->height;
+    enc_ctx->pix_fmt = static_cast<AVPixelFormat>(sheet->format);
+    enc_ctx->time_base = (AVRational){1, 1};
+    enc_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+    enc_ctx->global_quality = FF_QP2LAMBDA * 3;
+    enc_ctx->thread_count = 1;
+
+    int ret = avcodec_open2(enc_ctx, codec, nullptr);
+    if (ret < 0) {
+        std::cerr << "无法打开图片编码器" << std::endl;
+        avcodec_free_context(&enc_ctx);
+        return ret;
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    ret = avcodec_send_frame(enc_ctx, sheet);
+    if (ret >= 0) {
+        avcodec_send_frame(enc_ctx, nullptr);
+        ret = avcodec_receive_packet(enc_ctx, pkt);
+    }
+    if (ret >= 0) {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(pkt->data), pkt->size);
+        if (!file) {
+            std::cerr << "无法写入雪碧图: " << path << std::endl;
+            ret = -1;
+        }
+    } else {
+        std::cerr << "雪碧图编码失败: " << path << std::endl;
+    }
+
+    av_packet_free(&pkt);
+    avcodec_free_context(&enc_ctx);
+    return ret;
+}
+
+// 图片编码线程：从队列取出已拼好的雪碧图并编码写出，帧的 pts 为雪碧图序号
+static void sheet_encoder(FrameQueue& sheet_queue, AVCodecID codec_id, const ThumbnailOptions& options) {
+    while (AVFrame* sheet = sheet_queue.pop()) {
+        std::string path = sheet_path(options, (int)sheet->pts);
+        if (encode_sheet(sheet, codec_id, path) >= 0) {
+            std::cout << "雪碧图已生成: " << path << std::endl;
+        }
+        av_frame_free(&sheet);
+    }
+}
+
+static AVFrame* alloc_sheet(int width, int height, AVPixelFormat pix_fmt, int index) {
+    AVFrame* sheet = av_frame_alloc();
+    if (!sheet) return nullptr;
+    sheet->width = width;
+    sheet->height = height;
+    sheet->format = pix_fmt;
+    if (av_frame_get_buffer(sheet, 32) < 0) {
+        av_frame_free(&sheet);
+        return nullptr;
+    }
+
+    // 未填满的格子保持黑色
+    ptrdiff_t linesizes[4];
+    for (int i = 0; i < 4; i++) linesizes[i] = sheet->linesize[i];
+    av_image_fill_black(sheet->data, linesizes, pix_fmt,
+                        pix_fmt == AV_PIX_FMT_YUVJ420P ? AVCOL_RANGE_JPEG : AVCOL_RANGE_MPEG, width, height);
+    sheet->pts = index;
+    return sheet;
+}
+
+// 把解码帧缩放到雪碧图的 (x, y) 格子
+static int place_thumbnail(SwsContext* sws, const AVFrame* frame, AVFrame* sheet, int x, int y, int thumb_h) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(sheet->format));
+    uint8_t* dst[4] = {};
+    for (int i = 0; i < 4 && sheet->data[i]; i++) {
+        bool chroma = i == 1 || i == 2;
+        int step = 1;
+        for (int c = 0; c < desc->nb_components; c++) {
+            if (desc->comp[c].plane == i) step = desc->comp[c].step;
+        }
+        int px = chroma ? x >> desc->log2_chroma_w : x;
+        int py = chroma ? y >> desc->log2_chroma_h : y;
+        dst[i] = sheet->data[i] + (ptrdiff_t)py * sheet->linesize[i] + px * step;
+    }
+    return sws_scale(sws, frame->data, frame->linesize, 0, frame->height, dst, sheet->linesize) == thumb_h ? 0 : -1;
+}
+
+int run_thumbnail_job(const std::string& input_file, const ThumbnailOptions& options) {
+    AVCodecID image_codec;
+    AVPixelFormat sheet_fmt;
+    if (image_codec_for(options.image_format, &image_codec, &sheet_fmt) < 0) {
+        std::cerr << "不支持的图片格式: " << options.image_format << std::endl;
+        return -1;
+    }
+
+    AVFormatContext* fmt_ctx = nullptr;
+    if (avformat_open_input(&fmt_ctx, input_file.c_str(), nullptr, nullptr) != 0) {
+        std::cerr << "无法打开输入文件: " << input_file << std::endl;
+        return -1;
+    }
+    if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
+        std::cerr << "无法获取流信息" << std::endl;
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (video_stream < 0) {
+        std::cerr << "找不到视频流" << std::endl;
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+    // 其他流在解复用层直接丢弃
+    for (unsigned i = 0; i < fmt_ctx->nb_streams; i++) {
+        if ((int)i != video_stream) fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    AVStream* stream = fmt_ctx->streams[video_stream];
+    AVCodec* dec_codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    AVCodecContext* dec_ctx = avcodec_alloc_context3(dec_codec);
+    avcodec_parameters_to_context(dec_ctx, stream->codecpar);
+    // 只解码关键帧，其余包在解码器入口直接丢弃
+    dec_ctx->skip_frame = AVDISCARD_NONKEY;
+    if (avcodec_open2(dec_ctx, dec_codec, nullptr) < 0) {
+        std::cerr << "无法打开视频解码器" << std::endl;
+        avcodec_free_context(&dec_ctx);
+        avformat_close_input(&fmt_ctx);
+        return -1;
+    }
+
+    // 缩略图尺寸取偶数，便于 4:2:0 的色度对齐
+    int thumb_w = std::max(2, options.width & ~1);
+    int thumb_h = dec_ctx->width > 0 ? std::max(2, (int)((int64_t)thumb_w * dec_ctx->height / dec_ctx->width) & ~1) : thumb_w;
+    int sheet_w = thumb_w * options.columns;
+    int sheet_h = thumb_h * options.rows;
+    int per_sheet = options.columns * options.rows;
+
+    std::cout << "缩略图模式: 每 " << options.interval << " 秒一张，" << thumb_w << "x" << thumb_h
+              << "，每张雪碧图 " << options.columns << "x" << options.rows << std::endl;
+
+    PacketQueue video_packet_queue, audio_packet_queue;
+    FrameQueue keyframe_queue, sheet_queue;
+
+    std::thread demux_thread(demuxer, fmt_ctx, std::ref(video_packet_queue), std::ref(audio_packet_queue), video_stream, -1, 0, nullptr);
+    std::thread decode_thread(video_decoder, dec_ctx, std::ref(video_packet_queue), std::ref(keyframe_queue));
+
+    int workers = options.workers > 0 ? options.workers : std::max(1, std::min(av_cpu_count(), 4));
+    std::vector<std::thread> encode_threads;
+    for (int i = 0; i < workers; i++) {
+        encode_threads.emplace_back(sheet_encoder, std::ref(sheet_queue), image_codec, std::cref(options));
+    }
+
+    std::vector<ThumbnailCue> cues;
+    SwsContext* sws = nullptr;
+    AVFrame* sheet = nullptr;
+    int sheet_index = 0;
+    double next_time = 0;
+    double start_time = stream->start_time != AV_NOPTS_VALUE ? stream->start_time * av_q2d(stream->time_base) : 0;
+
+    while (AVFrame* frame = keyframe_queue.pop()) {
+        int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+        double time = pts != AV_NOPTS_VALUE ? pts * av_q2d(stream->time_base) - start_time : next_time;
+
+        // 按固定间隔取样：跳过距上一张太近的关键帧
+        if (time + 1e-3 < next_time) {
+            av_frame_free(&frame);
+            continue;
+        }
+        next_time = (floor(time / options.interval) + 1) * options.interval;
+
+        sws = sws_getCachedContext(sws, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                   thumb_w, thumb_h, sheet_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!sheet) {
+            sheet = alloc_sheet(sheet_w, sheet_h, sheet_fmt, sheet_index);
+        }
+        if (!sws || !sheet) {
+            std::cerr << "无法准备缩略图缩放" << std::endl;
+            av_frame_free(&frame);
+            break;
+        }
+
+        int slot = (int)(cues.size() % per_sheet);
+        int x = slot % options.columns * thumb_w;
+        int y = slot / options.columns * thumb_h;
+        place_thumbnail(sws, frame, sheet, x, y, thumb_h);
+        cues.push_back({ time, sheet_index, x, y });
+        av_frame_free(&frame);
+
+        // 雪碧图拼满后交给编码线程
+        if (slot == per_sheet - 1) {
+            sheet_queue.push(sheet);
+            sheet = nullptr;
+            sheet_index++;
+        }
+    }
+    if (sheet) {
+        sheet_queue.push(sheet);
+    }
+
+    // 取帧循环提前结束时仍需排空上游队列，解复用和解码线程才能退出
+    while (AVFrame* frame = keyframe_queue.pop()) {
+        av_frame_free(&frame);
+    }
+    sheet_queue.set_eof();
+
+    demux_thread.join();
+    decode_thread.join();
+    for (std::thread& t : encode_threads) {
+        t.join();
+    }
+
+    // WebVTT 索引：每张缩略图覆盖到下一张的时间，最后一张到文件结尾
+    double duration = fmt_ctx->duration != AV_NOPTS_VALUE ? fmt_ctx->duration / (double)AV_TIME_BASE : 0;
+    std::ofstream vtt(options.output_prefix + ".vtt");
+    vtt << "WEBVTT\n\n";
+    for (size_t i = 0; i < cues.size(); i++) {
+        double begin = i == 0 ? 0 : cues[i].time;
+        double end = i + 1 < cues.size() ? cues[i + 1].time : std::max(duration, cues[i].time + options.interval);
+        std::string image = sheet_path(options, cues[i].sheet);
+        size_t slash = image.find_last_of('/');
+        if (slash != std::string::npos) image = image.substr(slash + 1);
+        vtt << vtt_time(begin) << " --> " << vtt_time(end) << "\n"
+            << image << "#xywh=" << cues[i].x << "," << cues[i].y << "," << thumb_w << "," << thumb_h << "\n\n";
+    }
+    std::cout << "缩略图完成: " << cues.size() << " 张，索引 " << options.output_prefix << ".vtt" << std::endl;
+
+    sws_freeContext(sws);
+    avcodec_free_context(&dec_ctx);
+    avformat_close_input(&fmt_ctx);
+    return cues.empty() ? -1 : 0;
+}
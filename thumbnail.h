@@ -0,0 +1,21 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <string>
+
+// 缩略图/雪碧图模式的参数
+struct ThumbnailOptions {
+    // 输出前缀：雪碧图为 <prefix>_000.jpg ...，索引为 <prefix>.vtt；为空时不启用
+    std::string output_prefix;
+    std::string image_format = "jpg";  // jpg / png / webp
+    double interval = 10.0;            // 缩略图间隔（秒）
+    int width = 160;                   // 单张缩略图宽度，高度按比例
+    int columns = 5;
+    int rows = 5;
+    int workers = 0;                   // 图片编码线程数，0 为自动
+};
+
+// 只解码关键帧生成雪碧图和 WebVTT 索引，成功返回 0
+int run_thumbnail_job(const std::string& input_file, const ThumbnailOptions& options);
+
+#endif
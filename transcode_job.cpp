@@ -0,0 +1,538 @@
+#include <thread>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "demuxer.h"
+#include "input_probe.h"
+#include "muxer.h"
+#include "video_decoder.h"
+#include "video_encoder.h"
+#include "video_filter.h"
+#include "audio_decoder.h"
+#include "audio_encoder.h"
+#include "audio_filter.h"
+#include "frame_tee.h"
+#include "audio_writer.h"
+#include "peaks_writer.h"
+#include "video_writer.h"
+#include "frame_pool.h"
+#include "proxy_mode.h"
+#include "quality_monitor.h"
+#include "effort_controller.h"
+#include "shm_frame_ring.h"
+#include "live_latency.h"
+#include "memory_io.h"
+#include "thread_placement.h"
+#include <cstring>
+#include <sys/wait.h>
+#include "transcode_job.h"
+
+extern "C" {
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#include "libavutil/opt.h"
+#include "libavfilter/avfilter.h"
+}
+
+// 共享内存帧环的帧槽数，需容纳解码器参考帧、帧线程和队列中的帧，不够时个别帧退回普通内存
+static const int SHM_RING_SLOTS = 32;
+
+// 一路输出：某一速度下的滤波、编码和复用，多倍速时多路输出共享同一次解码
+struct OutputBranch {
+    float speed = 1.0;
+    std::string output_file;
+    AVFormatContext* out_fmt = nullptr;
+    AVCodecContext* video_enc_ctx = nullptr;
+    AVCodecContext* audio_enc_ctx = nullptr;
+
+    FrameQueue video_frame_queue, audio_frame_queue, filtered_audio_queue;
+    PacketQueue encoded_video_queue, encoded_audio_queue;
+
+    bool custom_io = false;  // 输出经调用方的 MediaSink 写出
+
+    AVFilterContext *audio_src_ctx = nullptr, *audio_sink_ctx = nullptr;
+    AVFilterGraph *audio_filter_graph = nullptr;
+
+    std::unique_ptr<QualityMonitor> quality_monitor;
+    std::unique_ptr<EffortController> effort_controller;
+
+    std::thread video_encode_thread, audio_filter_thread, audio_encode_thread, mux_thread, quality_thread;
+};
+
+// 直播输出：MP4 改为分片写出，每个包写出后立即刷新，不等待交错缓冲
+static void configure_live_output(AVFormatContext* out_fmt) {
+    out_fmt->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+    out_fmt->max_interleave_delta = AV_TIME_BASE / 10;
+    const char* name = out_fmt->oformat->name;
+    if (strstr(name, "mp4") || strstr(name, "mov")) {
+        // 每帧一个分片；旧版本 FFmpeg 不支持 frag_every_frame 时退回按关键帧分片
+        if (av_opt_set(out_fmt->priv_data, "movflags", "empty_moov+default_base_moof+frag_every_frame", 0) < 0) {
+            av_opt_set(out_fmt->priv_data, "movflags", "empty_moov+default_base_moof+frag_keyframe", 0);
+        }
+    }
+}
+
+// 创建输出上下文并打开编码器和输出文件
+static int open_output_branch(OutputBranch& branch, AVFormatContext* fmt_ctx, int video_stream, int audio_stream,
+                              const VideoEncoderConfig& video_config, int quality_interval, bool live, MediaSink* sink) {
+    const char* output_file = branch.output_file.c_str();
+    // 直播输出到 FIFO 或 udp:// 等无法按扩展名确定格式时使用 MPEG-TS
+    const char* format_name = live && !av_guess_format(nullptr, output_file, nullptr) ? "mpegts" : nullptr;
+    int ret = avformat_alloc_output_context2(&branch.out_fmt, nullptr, format_name, output_file);
+    if (ret < 0 || !branch.out_fmt) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "无法创建输出上下文: " << errbuf << std::endl;
+        return -1;
+    }
+    if (live) {
+        configure_live_output(branch.out_fmt);
+    }
+
+    branch.video_enc_ctx = open_video_encoder(fmt_ctx->streams[video_stream], branch.out_fmt, video_config);
+    if (!branch.video_enc_ctx) {
+        return -1;
+    }
+
+    if (quality_interval > 0) {
+        branch.quality_monitor.reset(new QualityMonitor(quality_interval));
+        if (branch.quality_monitor->open(branch.video_enc_ctx) < 0) {
+            // 校验解码器不可用时只跳过测量，不影响转码
+            branch.quality_monitor.reset();
+        }
+    }
+
+    if (audio_stream >= 0) {
+        std::cout << "找到音频流，索引: " << audio_stream << std::endl;
+        branch.audio_enc_ctx = open_audio_encoder(fmt_ctx->streams[audio_stream], branch.out_fmt);
+    }
+
+    // 打印输出文件信息
+    av_dump_format(branch.out_fmt, 0, output_file, 1);
+
+    if (sink) {
+        branch.out_fmt->pb = open_sink_io(sink);
+        if (!branch.out_fmt->pb) {
+            std::cerr << "无法创建输出 AVIO" << std::endl;
+            return -1;
+        }
+        branch.custom_io = true;
+        branch.out_fmt->flags |= AVFMT_FLAG_CUSTOM_IO;
+        const char* name = branch.out_fmt->oformat->name;
+        if (!sink->seek && !live && (strstr(name, "mp4") || strstr(name, "mov"))) {
+            // 输出不能回写时 moov 无法放在文件末尾再补写，改为分片写出
+            av_opt_set(branch.out_fmt->priv_data, "movflags", "empty_moov+default_base_moof+frag_keyframe", 0);
+        }
+    } else if (!(branch.out_fmt->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&branch.out_fmt->pb, output_file, AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            char errbuf[AV_ERROR_MAX_STRING_SIZE];
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            std::cerr << "无法打开输出文件: " << errbuf << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void close_output_branch(OutputBranch& branch) {
+    avcodec_free_context(&branch.video_enc_ctx);
+    avcodec_free_context(&branch.audio_enc_ctx);
+
+    if (branch.out_fmt && branch.out_fmt->pb) {
+        if (branch.custom_io) {
+            close_memory_io(&branch.out_fmt->pb);
+        } else {
+            avio_closep(&branch.out_fmt->pb);
+        }
+    }
+
+    if (branch.out_fmt) {
+        avformat_free_context(branch.out_fmt);
+        branch.out_fmt = nullptr;
+    }
+}
+
+int run_transcode_job(const JobOptions& opts) {
+    // 作业内所有队列共享的取消令牌，须比各队列（包括各路输出中的队列）活得更久
+    CancelToken cancel_token;
+    if (opts.live.enabled) {
+        avformat_network_init();
+    }
+    if ((opts.input_source || opts.output_sink) && (opts.inputs.size() > 1 || opts.speeds.size() > 1)) {
+        std::cerr << "内存输入输出只支持单个输入和单一速度" << std::endl;
+        return -1;
+    }
+    AVFormatContext* fmt_ctx = nullptr;
+    const char* input_file = opts.inputs[0].c_str();
+    // 调用方提供输入时经自定义 AVIOContext 读取，inputs[0] 只作为名称
+    AVIOContext* input_pb = nullptr;
+    if (opts.input_source) {
+        input_pb = open_source_io(opts.input_source);
+        if (!input_pb) {
+            std::cerr << "无法创建输入 AVIO" << std::endl;
+            return -1;
+        }
+    }
+    if ((input_pb ? open_input(input_pb, opts.inputs[0], opts.probe, &fmt_ctx)
+                  : open_input(opts.inputs[0], opts.probe, &fmt_ctx)) < 0) {
+        close_memory_io(&input_pb);
+        return -1;
+    }
+
+    // 打印输入文件信息
+    av_dump_format(fmt_ctx, 0, input_file, 0);
+
+    // 线程放置：作业线程先切换到各阶段的 CPU 组，再打开编解码器（创建其内部线程）或启动阶段线程，
+    // 新线程继承亲和性和内存策略。函数返回时恢复作业线程原来的设置
+    std::unique_ptr<ThreadPlacement> placement(ThreadPlacement::create(opts.placement));
+    auto enter_stage = [&placement](PipelineStage stage) {
+        if (placement) placement->enter(stage);
+    };
+    if (placement) {
+        placement->report();
+    }
+
+    // 查找视频流
+    int video_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (video_stream < 0) {
+        std::cerr << "找不到视频流" << std::endl;
+        avformat_close_input(&fmt_ctx);
+        close_memory_io(&input_pb);
+        return -1;
+    }
+    if (opts.loudness.mode == LOUDNESS_LINEAR && av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0) >= 0 &&
+        check_linear_loudness_buffer(fmt_ctx, opts.inputs, opts.probe, opts.speeds) < 0) {
+        avformat_close_input(&fmt_ctx);
+        close_memory_io(&input_pb);
+        return -1;
+    }
+
+    // 初始化视频解码器
+    AVCodec* video_dec_codec = avcodec_find_decoder(fmt_ctx->streams[video_stream]->codecpar->codec_id);
+    AVCodecContext* video_dec_ctx = avcodec_alloc_context3(video_dec_codec);
+    avcodec_parameters_to_context(video_dec_ctx, fmt_ctx->streams[video_stream]->codecpar);
+    if (opts.decoder_threads > 0) {
+        video_dec_ctx->thread_count = opts.decoder_threads;
+    }
+    if (opts.live.enabled) {
+        // 帧线程每个线程多缓冲一帧，直播只用条带线程
+        video_dec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        video_dec_ctx->thread_type = FF_THREAD_SLICE;
+    }
+    // 原始视频由子进程写出时，解码器直接解码到共享内存帧槽，转交子进程不复制像素
+    ShmFrameRing* frame_ring = nullptr;
+    if (opts.raw_video_process && !opts.raw_video_output.empty()) {
+        frame_ring = ShmFrameRing::create(SHM_RING_SLOTS, ShmFrameRing::slot_size_for(video_dec_ctx));
+    }
+    AVRational raw_frame_rate = av_guess_frame_rate(fmt_ctx, fmt_ctx->streams[video_stream], nullptr);
+    // 子进程须在启动其他线程之前创建：此时还没有打开任何编解码器（avcodec_open2 会启动编解码线程），
+    // 也还没有启动任何管线线程
+    pid_t raw_video_pid = -1;
+    if (frame_ring) {
+        std::string raw_output = opts.raw_video_output;
+        bool raw_mmap = opts.raw_video_mmap;
+        raw_video_pid = spawn_frame_stage(frame_ring, [raw_output, raw_frame_rate, raw_mmap](FrameQueue& queue) {
+            video_writer(queue, raw_output, raw_frame_rate, raw_mmap);
+        });
+    }
+    FramePool* frame_pool = nullptr;
+    if (frame_ring) {
+        frame_ring->install_decoder(video_dec_ctx);
+    } else {
+        FramePoolMode frame_pool_mode = FRAME_POOL_DEFAULT;
+        parse_frame_pool_mode(opts.frame_pool, frame_pool_mode);
+        frame_pool = frame_pool_install(video_dec_ctx, frame_pool_mode, placement ? placement->node() : -1);
+    }
+
+    // 代理模式：按输出尺寸降低解码代价，编码使用快速预设
+    VideoEncoderConfig video_config;
+    bool proxy = opts.proxy_width > 0;
+    if (proxy) {
+        proxy_output_size(video_dec_ctx->width, video_dec_ctx->height, opts.proxy_width, opts.proxy_height,
+                          &video_config.width, &video_config.height);
+        video_config.preset = "veryfast";
+        apply_proxy_decode_options(video_dec_ctx, video_dec_codec, video_config.width, video_config.height);
+        std::cout << "代理输出: " << video_config.width << "x" << video_config.height << std::endl;
+    }
+    enter_stage(STAGE_DECODE);
+    avcodec_open2(video_dec_ctx, video_dec_codec, nullptr);
+    enter_stage(STAGE_OTHER);
+
+    // 编码强度控制需要在中途切换预设，固定影响流头的编码参数
+    bool effort_control = opts.effort.target_speed > 0 || opts.effort.deadline > 0;
+    video_config.fixed_headers = effort_control;
+    video_config.threads = opts.encoder_threads;
+    video_config.low_latency = opts.live.enabled;
+
+    // 初始化音频解码器
+    AVCodecContext* audio_dec_ctx = nullptr;
+    int audio_stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (audio_stream >= 0) {
+        AVCodec* audio_dec_codec = avcodec_find_decoder(fmt_ctx->streams[audio_stream]->codecpar->codec_id);
+        audio_dec_ctx = avcodec_alloc_context3(audio_dec_codec);
+        avcodec_parameters_to_context(audio_dec_ctx, fmt_ctx->streams[audio_stream]->codecpar);
+        avcodec_open2(audio_dec_ctx, audio_dec_codec, nullptr);
+    }
+
+    // 每个速度一路输出，单一速度时沿用原输出文件名
+    enter_stage(STAGE_ENCODE);
+    std::vector<std::unique_ptr<OutputBranch>> branches;
+    for (float branch_speed : opts.speeds) {
+        std::unique_ptr<OutputBranch> branch(new OutputBranch);
+        branch->speed = branch_speed;
+        branch->output_file = opts.speeds.size() > 1 ? output_for_speed(opts.output, branch_speed) : opts.output;
+        if (open_output_branch(*branch, fmt_ctx, video_stream, audio_stream, video_config, opts.quality_interval, opts.live.enabled, opts.output_sink) < 0) {
+            close_output_branch(*branch);
+            for (auto& opened : branches) close_output_branch(*opened);
+            avformat_close_input(&fmt_ctx);
+            close_memory_io(&input_pb);
+            avcodec_free_context(&video_dec_ctx);
+            avcodec_free_context(&audio_dec_ctx);
+            frame_pool_free(&frame_pool);
+            if (raw_video_pid > 0) {
+                // 子进程读到结束标记后退出
+                frame_ring->set_eof();
+                waitpid(raw_video_pid, nullptr, 0);
+            }
+            delete frame_ring;
+            return -1;
+        }
+        if (effort_control && strcmp(branch->video_enc_ctx->codec->name, "libx264") == 0) {
+            // 截止时间按首个输入的时长估算
+            double media_duration = fmt_ctx->duration > 0 ? fmt_ctx->duration / (double)AV_TIME_BASE / branch_speed : 0;
+            branch->effort_controller.reset(new EffortController(opts.effort, video_config.preset, branch->video_enc_ctx->framerate,
+                                                                 branch_speed, branch->video_enc_ctx->gop_size, media_duration));
+        }
+        branches.push_back(std::move(branch));
+    }
+
+    enter_stage(STAGE_OTHER);
+
+    // 直播模式测量从视频包读出到编码包写出的延迟，目标为一个 GOP 以内
+    std::unique_ptr<LatencyTracker> latency;
+    if (opts.live.enabled) {
+        AVCodecContext* enc_ctx = branches[0]->video_enc_ctx;
+        double gop_duration = enc_ctx->framerate.num > 0 ? enc_ctx->gop_size * av_q2d(av_inv_q(enc_ctx->framerate)) : 1.0;
+        latency.reset(new LatencyTracker(gop_duration));
+    }
+
+    // 创建队列，任一阶段出错时经取消令牌停止所有阶段
+    PacketQueue video_packet_queue, audio_packet_queue;
+    FrameQueue decoded_video_queue, decoded_audio_queue, pcm_frame_queue, peaks_frame_queue, raw_video_frame_queue;
+    for (PacketQueue* queue : { &video_packet_queue, &audio_packet_queue }) {
+        queue->attach(&cancel_token);
+    }
+    for (FrameQueue* queue : { &decoded_video_queue, &decoded_audio_queue, &pcm_frame_queue, &peaks_frame_queue, &raw_video_frame_queue }) {
+        queue->attach(&cancel_token);
+    }
+    for (auto& branch : branches) {
+        for (FrameQueue* queue : { &branch->video_frame_queue, &branch->audio_frame_queue, &branch->filtered_audio_queue }) {
+            queue->attach(&cancel_token);
+        }
+        branch->encoded_video_queue.attach(&cancel_token);
+        branch->encoded_audio_queue.attach(&cancel_token);
+    }
+
+    // 单路输出时解码器直接写入该路的帧队列，多路时经分发线程按引用共享解码帧
+    std::vector<FrameQueue*> video_outputs, audio_outputs;
+    for (auto& branch : branches) {
+        video_outputs.push_back(&branch->video_frame_queue);
+        if (branch->audio_enc_ctx) audio_outputs.push_back(&branch->audio_frame_queue);
+    }
+    bool write_raw_video = !opts.raw_video_output.empty();
+    if (write_raw_video) {
+        video_outputs.push_back(&raw_video_frame_queue);
+    }
+    bool write_pcm = !opts.pcm_output.empty() && audio_stream >= 0;
+    if (write_pcm) {
+        audio_outputs.push_back(&pcm_frame_queue);
+    }
+    bool write_peaks = !opts.peaks_output.empty() && audio_stream >= 0;
+    if (write_peaks) {
+        audio_outputs.push_back(&peaks_frame_queue);
+    }
+
+    // 只要有一路需要音频就解码音频，否则解复用时直接丢弃音频包
+    bool has_audio = !audio_outputs.empty();
+    if (!has_audio) {
+        audio_stream = -1;
+    }
+
+    // 解码后的视频帧队列设置上限，解码超前时阻塞，单个作业的内存占用有界（见 batch_scheduler.h）
+    if (opts.frame_queue_limit > 0) {
+        decoded_video_queue.capacity = opts.frame_queue_limit;
+        for (FrameQueue* queue : video_outputs) {
+            queue->capacity = opts.frame_queue_limit;
+        }
+    }
+
+    bool use_video_tee = video_outputs.size() > 1;
+    bool use_audio_tee = audio_outputs.size() > 1;
+    FrameQueue& video_decode_output = use_video_tee ? decoded_video_queue : *video_outputs[0];
+    FrameQueue& audio_decode_output = use_audio_tee || audio_outputs.empty() ? decoded_audio_queue : *audio_outputs[0];
+
+     // 解复用线程
+     std::cout << "解复用线程已启动" << std::endl;
+     std::thread demux_thread;
+     if (opts.range_end > 0) {
+         // 退到区间起点或之前的关键帧，起点之前的包由解复用线程丢弃
+         if (opts.range_start > 0 && avformat_seek_file(fmt_ctx, -1, INT64_MIN, opts.range_start, opts.range_start, 0) < 0) {
+             std::cerr << "无法定位到区间起点: " << opts.range_start / (double)AV_TIME_BASE << " 秒" << std::endl;
+         }
+         demux_thread = std::thread(segment_demuxer, fmt_ctx, std::ref(video_packet_queue), std::ref(audio_packet_queue), video_stream, audio_stream, opts.range_start, opts.range_end, opts.start_time);
+     } else if (opts.inputs.size() > 1) {
+         std::cout << "拼接 " << opts.inputs.size() << " 个输入" << std::endl;
+         demux_thread = std::thread(concat_demuxer, fmt_ctx, std::cref(opts.inputs), std::cref(opts.probe), std::ref(video_packet_queue), std::ref(audio_packet_queue), video_stream, audio_stream);
+     } else {
+         demux_thread = std::thread(demuxer, fmt_ctx, std::ref(video_packet_queue), std::ref(audio_packet_queue), video_stream, audio_stream, opts.start_time, latency.get());
+     }
+
+     // 视频处理线程
+     std::cout << "视频处理线程已启动" << std::endl;
+     enter_stage(STAGE_DECODE);
+     std::thread video_decode_thread(video_decoder, video_dec_ctx, std::ref(video_packet_queue), std::ref(video_decode_output));
+     enter_stage(STAGE_OTHER);
+     std::thread video_tee_thread, audio_tee_thread;
+     if (use_video_tee) {
+         std::cout << "视频分发，共 " << video_outputs.size() << " 路" << std::endl;
+         video_tee_thread = std::thread(frame_tee, std::ref(decoded_video_queue), video_outputs);
+     }
+     std::thread raw_video_writer_thread;
+     if (raw_video_pid > 0) {
+         raw_video_writer_thread = std::thread(forward_to_ring, std::ref(raw_video_frame_queue), frame_ring);
+     } else if (write_raw_video) {
+         raw_video_writer_thread = std::thread(video_writer, std::ref(raw_video_frame_queue), opts.raw_video_output, raw_frame_rate, opts.raw_video_mmap);
+     }
+     VideoEncodeOptions video_options;
+     video_options.drop_static_frames = opts.drop_static_frames;
+     video_options.static_threshold = opts.static_threshold;
+     video_options.fast_scale = proxy;
+     enter_stage(STAGE_ENCODE);
+     for (auto& branch : branches) {
+         VideoEncodeOptions branch_options = video_options;
+         branch_options.quality_monitor = branch->quality_monitor.get();
+         branch_options.effort_controller = branch->effort_controller.get();
+         branch_options.encoder_config = &video_config;
+         if (branch->quality_monitor) {
+             branch->quality_thread = std::thread(&QualityMonitor::run, branch->quality_monitor.get());
+         }
+         branch->video_encode_thread = std::thread(video_encoder, &branch->video_enc_ctx, std::ref(branch->video_frame_queue), std::ref(branch->encoded_video_queue), branch->speed, branch_options);
+     }
+     enter_stage(STAGE_OTHER);
+
+     // 音频处理线程
+     std::cout << "音频处理线程已启动" << std::endl;
+     std::thread audio_decode_thread;
+     TempoEngine tempo_engine = opts.wsola_tempo ? TEMPO_ENGINE_WSOLA : TEMPO_ENGINE_ATEMPO;
+     if (has_audio) {
+         if (opts.loudness.mode == LOUDNESS_LINEAR) {
+             audio_decode_thread = std::thread(loudness_linear_decoder, audio_dec_ctx, std::ref(audio_packet_queue), std::ref(audio_decode_output), std::cref(opts.loudness));
+         } else {
+             audio_decode_thread = std::thread(audio_decoder, audio_dec_ctx, std::ref(audio_packet_queue), std::ref(audio_decode_output));
+         }
+         if (use_audio_tee) {
+             audio_tee_thread = std::thread(frame_tee, std::ref(decoded_audio_queue), audio_outputs);
+         }
+     }
+     std::thread pcm_writer_thread;
+     if (write_pcm) {
+         pcm_writer_thread = std::thread(audio_writer, std::ref(pcm_frame_queue), opts.pcm_output);
+     }
+     std::thread peaks_writer_thread;
+     if (write_peaks) {
+         peaks_writer_thread = std::thread(peaks_writer, std::ref(peaks_frame_queue), opts.peaks_output, opts.peaks_window);
+     }
+     for (auto& branch : branches) {
+         if (!branch->audio_enc_ctx) {
+             // 该路没有音频，通知复用线程音频已结束
+             branch->encoded_audio_queue.set_eof();
+             continue;
+         }
+         int ret = init_audio_filters(audio_dec_ctx, branch->audio_enc_ctx, &branch->audio_filter_graph, &branch->audio_src_ctx, &branch->audio_sink_ctx, branch->speed, tempo_engine, opts.loudness);
+         if (ret < 0) {
+             // 滤波器图建不起来（如缺少 loudnorm 滤镜）时取消作业，不启动该路的音频滤波和编码线程
+             std::cerr << "初始化音频滤波器失败，速度: " << branch->speed << std::endl;
+             branch->encoded_audio_queue.fail(ret, "音频滤波");
+             avfilter_graph_free(&branch->audio_filter_graph);
+             continue;
+         }
+         branch->audio_filter_thread = std::thread(audio_filter_process, &branch->audio_filter_graph, &branch->audio_src_ctx, &branch->audio_sink_ctx, branch->audio_enc_ctx, branch->speed, tempo_engine, std::cref(opts.loudness), std::ref(branch->audio_frame_queue), std::ref(branch->filtered_audio_queue));
+         branch->audio_encode_thread = std::thread(audio_encoder, branch->audio_enc_ctx, std::ref(branch->filtered_audio_queue), std::ref(branch->encoded_audio_queue));
+     }
+
+     // 复用线程
+     std::cout << "复用线程已启动" << std::endl;
+     for (auto& branch : branches) {
+         branch->mux_thread = std::thread(muxer, branch->out_fmt, std::ref(branch->encoded_video_queue), std::ref(branch->encoded_audio_queue), latency.get());
+     }
+
+     // 等待所有线程完成
+     demux_thread.join();
+     std::cout << "解复用线程已结束" << std::endl;
+     video_decode_thread.join();
+     if (video_tee_thread.joinable()) video_tee_thread.join();
+     for (auto& branch : branches) {
+         branch->video_encode_thread.join();
+     }
+     if (raw_video_writer_thread.joinable()) raw_video_writer_thread.join();
+     if (raw_video_pid > 0) {
+         int status = 0;
+         waitpid(raw_video_pid, &status, 0);
+         if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+             std::cerr << "原始视频写出子进程异常退出，转码不受影响" << std::endl;
+         }
+     }
+     std::cout << "视频处理线程已结束" << std::endl;
+
+     if (audio_decode_thread.joinable()) audio_decode_thread.join();
+     if (audio_tee_thread.joinable()) audio_tee_thread.join();
+     for (auto& branch : branches) {
+         if (branch->audio_filter_thread.joinable()) branch->audio_filter_thread.join();
+         if (branch->audio_encode_thread.joinable()) branch->audio_encode_thread.join();
+     }
+     if (pcm_writer_thread.joinable()) pcm_writer_thread.join();
+     if (peaks_writer_thread.joinable()) peaks_writer_thread.join();
+     std::cout << "音频处理线程已结束" << std::endl;
+
+     for (auto& branch : branches) {
+         branch->mux_thread.join();
+         if (branch->quality_thread.joinable()) branch->quality_thread.join();
+     }
+     std::cout << "复用线程已结束" << std::endl;
+
+     std::cout << "所有线程已完成" << std::endl;
+
+    // 资源释放
+    avformat_close_input(&fmt_ctx);
+    close_memory_io(&input_pb);
+    avcodec_free_context(&video_dec_ctx);
+    avcodec_free_context(&audio_dec_ctx);
+    frame_pool_free(&frame_pool);
+
+    for (auto& branch : branches) {
+        close_output_branch(*branch);
+        if (!cancel_token.cancelled()) {
+            std::cout << "转码完成，输出文件: " << branch->output_file << std::endl;
+        }
+        if (branch->quality_monitor) {
+            branch->quality_monitor->report(branch->output_file);
+        }
+        if (branch->effort_controller) {
+            branch->effort_controller->report(branch->output_file);
+        }
+    }
+    if (latency) {
+        latency->report();
+    }
+    // 引用帧槽的帧此时都已释放
+    delete frame_ring;
+
+    if (cancel_token.cancelled()) {
+        std::cerr << "转码失败: " << cancel_token.stage() << " 出错，作业已取消" << std::endl;
+        return cancel_token.error() < 0 ? cancel_token.error() : -1;
+    }
+    return 0;
+}
+
+
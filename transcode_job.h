@@ -0,0 +1,10 @@
+#ifndef TRANSCODE_JOB_H
+#define TRANSCODE_JOB_H
+
+#include "job_options.h"
+
+// 按作业参数完成一次转码：打开输入，建立解码、滤波、编码和复用线程，全部结束后释放资源。
+// 不修改进程级状态，批处理模式下可在多个线程中并发调用。成功返回 0
+int run_transcode_job(const JobOptions& opts);
+
+#endif
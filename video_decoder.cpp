@@ -1,24 +1,63 @@
 #include "video_decoder.h"
+#include <iostream>
+
+// 取出解码器当前可输出的全部帧送入帧队列，出错返回负值
+static int receive_frames(AVCodecContext* codec_ctx, AVFrame* frame, FrameQueue& frame_queue) {
+    while (true) {
+        int ret = avcodec_receive_frame(codec_ctx, frame);
+        if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) return 0;
+        if(ret == AVERROR_INVALIDDATA) {
+            // 帧线程解码时损坏数据的错误在取帧时才返回，同样跳过
+            std::cerr << "视频帧数据损坏，已跳过" << std::endl;
+            continue;
+        }
+        if(ret < 0) return ret;
+
+        AVFrame* frame_copy = av_frame_alloc();
+        av_frame_ref(frame_copy, frame);
+        frame_queue.push(frame_copy);
+        av_frame_unref(frame);
+    }
+}
 
 void video_decoder(AVCodecContext* codec_ctx, PacketQueue& packet_queue, FrameQueue& frame_queue) {
     AVFrame* frame = av_frame_alloc();
+    bool failed = false;
 
-    while(true) {
+    while(!failed) {
         AVPacket* pkt = packet_queue.pop();
         if(!pkt) break;
 
         int ret = avcodec_send_packet(codec_ctx, pkt);
         av_packet_free(&pkt);
 
-        if(ret < 0) break;
+        if(ret == AVERROR_INVALIDDATA) {
+            // 单个损坏的包只丢失这一段画面，解码器从下一个包继续；内存不足等其他错误才终止作业
+            std::cerr << "视频包数据损坏，已跳过" << std::endl;
+            continue;
+        }
+        if(ret < 0) {
+            // 取消整个作业，解复用线程随即停止读取
+            frame_queue.fail(ret, "视频解码");
+            failed = true;
+            break;
+        }
 
-        while(ret >= 0) {
-            ret = avcodec_receive_frame(codec_ctx, frame);
-            if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+        ret = receive_frames(codec_ctx, frame, frame_queue);
+        if(ret < 0) {
+            frame_queue.fail(ret, "视频解码");
+            failed = true;
+        }
+    }
 
-            AVFrame* frame_copy = av_frame_alloc();
-            av_frame_ref(frame_copy, frame);
-            frame_queue.push(frame_copy);
+    // 输入结束后冲洗解码器，取出 B 帧重排和帧线程缓存的延迟帧，否则每段结尾都会缺帧
+    if(!failed && !packet_queue.is_cancelled()) {
+        int ret = avcodec_send_packet(codec_ctx, nullptr);
+        if(ret >= 0) {
+            ret = receive_frames(codec_ctx, frame, frame_queue);
+        }
+        if(ret < 0 && ret != AVERROR_EOF) {
+            frame_queue.fail(ret, "视频解码");
         }
     }
 
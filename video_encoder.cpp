@@ -2,23 +2,237 @@
 #include "video_filter.h"
 #include "packet_queue.h"
 #include <iostream>
+#include <cstring>
 
+extern "C" {
+#include "libavutil/opt.h"
+}
+
+// 冲洗编码器，取出剩余的全部包送入复用队列，直到编码器返回 AVERROR_EOF。出错返回负值
+static int drain_video_encoder(AVCodecContext* enc_ctx, PacketQueue& mux_queue, QualityMonitor* quality_monitor) {
+    int ret = avcodec_send_frame(enc_ctx, nullptr);
+    if (ret < 0) {
+        return ret;
+    }
+    AVPacket* pkt = av_packet_alloc();
+    while (true) {
+        // 送入空帧之后编码器不会再返回 EAGAIN，只会输出剩余的包直到 EOF
+        ret = avcodec_receive_packet(enc_ctx, pkt);
+        if (ret == AVERROR_EOF) {
+            ret = 0;
+            break;
+        }
+        if (ret < 0) {
+            std::cerr << "冲洗视频编码器失败: " << ret << std::endl;
+            break;
+        }
+
+        // 确保包有正确的时间戳
+        if (pkt->pts == AV_NOPTS_VALUE) {
+            std::cerr << "编码器输出的包没有PTS" << std::endl;
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        if (quality_monitor) {
+            quality_monitor->add_packet(pkt);
+        }
 
-void video_encoder(AVCodecContext* enc_ctx, FrameQueue& frame_queue, PacketQueue& mux_queue, float speed) {
+        AVPacket* pkt_copy = av_packet_alloc();
+        av_packet_ref(pkt_copy, pkt);
+        mux_queue.push(pkt_copy);
+        av_packet_unref(pkt);
+    }
+    av_packet_free(&pkt);
+    return ret;
+}
+
+// libx264 的编码参数，打开和重新打开编码器时使用同一组选项
+static void set_x264_options(const VideoEncoderConfig& config, AVDictionary** codec_opts) {
+    av_dict_set(codec_opts, "preset", config.preset.c_str(), 0);
+    av_dict_set(codec_opts, "profile", "main", 0);
+    av_dict_set(codec_opts, "tune", config.low_latency ? "zerolatency" : "film", 0);
+    if (config.fixed_headers) {
+        // 各预设间影响 SPS/PPS 和 DTS 偏移的参数统一固定，切换预设后输出流头不变，
+        // 已写入容器的 extradata 仍然有效
+        av_dict_set(codec_opts, "x264-params", config.low_latency ? "ref=3:bframes=0:weightp=2:cabac=1:8x8dct=0"
+                                                                  : "ref=3:bframes=3:b-pyramid=normal:weightp=2:cabac=1:8x8dct=0", 0);
+    }
+}
+
+AVCodecContext* open_video_encoder(AVStream* in_video_stream, AVFormatContext* out_fmt, const VideoEncoderConfig& config) {
+    // 获取输入视频流的参数
+    int in_width = in_video_stream->codecpar->width;
+    int in_height = in_video_stream->codecpar->height;
+    int64_t in_bit_rate = in_video_stream->codecpar->bit_rate;
+    AVRational in_time_base = in_video_stream->time_base;
+    AVRational in_frame_rate = in_video_stream->avg_frame_rate;
+    
+    std::cout << "输入视频参数：" << std::endl
+              << "分辨率: " << in_width << "x" << in_height << std::endl
+              << "帧率: " << av_q2d(in_frame_rate) << " fps" << std::endl
+              << "比特率: " << (in_bit_rate / 1000) << " kb/s" << std::endl
+              << "时间基准: " << in_time_base.num << "/" << in_time_base.den << std::endl;
+
+    // 初始化视频编码器 - 尝试多种编码器
+    AVCodec* video_enc_codec = nullptr;
+    
+    // 尝试不同的编码器，按优先级排序
+    const char* video_encoders[] = {"libx264", "mpeg4", "h264", "libxvid", "mjpeg", nullptr};
+    int encoder_index = 0;
+    
+    while (video_encoders[encoder_index] && !video_enc_codec) {
+        video_enc_codec = avcodec_find_encoder_by_name(video_encoders[encoder_index]);
+        if (video_enc_codec) {
+            std::cout << "使用视频编码器: " << video_encoders[encoder_index] << std::endl;
+            break;
+        }
+        encoder_index++;
+    }
+    
+    // 如果找不到任何指定的编码器，尝试使用MPEG4
+    if (!video_enc_codec) {
+        std::cout << "找不到指定的视频编码器，尝试使用默认MPEG4编码器" << std::endl;
+        video_enc_codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    }
+    
+    if (!video_enc_codec) {
+        std::cerr << "找不到可用的视频编码器" << std::endl;
+        return nullptr;
+    }
+    
+    AVStream* video_out_stream = avformat_new_stream(out_fmt, nullptr);
+    AVCodecContext* video_enc_ctx = avcodec_alloc_context3(video_enc_codec);
+    
+
+    video_enc_ctx->width = config.width > 0 ? config.width : in_width;
+    video_enc_ctx->height = config.height > 0 ? config.height : in_height;
+    video_enc_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    video_enc_ctx->bit_rate = in_bit_rate > 0 ? in_bit_rate : 431000;
+    if (in_bit_rate > 0 && in_width > 0 && in_height > 0 &&
+        (video_enc_ctx->width != in_width || video_enc_ctx->height != in_height)) {
+        // 输出尺寸变化时码率按像素数等比例缩放
+        video_enc_ctx->bit_rate = av_rescale(in_bit_rate, (int64_t)video_enc_ctx->width * video_enc_ctx->height,
+                                             (int64_t)in_width * in_height);
+    }
+    
+
+    if (strcmp(video_enc_codec->name, "mpeg4") == 0) {
+        if (in_time_base.den > 65535) {
+            video_enc_ctx->time_base = (AVRational){1, 25000};
+        } else {
+            video_enc_ctx->time_base = in_time_base; // 使用输入文件的时间基准
+        }
+    } else {
+        video_enc_ctx->time_base = in_time_base;
+    }
+    
+    video_enc_ctx->framerate = in_frame_rate;
+    video_enc_ctx->gop_size = 25;
+    // B 帧需要等待后续帧才能输出，低延迟时不使用
+    video_enc_ctx->max_b_frames = config.low_latency ? 0 : 3;
+    video_enc_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    if (config.threads > 0) {
+        video_enc_ctx->thread_count = config.threads;
+    }
+    
+    // 如果是libx264编码器，设置预设和配置文件
+    AVDictionary* codec_opts = nullptr;
+    if (strcmp(video_enc_codec->name, "libx264") == 0) {
+        set_x264_options(config, &codec_opts);
+    }
+    
+    // 打开视频编码器
+    int ret = avcodec_open2(video_enc_ctx, video_enc_codec, &codec_opts);
+    av_dict_free(&codec_opts);
+    if (ret < 0) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "无法打开视频编码器: " << errbuf << std::endl;
+        avcodec_free_context(&video_enc_ctx);
+        return nullptr;
+    }
+    
+    // 从编码器上下文复制参数到输出流
+    avcodec_parameters_from_context(video_out_stream->codecpar, video_enc_ctx);
+    video_out_stream->time_base = video_enc_ctx->time_base;
+
+    return video_enc_ctx;
+}
+
+int reopen_video_encoder(AVCodecContext** enc_ctx, const VideoEncoderConfig& config, PacketQueue& mux_queue,
+                         QualityMonitor* quality_monitor) {
+    const AVCodecContext* old_ctx = *enc_ctx;
+    const AVCodec* codec = old_ctx->codec;
+    if (!codec || strcmp(codec->name, "libx264") != 0) {
+        return -1;
+    }
+
+    if (drain_video_encoder(*enc_ctx, mux_queue, quality_monitor) < 0) {
+        return -1;
+    }
+
+    // FFmpeg 不支持关闭后在同一个上下文上重新打开（avcodec_close 还会释放 extradata），
+    // 按 open_video_encoder 设置的参数新建上下文
+    AVCodecContext* new_ctx = avcodec_alloc_context3(codec);
+    if (!new_ctx) {
+        return -1;
+    }
+    new_ctx->width = old_ctx->width;
+    new_ctx->height = old_ctx->height;
+    new_ctx->pix_fmt = old_ctx->pix_fmt;
+    new_ctx->bit_rate = old_ctx->bit_rate;
+    new_ctx->time_base = old_ctx->time_base;
+    new_ctx->framerate = old_ctx->framerate;
+    new_ctx->gop_size = old_ctx->gop_size;
+    new_ctx->max_b_frames = old_ctx->max_b_frames;
+    new_ctx->flags = old_ctx->flags;
+    new_ctx->thread_count = old_ctx->thread_count;
+
+    AVDictionary* codec_opts = nullptr;
+    set_x264_options(config, &codec_opts);
+    int ret = avcodec_open2(new_ctx, codec, &codec_opts);
+    av_dict_free(&codec_opts);
+    if (ret < 0) {
+        char errbuf[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        std::cerr << "无法重新打开视频编码器: " << errbuf << std::endl;
+        avcodec_free_context(&new_ctx);
+        return -1;
+    }
+    avcodec_free_context(enc_ctx);
+    *enc_ctx = new_ctx;
+    return 0;
+}
+
+void video_encoder(AVCodecContext** enc_ctx, FrameQueue& frame_queue, PacketQueue& mux_queue, float speed, const VideoEncodeOptions& options) {
     // 初始化滤波器图
     AVFilterGraph* filter_graph = nullptr;
     AVFilterContext* buffer_src_ctx = nullptr;
     AVFilterContext* buffer_sink_ctx = nullptr;
-    if (init_filter_graph(enc_ctx, &filter_graph, &buffer_src_ctx, &buffer_sink_ctx, speed) < 0) {
+    if (init_filter_graph(*enc_ctx, &filter_graph, &buffer_src_ctx, &buffer_sink_ctx, speed) < 0) {
         std::cerr << "初始化滤波器图失败" << std::endl;
+        mux_queue.fail(AVERROR(EINVAL), "视频滤波器初始化");
+        while (AVFrame* frame = frame_queue.pop()) {
+            av_frame_free(&frame);
+        }
+        if (options.quality_monitor) {
+            options.quality_monitor->finish();
+        }
+        mux_queue.set_eof();
         return;
     }
 
     std::cout << "视频滤波器图初始化成功，速度: " << speed << std::endl;
 
     // 处理视频帧
-    if (filter_frame(buffer_src_ctx, buffer_sink_ctx, frame_queue, enc_ctx, mux_queue) < 0) {
+    if (filter_frame(&filter_graph, &buffer_src_ctx, &buffer_sink_ctx, frame_queue, enc_ctx, mux_queue, speed, options) < 0) {
         std::cerr << "处理视频帧失败" << std::endl;
+        avfilter_graph_free(&filter_graph);
+        if (options.quality_monitor) {
+            options.quality_monitor->finish();
+        }
+        mux_queue.set_eof();
         return;
     }
 
@@ -30,37 +244,15 @@ void video_encoder(AVCodecContext* enc_ctx, FrameQueue& frame_queue, PacketQueue
     std::cout << "视频滤波器图已释放" << std::endl;
 
     // 冲洗编码器
-    avcodec_send_frame(enc_ctx, nullptr);
-    AVPacket* pkt = av_packet_alloc();
-    int max_flush_attempts = 100; // 最大冲洗尝试次数
-    int flush_count = 0;
-
-    while (max_flush_attempts-- > 0) {
-        int ret = avcodec_receive_packet(enc_ctx, pkt);
-        if (ret == AVERROR_EOF) break;
-        if (ret == AVERROR(EAGAIN)) continue;
-
-        flush_count++;
-        
-        // 确保包有正确的时间戳
-        if (pkt->pts == AV_NOPTS_VALUE) {
-            std::cerr << "编码器输出的包没有PTS" << std::endl;
-            continue;
-        }
-
-        // std::cout << "冲洗编码器，获取到视频包 #" << flush_count
-        //           << " PTS: " << pkt->pts
-        //           << " DTS: " << pkt->dts
-        //           << " 大小: " << pkt->size << " 字节" << std::endl;
-
-        AVPacket* pkt_copy = av_packet_alloc();
-        av_packet_ref(pkt_copy, pkt);
-        mux_queue.push(pkt_copy);
-        av_packet_unref(pkt);
+    int ret = drain_video_encoder(*enc_ctx, mux_queue, options.quality_monitor);
+    if (ret < 0) {
+        mux_queue.fail(ret, "视频编码");
     }
 
     std::cout << "视频编码器冲洗完成" << std::endl;
+    if (options.quality_monitor) {
+        options.quality_monitor->finish();
+    }
     mux_queue.set_eof();
-    av_packet_free(&pkt);
 }
 
@@ -12,10 +12,35 @@ extern "C" {
 }
 #endif
 
+#include <string>
 #include "frame_queue.h"
 #include "packet_queue.h"
-
-void video_encoder(AVCodecContext* enc_ctx, FrameQueue& frame_queue, PacketQueue& mux_queue, float speed);
+#include "video_filter.h"
+
+// 视频编码器参数，宽高为 0 时沿用输入尺寸
+struct VideoEncoderConfig {
+    int width = 0;
+    int height = 0;
+    std::string preset = "medium";  // libx264 预设
+    // 固定各预设间影响流头的参数，允许编码中途切换预设（见 effort_controller.h）
+    bool fixed_headers = false;
+    int threads = 0;  // 编码线程数，0 为编码器默认
+    // 低延迟（直播模式）：不使用 B 帧，libx264 使用 zerolatency 调优（无前瞻、条带线程）
+    bool low_latency = false;
+};
+
+// 按输入视频流参数创建并打开视频编码器，同时在输出上下文中创建视频流，失败返回 nullptr
+AVCodecContext* open_video_encoder(AVStream* in_video_stream, AVFormatContext* out_fmt,
+                                   const VideoEncoderConfig& config = VideoEncoderConfig());
+
+// 在 GOP 边界按新参数重新打开 libx264 编码器：先冲洗旧编码器的全部包，再按相同的编码参数新建并打开上下文，
+// 成功后释放旧上下文并把 *enc_ctx 换为新上下文。编码器须以 fixed_headers 打开，失败返回 -1
+int reopen_video_encoder(AVCodecContext** enc_ctx, const VideoEncoderConfig& config, PacketQueue& mux_queue,
+                         QualityMonitor* quality_monitor);
+
+// *enc_ctx 由调用方持有并在线程结束后释放，切换预设时会被换为新的上下文
+void video_encoder(AVCodecContext** enc_ctx, FrameQueue& frame_queue, PacketQueue& mux_queue, float speed,
+                   const VideoEncodeOptions& options = VideoEncodeOptions());
 
 #endif
 
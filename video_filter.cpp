@@ -1,4 +1,8 @@
 #include "video_filter.h"
+#include "pix_convert.h"
+#include "frame_diff.h"
+#include "effort_controller.h"
+#include "video_encoder.h"
 #include <iostream>
 
 
@@ -11,6 +15,13 @@ extern "C" {
 
 // 初始化滤波器图
 int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, float speed) {
+    return init_filter_graph(dec_ctx->width, dec_ctx->height, dec_ctx->pix_fmt, dec_ctx->time_base, dec_ctx,
+                             filter_graph, buffer_src_ctx, buffer_sink_ctx, speed);
+}
+
+int init_filter_graph(int in_width, int in_height, int in_pix_fmt, AVRational time_base, AVCodecContext* enc_ctx,
+                      AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, float speed,
+                      bool fast_scale) {
     // 创建滤波器图
     *filter_graph = avfilter_graph_alloc();
     if (!*filter_graph) {
@@ -26,8 +37,8 @@ int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVF
     char args[512];
     snprintf(args, sizeof(args),
              "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=1/1",
-             dec_ctx->width, dec_ctx->height, dec_ctx->pix_fmt,
-             dec_ctx->time_base.num, dec_ctx->time_base.den);
+             in_width, in_height, in_pix_fmt,
+             time_base.num, time_base.den);
     if (avfilter_graph_create_filter(buffer_src_ctx, buffer_src, "in", args, nullptr, *filter_graph) < 0) {
         std::cerr << "无法创建输入滤波器" << std::endl;
         return -1;
@@ -39,6 +50,31 @@ int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVF
         return -1;
     }
 
+    // 限定输出像素格式为编码器格式。filter_frame 已在图外完成格式转换，这里只作兜底
+    enum AVPixelFormat out_pix_fmts[] = { enc_ctx->pix_fmt, AV_PIX_FMT_NONE };
+    if (av_opt_set_int_list(*buffer_sink_ctx, "pix_fmts", out_pix_fmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN) < 0) {
+        std::cerr << "无法设置输出像素格式" << std::endl;
+        return -1;
+    }
+
+    AVFilterContext* last_filter = *buffer_src_ctx;
+
+    // 输入分辨率与编码器不同时缩放到编码器尺寸
+    if (in_width != enc_ctx->width || in_height != enc_ctx->height) {
+        AVFilterContext* scale_ctx;
+        char scale_args[64];
+        snprintf(scale_args, sizeof(scale_args), "%d:%d%s", enc_ctx->width, enc_ctx->height,
+                 fast_scale ? ":flags=fast_bilinear" : "");
+        if (avfilter_graph_create_filter(&scale_ctx, avfilter_get_by_name("scale"), "scale", scale_args, nullptr, *filter_graph) < 0 ||
+            avfilter_link(last_filter, 0, scale_ctx, 0) != 0) {
+            std::cerr << "无法创建scale滤波器" << std::endl;
+            return -1;
+        }
+        last_filter = scale_ctx;
+        std::cout << "输入分辨率 " << in_width << "x" << in_height
+                  << " 与编码器不同，缩放到 " << enc_ctx->width << "x" << enc_ctx->height << std::endl;
+    }
+
     // 创建setpts滤波器用于变速
     AVFilterContext* setpts_ctx;
     const AVFilter* setpts = avfilter_get_by_name("setpts");
@@ -51,8 +87,8 @@ int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVF
 
     std::cout << "视频变速滤波器创建成功，速度因子: " << speed << std::endl;
 
-    // 连接滤波器：输入 -> setpts -> 输出
-    if (avfilter_link(*buffer_src_ctx, 0, setpts_ctx, 0) != 0 ||
+    // 连接滤波器：输入 -> [scale] -> setpts -> 输出
+    if (avfilter_link(last_filter, 0, setpts_ctx, 0) != 0 ||
         avfilter_link(setpts_ctx, 0, *buffer_sink_ctx, 0) != 0) {
         std::cerr << "无法连接滤波器" << std::endl;
         return -1;
@@ -67,8 +103,138 @@ int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVF
     return 0;
 }
 
+// 从滤波器图取出所有可用帧，编码后送入复用队列
+static int encode_filtered_frames(AVFilterContext* buffer_sink_ctx, AVFrame* filtered_frame, AVCodecContext** enc_ctx, PacketQueue& mux_queue, int& encoded_count,
+                                  const VideoEncodeOptions& options) {
+    QualityMonitor* quality_monitor = options.quality_monitor;
+    while (true) {
+        int ret = av_buffersink_get_frame(buffer_sink_ctx, filtered_frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+
+        if (ret < 0) {
+            std::cerr << "无法从滤波器图获取帧" << std::endl;
+            return ret;
+        }
+
+        // 打印滤波后帧的时间戳
+        // std::cout << "滤波后的帧 PTS: " << filtered_frame->pts
+        //           << " 时间(秒): " << filtered_frame->pts * av_q2d((*enc_ctx)->time_base) << std::endl;
+
+        // 到达决策点时先在 GOP 边界切换编码预设，重新打开后 *enc_ctx 为新的编码器上下文
+        std::string preset;
+        if (options.effort_controller && options.effort_controller->before_frame(&preset)) {
+            VideoEncoderConfig config = options.encoder_config ? *options.encoder_config : VideoEncoderConfig();
+            config.preset = preset;
+            config.fixed_headers = true;
+            if (reopen_video_encoder(enc_ctx, config, mux_queue, quality_monitor) < 0) {
+                av_frame_unref(filtered_frame);
+                return -1;
+            }
+        }
+
+        if (quality_monitor) {
+            quality_monitor->add_reference(filtered_frame);
+        }
+
+        // 将处理后的帧发送到编码器
+        ret = avcodec_send_frame(*enc_ctx, filtered_frame);
+        av_frame_unref(filtered_frame);
+        if (ret < 0) {
+            std::cerr << "发送帧到编码器失败: " << ret << std::endl;
+            return ret;
+        }
+
+        // 从编码器获取数据包
+        AVPacket* pkt = av_packet_alloc();
+        while (true) {
+            ret = avcodec_receive_packet(*enc_ctx, pkt);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
+
+            if (ret < 0) {
+                std::cerr << "从编码器获取数据包失败: " << ret << std::endl;
+                av_packet_free(&pkt);
+                return ret;
+            }
+
+            encoded_count++;
+
+            // 确保包有正确的时间戳
+            if (pkt->pts == AV_NOPTS_VALUE) {
+                std::cerr << "编码器输出的包没有PTS" << std::endl;
+                av_packet_unref(pkt);
+                continue;
+            }
+
+            // 打印编码后的数据包信息
+            // std::cout << "编码后的视频包 #" << encoded_count
+            //           << " PTS: " << pkt->pts
+            //           << " DTS: " << pkt->dts
+            //           << " 时间(秒): " << pkt->pts * av_q2d((*enc_ctx)->time_base)
+            //           << " 大小: " << pkt->size << " 字节" << std::endl;
+
+            if (quality_monitor) {
+                quality_monitor->add_packet(pkt);
+            }
+
+            // 将数据包推送到复用队列
+            AVPacket* pkt_copy = av_packet_alloc();
+            av_packet_ref(pkt_copy, pkt);
+            mux_queue.push(pkt_copy);
+
+            // 释放原始数据包
+            av_packet_unref(pkt);
+        }
+
+        // 释放数据包
+        av_packet_free(&pkt);
+    }
+    return 0;
+}
+
+// 将一帧送入滤波器图并编码取出的帧，输入分辨率或像素格式变化（如拼接不同规格的输入）时先冲洗旧图并按新参数重建。
+// 无论成功与否都会释放 frame
+static int send_to_graph(AVFrame* frame, AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx,
+                         AVFrame* filtered_frame, AVCodecContext** enc_ctx, PacketQueue& mux_queue, float speed, const VideoEncodeOptions& options,
+                         int& encoded_count) {
+    AVFilterLink* in_link = (*buffer_src_ctx)->outputs[0];
+    if (frame->width != in_link->w || frame->height != in_link->h || frame->format != in_link->format) {
+        std::cout << "视频输入参数变化: " << in_link->w << "x" << in_link->h
+                  << " -> " << frame->width << "x" << frame->height << "，重建滤波器图" << std::endl;
+        AVRational time_base = in_link->time_base;
+        av_buffersrc_add_frame(*buffer_src_ctx, nullptr);
+        int ret = encode_filtered_frames(*buffer_sink_ctx, filtered_frame, enc_ctx, mux_queue, encoded_count, options);
+        avfilter_graph_free(filter_graph);
+        if (ret < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
+        if (init_filter_graph(frame->width, frame->height, frame->format, time_base, *enc_ctx,
+                              filter_graph, buffer_src_ctx, buffer_sink_ctx, speed, options.fast_scale) < 0) {
+            std::cerr << "重建滤波器图失败" << std::endl;
+            av_frame_free(&frame);
+            return AVERROR(EINVAL);
+        }
+    }
+
+    // 将帧发送到滤波器图
+    int add_ret = av_buffersrc_add_frame(*buffer_src_ctx, frame);
+    if (add_ret < 0) {
+        std::cerr << "无法发送帧到滤波器图" << std::endl;
+        av_frame_free(&frame);
+        return add_ret;
+    }
+
+    // 从滤波器图获取处理后的帧并编码
+    int ret = encode_filtered_frames(*buffer_sink_ctx, filtered_frame, enc_ctx, mux_queue, encoded_count, options);
+
+    // 释放原始帧
+    av_frame_free(&frame);
+    return ret;
+}
+
 //处理视频帧
-int filter_frame(AVFilterContext* buffer_src_ctx, AVFilterContext* buffer_sink_ctx, FrameQueue& frame_queue, AVCodecContext* enc_ctx, PacketQueue& mux_queue) {
+int filter_frame(AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, FrameQueue& frame_queue, AVCodecContext** enc_ctx, PacketQueue& mux_queue, float speed,
+                 const VideoEncodeOptions& options) {
     AVFrame* filtered_frame = av_frame_alloc();
     if (!filtered_frame) {
         std::cerr << "无法分配帧" << std::endl;
@@ -77,99 +243,94 @@ int filter_frame(AVFilterContext* buffer_src_ctx, AVFilterContext* buffer_sink_c
 
     int frame_count = 0;
     int encoded_count = 0;
+    PixConverter pix_converter;
+
+    StaticFrameDetector static_detector;
+    static_detector.set_threshold(options.static_threshold);
+    AVFrame* held_frame = nullptr;  // 最近一次丢弃的静止帧
+    int static_run = 0;
+    int dropped_count = 0;
+    bool failed = false;
+    int error = 0;
 
     while (AVFrame* frame = frame_queue.pop()) {
         frame_count++;
-
-
-        //std::cout << "进入while循环" << std::endl;
-
-        // 打印输入帧的时间戳
-        // std::cout << "处理视频帧 #" << frame_count
-        //           << " PTS: " << frame->pts
-        //           << " 时间(秒): " << frame->pts * av_q2d(enc_ctx->time_base) << std::endl;
-        
-        // 将帧发送到滤波器图
-        if (av_buffersrc_add_frame(buffer_src_ctx, frame) < 0) {
-            std::cerr << "无法发送帧到滤波器图" << std::endl;
-            av_frame_free(&frame);
-            break;
+        if (options.effort_controller) {
+            options.effort_controller->observe_queue_depth(frame_queue.size());
         }
 
-        // 从滤波器图获取处理后的帧
-        while (true) {
-            int ret = av_buffersink_get_frame(buffer_sink_ctx, filtered_frame);
-            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-
-            if (ret < 0) {
-                std::cerr << "无法从滤波器图获取帧" << std::endl;
+        // 解码输出与编码器像素格式不同时，先在滤波器图之外完成转换
+        if (frame->format != (*enc_ctx)->pix_fmt) {
+            if (!pix_converter.matches(frame, (*enc_ctx)->pix_fmt) &&
+                pix_converter.init(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format), (*enc_ctx)->pix_fmt) < 0) {
+                av_frame_free(&frame);
+                error = AVERROR(EINVAL);
+                failed = true;
                 break;
             }
-
-            //std::cout << "1357" << std::endl;
-
-            // 打印滤波后帧的时间戳
-            // std::cout << "滤波后的帧 PTS: " << filtered_frame->pts
-            //           << " 时间(秒): " << filtered_frame->pts * av_q2d(enc_ctx->time_base) << std::endl;
-
-            // 将处理后的帧发送到编码器
-            ret = avcodec_send_frame(enc_ctx, filtered_frame);
-            if (ret < 0) {
-                std::cerr << "发送帧到编码器失败: " << ret << std::endl;
+            AVFrame* converted = pix_converter.convert(frame);
+            av_frame_free(&frame);
+            if (!converted) {
+                error = AVERROR(ENOMEM);
+                failed = true;
                 break;
             }
+            frame = converted;
+        }
 
-            // 从编码器获取数据包
-            AVPacket* pkt = av_packet_alloc();
-            while (true) {
-                ret = avcodec_receive_packet(enc_ctx, pkt);
-                if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) break;
-
-                if (ret < 0) {
-                    std::cerr << "从编码器获取数据包失败: " << ret << std::endl;
-                    break;
-                }
-
-                encoded_count++;
-                
-                // 确保包有正确的时间戳
-                if (pkt->pts == AV_NOPTS_VALUE) {
-                    std::cerr << "编码器输出的包没有PTS" << std::endl;
-                    av_packet_unref(pkt);
-                    continue;
-                }
-
-                // 打印编码后的数据包信息
-                // std::cout << "编码后的视频包 #" << encoded_count
-                //           << " PTS: " << pkt->pts
-                //           << " DTS: " << pkt->dts
-                //           << " 时间(秒): " << pkt->pts * av_q2d(enc_ctx->time_base)
-                //           << " 大小: " << pkt->size << " 字节" << std::endl;
-
-                // 将数据包推送到复用队列
-                AVPacket* pkt_copy = av_packet_alloc();
-                av_packet_ref(pkt_copy, pkt);
-                mux_queue.push(pkt_copy);
-
-                // 释放原始数据包
-                av_packet_unref(pkt);
+        // 与上一保留帧相同的帧不送编码器，后续帧的时间戳不变，输出为可变帧率。
+        // 连续丢弃超过上限时强制保留一帧，避免长时间没有帧
+        if (options.drop_static_frames) {
+            if (static_detector.is_static(frame) && static_run < options.max_static_frames) {
+                static_run++;
+                dropped_count++;
+                av_frame_free(&held_frame);
+                held_frame = frame;
+                continue;
             }
+            static_run = 0;
+            av_frame_free(&held_frame);
+        }
 
-            // 释放数据包
-            av_packet_free(&pkt);
+        // 打印输入帧的时间戳
+        // std::cout << "处理视频帧 #" << frame_count
+        //           << " PTS: " << frame->pts
+        //           << " 时间(秒): " << frame->pts * av_q2d((*enc_ctx)->time_base) << std::endl;
 
-            // 释放处理后的帧
-            av_frame_unref(filtered_frame);
+        error = send_to_graph(frame, filter_graph, buffer_src_ctx, buffer_sink_ctx, filtered_frame,
+                              enc_ctx, mux_queue, speed, options, encoded_count);
+        if (error < 0) {
+            failed = true;
+            break;
         }
+    }
 
-        // 释放原始帧
-        av_frame_free(&frame);
+    // 出错时取消整个作业；未挂接取消令牌时取出剩余帧，上游不会阻塞在有上限的队列上
+    if (failed) {
+        mux_queue.fail(error, "视频编码");
+        while (AVFrame* frame = frame_queue.pop()) {
+            av_frame_free(&frame);
+        }
+    }
+
+    // 结尾处于静止段时补发最后一帧，保持输出总时长不变
+    if (held_frame) {
+        if (!failed) {
+            dropped_count--;
+            send_to_graph(held_frame, filter_graph, buffer_src_ctx, buffer_sink_ctx, filtered_frame,
+                          enc_ctx, mux_queue, speed, options, encoded_count);
+        } else {
+            av_frame_free(&held_frame);
+        }
+    }
+
+    if (options.drop_static_frames) {
+        std::cout << "静止帧检测: 共 " << frame_count << " 帧，丢弃 " << dropped_count << " 帧" << std::endl;
     }
 
     // std::cout << "视频滤波处理完成，共处理 " << frame_count << " 帧，编码 " << encoded_count << " 个包" << std::endl;
 
     // 释放处理后的帧
     av_frame_free(&filtered_frame);
-    return 0;
+    return failed ? error : 0;
 }
-
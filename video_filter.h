@@ -18,12 +18,40 @@ extern "C" {
 
 #include "frame_queue.h"
 #include "packet_queue.h"
+#include "quality_monitor.h"
+
+class EffortController;
+struct VideoEncoderConfig;
 
 // 初始化滤波器图
 int init_filter_graph(AVCodecContext* dec_ctx, AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, float speed);
 
-// 处理视频帧
+// 按给定的输入参数初始化滤波器图，输出尺寸和像素格式与编码器一致。
+// fast_scale 为 true 时缩放使用 fast_bilinear（代理输出）
+int init_filter_graph(int in_width, int in_height, int in_pix_fmt, AVRational time_base, AVCodecContext* enc_ctx,
+                      AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, float speed,
+                      bool fast_scale = false);
+
+// 视频滤波编码的可选处理
+struct VideoEncodeOptions {
+    // 丢弃与上一保留帧相同的静止帧（块 SAD 检测，见 frame_diff.h），输出为可变帧率
+    bool drop_static_frames = false;
+    int static_threshold = 2;       // 16x16 块内平均每像素绝对差的上限
+    int max_static_frames = 250;    // 最多连续丢弃的帧数
+    // 缩放到编码器尺寸时使用最快的 fast_bilinear 算法
+    bool fast_scale = false;
+    // 抽样质量测量，为空时不测量；编码线程只负责送入参考帧和输出包
+    QualityMonitor* quality_monitor = nullptr;
+    // 编码强度闭环控制，为空时预设固定；在 GOP 边界重新打开编码器切换预设
+    EffortController* effort_controller = nullptr;
+    // 打开编码器时的参数，切换预设重新打开时沿用其余各项（低延迟、尺寸、线程数等）
+    const VideoEncoderConfig* encoder_config = nullptr;
+};
+
+// 处理视频帧，输入分辨率或像素格式变化时重建滤波器图。
+// 编码强度控制切换预设时换用新的编码器上下文，*enc_ctx 随之更新
 //int filter_frame(AVFilterContext* buffer_src_ctx, AVFilterContext* buffer_sink_ctx, FrameQueue& frame_queue, AVCodecContext* enc_ctx);
-int filter_frame(AVFilterContext* buffer_src_ctx, AVFilterContext* buffer_sink_ctx, FrameQueue& frame_queue, AVCodecContext* enc_ctx, PacketQueue& mux_queue);
+int filter_frame(AVFilterGraph** filter_graph, AVFilterContext** buffer_src_ctx, AVFilterContext** buffer_sink_ctx, FrameQueue& frame_queue, AVCodecContext** enc_ctx, PacketQueue& mux_queue, float speed,
+                 const VideoEncodeOptions& options = VideoEncodeOptions());
 
 #endif
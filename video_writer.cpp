@@ -1,53 +1,241 @@
 #include "video_writer.h"
-#include <fstream>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 extern "C" {
-#include "libavcodec/avcodec.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 }
 
-extern std::queue<AVFrame*> video_frame_queue;
-extern std::mutex video_mutex;
-extern std::condition_variable video_cv;
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
+// mmap 模式下每次扩展文件的最小长度
+static const size_t MMAP_GROW_SIZE = 64 << 20;
 
-void video_writer() {
-    std::ofstream video_file("video_frames.yuv", std::ios::binary);
-    if (!video_file.is_open()) {
-//        std::cout << "无法打开输出文件" << std::endl;
-        return;
+// 帧内一个平面的写出范围
+struct PlaneLayout {
+    int row_bytes = 0;
+    int rows = 0;
+};
+
+// 根据像素格式描述计算每个平面的有效行宽和行数，不支持的格式返回 -1
+static int get_plane_layout(const AVFrame* frame, PlaneLayout planes[4], int* nb_planes) {
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL))) {
+        return -1;
     }
 
-    while (true) {
-        std::unique_lock<std::mutex> lock(video_mutex);
-        video_cv.wait(lock, []{ return !video_frame_queue.empty(); });
+    int linesizes[4];
+    if (av_image_fill_linesizes(linesizes, format, frame->width) < 0) {
+        return -1;
+    }
 
-        AVFrame* frame = video_frame_queue.front();
-        video_frame_queue.pop();
+    *nb_planes = av_pix_fmt_count_planes(format);
+    for (int i = 0; i < *nb_planes; i++) {
+        // 与 av_image_copy 一致：第 1、2 个平面为色度平面，高度按色度采样缩减（向上取整）
+        planes[i].row_bytes = linesizes[i];
+        planes[i].rows = i == 1 || i == 2 ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+    }
+    return 0;
+}
 
-        if (frame == nullptr) { // 结束标志
-            break;
+// YUV4MPEG2 的色彩空间标记，格式不受支持时返回空
+static const char* y4m_colorspace(AVPixelFormat format) {
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:   return "420jpeg";
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:   return "422";
+    case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_YUVJ444P:   return "444";
+    case AV_PIX_FMT_YUV411P:    return "411";
+    case AV_PIX_FMT_GRAY8:      return "mono";
+    case AV_PIX_FMT_YUV420P10LE: return "420p10";
+    case AV_PIX_FMT_YUV422P10LE: return "422p10";
+    case AV_PIX_FMT_YUV444P10LE: return "444p10";
+    default:                    return nullptr;
+    }
+}
+
+static bool has_y4m_extension(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    return dot != std::string::npos && path.substr(dot + 1) == "y4m";
+}
+
+// 输出文件：writev 直接写出，或 mmap 映射后拷贝
+struct RawOutput {
+    int fd = -1;
+    bool use_mmap = false;
+    uint8_t* map = nullptr;
+    size_t mapped = 0;   // 当前映射长度（等于文件长度）
+    size_t size = 0;     // 已写入长度
+
+    // 确保映射区至少还能容纳 need 字节
+    int reserve(size_t need) {
+        if (size + need <= mapped) return 0;
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t capacity = std::max(std::max(mapped * 2, size + need), MMAP_GROW_SIZE);
+        capacity = (capacity + page - 1) / page * page;
+
+        if (map) {
+            munmap(map, mapped);
+            map = nullptr;
         }
+        if (ftruncate(fd, capacity) < 0) return -1;
+        void* addr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) return -1;
+        map = static_cast<uint8_t*>(addr);
+        mapped = capacity;
+        return 0;
+    }
 
-        // 写入 Y 分量
-        for (int j = 0; j < frame->height; ++j) {
-            video_file.write(reinterpret_cast<char*>(frame->data[0] + j * frame->linesize[0]), frame->width);
+    // 写出一组 iovec，mmap 模式为内存拷贝，否则 writev 并处理部分写入
+    int write_iov(struct iovec* iov, int count) {
+        if (use_mmap) {
+            size_t total = 0;
+            for (int i = 0; i < count; i++) total += iov[i].iov_len;
+            if (reserve(total) < 0) return -1;
+            for (int i = 0; i < count; i++) {
+                memcpy(map + size, iov[i].iov_base, iov[i].iov_len);
+                size += iov[i].iov_len;
+            }
+            return 0;
         }
 
-        // 写入 U 分量
-        for (int j = 0; j < frame->height / 2; ++j) {
-            video_file.write(reinterpret_cast<char*>(frame->data[1] + j * frame->linesize[1]), frame->width / 2);
+        while (count > 0) {
+            ssize_t written = writev(fd, iov, std::min(count, IOV_MAX));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return -1;
+            }
+            size += written;
+            // 跳过已完整写出的 iovec，调整剩余部分的起点
+            while (count > 0 && (size_t)written >= iov->iov_len) {
+                written -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            }
         }
+        return 0;
+    }
 
-        // 写入 V 分量
-        for (int j = 0; j < frame->height / 2; ++j) {
-            video_file.write(reinterpret_cast<char*>(frame->data[2] + j * frame->linesize[2]), frame->width / 2);
+    void close_file() {
+        if (map) {
+            munmap(map, mapped);
+            map = nullptr;
+        }
+        if (use_mmap && ftruncate(fd, size) < 0) {
+            std::cerr << "无法截断视频输出文件" << std::endl;
         }
+        close(fd);
+    }
+};
 
+void video_writer(FrameQueue& frame_queue, const std::string& output_file, AVRational frame_rate, bool use_mmap) {
+    RawOutput output;
+    output.use_mmap = use_mmap;
+    output.fd = open(output_file.c_str(), (use_mmap ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, 0644);
+    if (output.fd < 0) {
+        std::cerr << "无法打开视频输出文件: " << output_file << std::endl;
+        // 继续取出并释放帧，避免上游分发线程的引用无人释放
+        while (AVFrame* frame = frame_queue.pop()) {
+            av_frame_free(&frame);
+        }
+        return;
+    }
+
+    bool y4m = has_y4m_extension(output_file);
+    int width = 0, height = 0, format = AV_PIX_FMT_NONE;
+    bool failed = false;
+    int64_t frame_count = 0;
+    std::vector<struct iovec> iov;
+    static const char frame_header[] = "FRAME\n";
+
+    while (AVFrame* frame = frame_queue.pop()) {
+        if (failed) {
+            av_frame_free(&frame);
+            continue;
+        }
+
+        PlaneLayout planes[4];
+        int nb_planes = 0;
+        if (get_plane_layout(frame, planes, &nb_planes) < 0) {
+            std::cerr << "原始视频输出不支持像素格式: "
+                      << av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format)) << std::endl;
+            av_frame_free(&frame);
+            continue;
+        }
+
+        if (format == AV_PIX_FMT_NONE) {
+            width = frame->width;
+            height = frame->height;
+            format = frame->format;
+            std::cout << "原始视频输出: " << av_get_pix_fmt_name(static_cast<AVPixelFormat>(format)) << ", "
+                      << width << "x" << height << (use_mmap ? " (mmap)" : "") << " -> " << output_file << std::endl;
+
+            if (y4m) {
+                const char* colorspace = y4m_colorspace(static_cast<AVPixelFormat>(format));
+                if (!colorspace) {
+                    std::cerr << "Y4M 不支持该像素格式，改为输出裸数据" << std::endl;
+                    y4m = false;
+                } else {
+                    AVRational sar = frame->sample_aspect_ratio;
+                    std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) +
+                                         " F" + std::to_string(frame_rate.num) + ":" + std::to_string(frame_rate.den) +
+                                         " Ip A" + std::to_string(sar.num) + ":" + std::to_string(sar.den) +
+                                         " C" + colorspace + "\n";
+                    struct iovec header_iov = { const_cast<char*>(header.data()), header.size() };
+                    if (output.write_iov(&header_iov, 1) < 0) {
+                        std::cerr << "写入 Y4M 头失败: " << strerror(errno) << std::endl;
+                        failed = true;
+                    }
+                }
+            }
+        } else if (frame->width != width || frame->height != height || frame->format != format) {
+            std::cerr << "视频尺寸或像素格式中途变化，原始视频输出丢弃该帧" << std::endl;
+            av_frame_free(&frame);
+            continue;
+        }
+
+        // 行宽与 linesize 相同时整个平面一次写出，否则每行一个 iovec
+        iov.clear();
+        if (y4m) {
+            iov.push_back({ const_cast<char*>(frame_header), sizeof(frame_header) - 1 });
+        }
+        for (int i = 0; i < nb_planes; i++) {
+            const PlaneLayout& plane = planes[i];
+            if (frame->linesize[i] == plane.row_bytes) {
+                iov.push_back({ frame->data[i], (size_t)plane.row_bytes * plane.rows });
+            } else {
+                for (int y = 0; y < plane.rows; y++) {
+                    iov.push_back({ frame->data[i] + (ptrdiff_t)y * frame->linesize[i], (size_t)plane.row_bytes });
+                }
+            }
+        }
+
+        if (!failed && output.write_iov(iov.data(), (int)iov.size()) < 0) {
+            std::cerr << "写入视频输出文件失败: " << strerror(errno) << std::endl;
+            failed = true;
+        }
+        frame_count++;
         av_frame_free(&frame);
     }
 
-    video_file.close();
-}
\ No newline at end of file
+    output.close_file();
+    std::cout << "视频写入完成，共 " << frame_count << " 帧，" << output.size << " 字节" << std::endl;
+}
@@ -1,6 +1,12 @@
 #ifndef VIDEO_WRITER_H
 #define VIDEO_WRITER_H
 
-void video_writer();
+#include <string>
+#include "frame_queue.h"
+
+// 原始视频输出：从帧队列读取解码后的帧，按像素格式描述逐平面写出，支持任意平面/打包格式。
+// 输出文件扩展名为 .y4m 时写 YUV4MPEG2 头和帧头，否则为裸数据。
+// use_mmap 为 true 时通过 mmap 映射输出文件并直接拷贝，否则用 writev 合并写出。
+void video_writer(FrameQueue& frame_queue, const std::string& output_file, AVRational frame_rate, bool use_mmap = false);
 
 #endif
@@ -0,0 +1,293 @@
+#include "wsola.h"
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+#include <libavutil/cpu.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/samplefmt.h>
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WSOLA_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define WSOLA_NEON 1
+#endif
+
+// 点积：互相关搜索的热点，按 CPU 能力选择实现
+typedef float (*DotFunc)(const float* a, const float* b, int n);
+
+static float dot_scalar(const float* a, const float* b, int n) {
+    float sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+#ifdef WSOLA_X86
+#ifdef __SSE__
+static float dot_sse(const float* a, const float* b, int n) {
+    __m128 acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float* a, const float* b, int n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float sum = _mm_cvtss_f32(half);
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+#ifdef WSOLA_NEON
+static float dot_neon(const float* a, const float* b, int n) {
+    float32x4_t acc = vdupq_n_f32(0);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    float sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+static DotFunc select_dot() {
+#ifdef WSOLA_X86
+    // dot_avx2 按 avx2,fma 编译，两者都支持时才能使用
+    int flags = av_get_cpu_flags();
+    if ((flags & AV_CPU_FLAG_AVX2) && (flags & AV_CPU_FLAG_FMA3)) return dot_avx2;
+#ifdef __SSE__
+    return dot_sse;
+#endif
+#endif
+#ifdef WSOLA_NEON
+    return dot_neon;
+#endif
+    return dot_scalar;
+}
+
+static const DotFunc dot = select_dot();
+
+int WsolaStretcher::init(int nb_channels, int rate, double tempo) {
+    if (nb_channels <= 0 || rate <= 0 || tempo <= 0) {
+        std::cerr << "WSOLA 参数无效" << std::endl;
+        return -1;
+    }
+    channels = nb_channels;
+    sample_rate = rate;
+    speed = tempo;
+
+    // 窗长约 40ms，取 2 的幂
+    window = 256;
+    while (window < sample_rate / 25) {
+        window *= 2;
+    }
+    synthesis_hop = window / 2;
+    overlap = window / 2;
+    tolerance = window / 4;
+
+    // 周期 Hann 窗，半窗长步进时重叠相加之和恒为 1
+    hann.resize(window);
+    for (int n = 0; n < window; n++) {
+        hann[n] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * n / window);
+    }
+
+    input.assign(channels, std::vector<float>());
+    ola.assign(channels, std::vector<float>(window, 0.0f));
+    pending.assign(channels, std::vector<float>());
+    mono.clear();
+
+    std::cout << "WSOLA 变速: 速度 " << speed << "，窗长 " << window << " 采样，搜索范围 ±" << tolerance << std::endl;
+    return 0;
+}
+
+void WsolaStretcher::append_input(const AVFrame* in) {
+    size_t old_size = mono.size();
+    mono.resize(old_size + in->nb_samples, 0.0f);
+    float scale = 1.0f / channels;
+    for (int ch = 0; ch < channels; ch++) {
+        const float* src = reinterpret_cast<const float*>(in->extended_data[ch]);
+        input[ch].insert(input[ch].end(), src, src + in->nb_samples);
+        float* dst = mono.data() + old_size;
+        for (int i = 0; i < in->nb_samples; i++) {
+            dst[i] += src[i] * scale;
+        }
+    }
+    input_samples += in->nb_samples;
+}
+
+int64_t WsolaStretcher::find_best_position(int64_t target) const {
+    // 与上一帧的自然延续段最相似的候选位置
+    const float* ref = mono.data() + (prev_pos + synthesis_hop - input_base);
+    int64_t lo = std::max<int64_t>(target - tolerance, input_base);
+    int64_t hi = target + tolerance;
+    if (hi < lo) return target;
+
+    int64_t best = target;
+    float best_score = -INFINITY;
+    auto score_at = [&](int64_t pos) {
+        const float* cand = mono.data() + (pos - input_base);
+        float energy = dot(cand, cand, overlap);
+        return dot(cand, ref, overlap) / sqrtf(energy + 1e-9f);
+    };
+
+    // 先以步长 4 粗搜，再在最优点附近逐点细搜
+    for (int64_t pos = lo; pos <= hi; pos += 4) {
+        float score = score_at(pos);
+        if (score > best_score) {
+            best_score = score;
+            best = pos;
+        }
+    }
+    int64_t coarse = best;
+    for (int64_t pos = std::max(lo, coarse - 3); pos <= std::min(hi, coarse + 3); pos++) {
+        float score = score_at(pos);
+        if (score > best_score) {
+            best_score = score;
+            best = pos;
+        }
+    }
+    return best;
+}
+
+bool WsolaStretcher::synthesize_one(bool draining) {
+    int64_t target = llround(analysis_pos);
+    int64_t available_end = input_base + (int64_t)mono.size();
+    bool complete = target + tolerance + window <= available_end &&
+                    (prev_pos < 0 || prev_pos + synthesis_hop + overlap <= available_end);
+
+    if (!complete && !draining) return false;
+    if (target >= available_end) return false;
+
+    // 输入不足时（仅在结束冲洗阶段）不做搜索，越界部分按静音处理
+    int64_t best = prev_pos < 0 || !complete ? target : find_best_position(target);
+    bool first = prev_pos < 0;
+
+    for (int ch = 0; ch < channels; ch++) {
+        const std::vector<float>& src = input[ch];
+        float* acc = ola[ch].data();
+        int64_t offset = best - input_base;
+        int count = (int)std::min<int64_t>(window, (int64_t)src.size() - offset);
+        for (int n = 0; n < count; n++) {
+            // 第一帧前半段没有前一帧与之重叠，按权重 1 输出避免开头淡入
+            float w = first && n < synthesis_hop ? 1.0f : hann[n];
+            acc[n] += w * src[offset + n];
+        }
+
+        pending[ch].insert(pending[ch].end(), acc, acc + synthesis_hop);
+        memmove(acc, acc + synthesis_hop, (window - synthesis_hop) * sizeof(float));
+        std::fill(acc + window - synthesis_hop, acc + window, 0.0f);
+    }
+
+    prev_pos = best;
+    analysis_pos += synthesis_hop * speed;
+    trim_input();
+    return true;
+}
+
+void WsolaStretcher::trim_input() {
+    int64_t keep_from = std::min<int64_t>(prev_pos + synthesis_hop, llround(analysis_pos) - tolerance);
+    int64_t drop = keep_from - input_base;
+    // 攒够一定量再整体前移，避免频繁搬移
+    if (drop < 4 * window) return;
+    drop = std::min<int64_t>(drop, (int64_t)mono.size());
+
+    for (int ch = 0; ch < channels; ch++) {
+        input[ch].erase(input[ch].begin(), input[ch].begin() + drop);
+    }
+    mono.erase(mono.begin(), mono.begin() + drop);
+    input_base += drop;
+}
+
+int WsolaStretcher::take_output(AVFrame* out, int count) {
+    out->nb_samples = 0;
+    if (count <= 0) return 0;
+
+    out->format = AV_SAMPLE_FMT_FLTP;
+    out->channels = channels;
+    out->channel_layout = channel_layout;
+    out->sample_rate = sample_rate;
+    out->nb_samples = count;
+    int ret = av_frame_get_buffer(out, 0);
+    if (ret < 0) {
+        std::cerr << "无法分配 WSOLA 输出帧" << std::endl;
+        return ret;
+    }
+
+    for (int ch = 0; ch < channels; ch++) {
+        memcpy(out->extended_data[ch], pending[ch].data(), count * sizeof(float));
+        pending[ch].erase(pending[ch].begin(), pending[ch].begin() + count);
+    }
+
+    out->pts = start_pts + av_rescale_q(output_samples, (AVRational){1, sample_rate}, time_base);
+    output_samples += count;
+    return count;
+}
+
+int WsolaStretcher::process(const AVFrame* in, AVRational tb, AVFrame* out) {
+    if (in->format != AV_SAMPLE_FMT_FLTP || in->channels != channels) {
+        std::cerr << "WSOLA 只接受与初始化声道数一致的平面浮点输入" << std::endl;
+        return -1;
+    }
+    if (start_pts == AV_NOPTS_VALUE) {
+        start_pts = in->pts != AV_NOPTS_VALUE ? in->pts : 0;
+        time_base = tb;
+        channel_layout = in->channel_layout;
+    }
+
+    append_input(in);
+    while (synthesize_one(false)) {
+    }
+    return take_output(out, (int)pending[0].size());
+}
+
+int WsolaStretcher::flush(AVFrame* out) {
+    if (start_pts == AV_NOPTS_VALUE) {
+        out->nb_samples = 0;
+        return 0;
+    }
+
+    while (synthesize_one(true)) {
+    }
+
+    // 输出总长度按输入长度除以速度截断，丢弃末帧补零产生的多余尾部
+    int64_t expected = llround(input_samples / speed);
+    int64_t count = std::min<int64_t>((int64_t)pending[0].size(), expected - output_samples);
+    return take_output(out, (int)std::max<int64_t>(count, 0));
+}
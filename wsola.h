@@ -0,0 +1,65 @@
+#ifndef WSOLA_H
+#define WSOLA_H
+
+#include <vector>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavutil/frame.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+// WSOLA（波形相似重叠相加）变速不变调，单次处理 0.5 - 3.0 倍的全部速度范围。
+// 输入输出均为平面浮点（AV_SAMPLE_FMT_FLTP），候选位置的互相关搜索使用 SIMD 点积。
+class WsolaStretcher {
+public:
+    WsolaStretcher() = default;
+    WsolaStretcher(const WsolaStretcher&) = delete;
+    WsolaStretcher& operator=(const WsolaStretcher&) = delete;
+
+    int init(int channels, int sample_rate, double speed);
+
+    // 送入一帧输入，out 中返回本次可输出的采样（可能为 0 个），
+    // out 的时间戳以 time_base 为基准，从首个输入帧的时间戳开始按已输出采样数递增
+    int process(const AVFrame* in, AVRational time_base, AVFrame* out);
+
+    // 输出缓冲中剩余的采样
+    int flush(AVFrame* out);
+
+private:
+    int channels = 0;
+    int sample_rate = 0;
+    double speed = 1.0;
+
+    int window = 0;         // 分析/合成窗长
+    int synthesis_hop = 0;  // 输出步长，等于半窗长
+    int overlap = 0;        // 互相关比较长度
+    int tolerance = 0;      // 候选位置搜索范围 ±tolerance
+    std::vector<float> hann;
+
+    std::vector<std::vector<float>> input;    // 每声道的输入缓存
+    std::vector<float> mono;                  // 各声道平均，用于互相关搜索
+    std::vector<std::vector<float>> ola;      // 每声道的重叠相加缓存
+    std::vector<std::vector<float>> pending;  // 已合成待输出的采样
+
+    int64_t input_base = 0;      // input[0] 对应的绝对采样位置
+    double analysis_pos = 0;     // 下一帧的理想分析位置
+    int64_t prev_pos = -1;       // 上一帧实际选取的位置
+    int64_t input_samples = 0;   // 累计输入采样数
+    int64_t output_samples = 0;  // 累计输出采样数
+    int64_t start_pts = AV_NOPTS_VALUE;
+    AVRational time_base = {0, 1};
+    uint64_t channel_layout = 0;
+
+    void append_input(const AVFrame* in);
+    bool synthesize_one(bool draining);
+    int64_t find_best_position(int64_t target) const;
+    void trim_input();
+    int take_output(AVFrame* out, int count);
+};
+
+#endif